@@ -41,6 +41,8 @@ extern "C" {
 #include "HostInfo.h"
 #include "LogLevel.h"
 #include "Logging.h"
+#include "ProfiledMutex.h"
+#include "ThreadPlacement.h"
 #include "Utility.h"
 
 static const int MAX_GRPC_CONNECTION_POLLS = 30;
@@ -146,6 +148,14 @@ int main(int argc, char** argv) {
 
   setCoreDumpLimit(config.IsCoreDumpEnabled());
 
+  ThreadPlacement::Configure(config.GetThreadPlacement());
+
+  if (config.AsyncLogging()) {
+    logging::StartAsyncLogging();
+  }
+
+  ProfiledMutex::EnableProfiling(config.LockProfiling());
+
   auto& startup_diagnostics = StartupDiagnostics::GetInstance();
 
   // Extract configuration options
@@ -192,5 +202,7 @@ int main(int argc, char** argv) {
 
   CLOG(INFO) << "Collector exiting successfully!";
 
+  logging::StopAsyncLogging();
+
   return 0;
 }
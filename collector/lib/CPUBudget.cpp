@@ -0,0 +1,187 @@
+#include "CPUBudget.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "CollectorStats.h"
+#include "Logging.h"
+
+namespace collector {
+
+namespace {
+
+bool IsDirectory(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool HasController(const std::string& controllers, const std::string& name) {
+  std::istringstream list(controllers);
+  std::string controller;
+  while (std::getline(list, controller, ',')) {
+    if (controller == name) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T>
+bool ReadValue(const std::string& path, T* value) {
+  std::ifstream file(path);
+  return static_cast<bool>(file >> *value);
+}
+
+}  // namespace
+
+CgroupCPUReader::CgroupCPUReader(std::string proc_root, std::string cgroup_root) {
+  if (!Locate(proc_root, cgroup_root)) {
+    CLOG(INFO) << "Could not find the CPU cgroup of collector, CPU throttling is not monitored";
+  }
+}
+
+bool CgroupCPUReader::Locate(const std::string& proc_root, const std::string& cgroup_root) {
+  std::ifstream file(proc_root + "/self/cgroup");
+  std::string line;
+
+  // Lines are formatted as hierarchy-ID:controller-list:cgroup-path, the
+  // unified (v2) hierarchy having ID 0 and no controllers.
+  while (std::getline(file, line)) {
+    auto first = line.find(':');
+    auto second = line.find(':', first + 1);
+    if (first == std::string::npos || second == std::string::npos) {
+      continue;
+    }
+    std::string id = line.substr(0, first);
+    std::string controllers = line.substr(first + 1, second - first - 1);
+    std::string path = line.substr(second + 1);
+
+    std::vector<std::string> candidates;
+    bool v2 = false;
+    if (id == "0" && controllers.empty()) {
+      v2 = true;
+      candidates = {cgroup_root + path, cgroup_root};
+    } else if (HasController(controllers, "cpu")) {
+      candidates = {cgroup_root + "/" + controllers + path, cgroup_root + "/cpu" + path,
+                    cgroup_root + "/" + controllers, cgroup_root + "/cpu"};
+    } else {
+      continue;
+    }
+
+    // In a cgroup namespace, the path is relative to the namespace root,
+    // which is then the mounted hierarchy itself.
+    for (const auto& dir : candidates) {
+      if (IsDirectory(dir) && std::ifstream(dir + "/cpu.stat")) {
+        cgroup_dir_ = dir;
+        v2_ = v2;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool CgroupCPUReader::Read(CgroupCPUStat* stat) const {
+  if (cgroup_dir_.empty()) {
+    return false;
+  }
+
+  std::ifstream file(cgroup_dir_ + "/cpu.stat");
+  if (!file) {
+    return false;
+  }
+
+  std::string key;
+  uint64_t value;
+  while (file >> key >> value) {
+    if (key == "nr_periods") {
+      stat->nr_periods = value;
+    } else if (key == "nr_throttled") {
+      stat->nr_throttled = value;
+    } else if (key == "throttled_usec") {
+      stat->throttled_usec = value;
+    } else if (key == "throttled_time") {
+      // cgroup v1 reports nanoseconds.
+      stat->throttled_usec = value / 1000;
+    }
+  }
+
+  stat->quota_usec = -1;
+  if (v2_) {
+    // cpu.max contains the quota, or "max", and the period.
+    std::ifstream max_file(cgroup_dir_ + "/cpu.max");
+    std::string quota;
+    int64_t period;
+    if (max_file >> quota >> period) {
+      stat->period_usec = period;
+      if (quota != "max") {
+        try {
+          stat->quota_usec = std::stoll(quota);
+        } catch (...) {
+        }
+      }
+    }
+  } else {
+    int64_t quota, period;
+    if (ReadValue(cgroup_dir_ + "/cpu.cfs_period_us", &period)) {
+      stat->period_usec = period;
+    }
+    if (ReadValue(cgroup_dir_ + "/cpu.cfs_quota_us", &quota) && quota > 0) {
+      stat->quota_usec = quota;
+    }
+  }
+
+  return true;
+}
+
+constexpr int CPUBudget::kHoldSamples;
+
+void CPUBudget::Update(const CgroupCPUStat& stat) {
+  if (stat.period_usec > 0) {
+    period_usec_.store(stat.period_usec, std::memory_order_relaxed);
+  }
+
+  if (has_last_) {
+    if (stat.nr_throttled > last_.nr_throttled) {
+      if (!Throttled()) {
+        CLOG(INFO) << "Collector is being throttled by its CPU quota, pacing background work";
+      }
+      throttled_samples_.store(kHoldSamples, std::memory_order_relaxed);
+    } else if (Throttled()) {
+      throttled_samples_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  last_ = stat;
+  has_last_ = true;
+}
+
+constexpr std::chrono::milliseconds CPUPacer::kSlice;
+
+CPUPacer::CPUPacer(const CPUBudget* budget, std::chrono::steady_clock::time_point deadline)
+    : budget_(budget), deadline_(deadline), slice_start_(std::chrono::steady_clock::now()) {}
+
+void CPUPacer::Pace() {
+  if (!budget_ || !budget_->Throttled()) {
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - slice_start_ < kSlice) {
+    return;
+  }
+
+  auto pause = std::min<std::chrono::steady_clock::duration>(budget_->Period(), deadline_ - now);
+  if (pause.count() > 0) {
+    std::this_thread::sleep_for(pause);
+    COUNTER_ADD(CollectorStats::cpu_budget_paced_usec, std::chrono::duration_cast<std::chrono::microseconds>(pause).count());
+  }
+  slice_start_ = std::chrono::steady_clock::now();
+}
+
+}  // namespace collector
@@ -0,0 +1,82 @@
+#ifndef COLLECTOR_CPUBUDGET_H
+#define COLLECTOR_CPUBUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace collector {
+
+// CPU bandwidth statistics of a cgroup, as reported by cpu.stat.
+struct CgroupCPUStat {
+  uint64_t nr_periods = 0;
+  uint64_t nr_throttled = 0;
+  uint64_t throttled_usec = 0;
+  // CFS quota and period. quota_usec is -1 if the cgroup has no quota.
+  int64_t quota_usec = -1;
+  int64_t period_usec = 100000;
+};
+
+// Reads the CPU statistics of the cgroup collector runs in, with either
+// cgroup v1 or v2.
+class CgroupCPUReader {
+ public:
+  explicit CgroupCPUReader(std::string proc_root = "/proc", std::string cgroup_root = "/sys/fs/cgroup");
+
+  bool Read(CgroupCPUStat* stat) const;
+
+  // Directory of the cgroup, empty if it could not be found.
+  const std::string& cgroup_dir() const { return cgroup_dir_; }
+  bool IsV2() const { return v2_; }
+
+ private:
+  bool Locate(const std::string& proc_root, const std::string& cgroup_root);
+
+  std::string cgroup_dir_;
+  bool v2_ = false;
+};
+
+// CPUBudget tracks whether collector is being throttled by the CFS quota of
+// its cgroup, based on periodic samples of its CPU statistics. While it is,
+// background work is spread over time and deferred, so that bursts of it do
+// not exhaust the quota and stall the event loop.
+class CPUBudget {
+ public:
+  // Number of samples after the last throttled one during which collector is
+  // considered throttled.
+  static constexpr int kHoldSamples = 5;
+
+  void Update(const CgroupCPUStat& stat);
+
+  bool Throttled() const { return throttled_samples_.load(std::memory_order_relaxed) > 0; }
+  std::chrono::microseconds Period() const { return std::chrono::microseconds(period_usec_.load(std::memory_order_relaxed)); }
+
+ private:
+  bool has_last_ = false;
+  CgroupCPUStat last_;
+  std::atomic<int> throttled_samples_{0};
+  std::atomic<int64_t> period_usec_{100000};
+};
+
+// CPUPacer spreads a CPU intensive task over time while collector is
+// throttled, by sleeping for a CFS period after every slice of work, until
+// the given deadline.
+class CPUPacer {
+ public:
+  static constexpr std::chrono::milliseconds kSlice{5};
+
+  CPUPacer(const CPUBudget* budget, std::chrono::steady_clock::time_point deadline);
+
+  // Called in between units of work.
+  void Pace();
+
+ private:
+  const CPUBudget* budget_;
+  std::chrono::steady_clock::time_point deadline_;
+  std::chrono::steady_clock::time_point slice_start_;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_CPUBUDGET_H
@@ -1,5 +1,6 @@
 #include "CollectorConfig.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "CollectorArgs.h"
@@ -19,6 +20,9 @@ BoolEnvVar disable_network_flows("ROX_COLLECTOR_DISABLE_NETWORK_FLOWS", false);
 // If true, retrieve tcp listening sockets while reading connection information in /proc.
 BoolEnvVar ports_feature_flag("ROX_NETWORK_GRAPH_PORTS", true);
 
+// If true, maintain tcp listening sockets from kernel events, and only scrape them from /proc occasionally.
+BoolEnvVar listen_endpoints_from_events("ROX_COLLECTOR_TRACK_LISTEN_ENDPOINTS", false);
+
 // If true, ignore connections with configured protocol and port pairs (e.g., udp/9).
 BoolEnvVar network_drop_ignored("ROX_NETWORK_DROP_IGNORED", true);
 
@@ -44,6 +48,14 @@ BoolEnvVar enable_external_ips("ROX_ENABLE_EXTERNAL_IPS", false);
 
 BoolEnvVar enable_connection_stats("ROX_COLLECTOR_ENABLE_CONNECTION_STATS", true);
 
+BoolEnvVar set_async_logging("ROX_COLLECTOR_ASYNC_LOGGING", false);
+
+BoolEnvVar set_lock_profiling("ROX_COLLECTOR_LOCK_PROFILING", false);
+
+BoolEnvVar set_capture_sched_switch("ROX_COLLECTOR_CAPTURE_SCHED_SWITCH", true);
+
+BoolEnvVar set_normalize_connections_on_ingest("ROX_COLLECTOR_NORMALIZE_CONNECTIONS_ON_INGEST", false);
+
 }  // namespace
 
 constexpr bool CollectorConfig::kTurnOffScrape;
@@ -68,6 +80,13 @@ void CollectorConfig::InitCollectorConfig(CollectorArgs* args) {
   collect_connection_status_ = collect_connection_status.value();
   enable_external_ips_ = enable_external_ips.value();
   enable_connection_stats_ = enable_connection_stats.value();
+  async_logging_ = set_async_logging.value();
+  lock_profiling_ = set_lock_profiling.value();
+  capture_sched_switch_ = set_capture_sched_switch.value();
+  if (!capture_sched_switch_) {
+    CLOG(INFO) << "Context switches (sched_switch) will not be captured";
+  }
+  normalize_connections_on_ingest_ = set_normalize_connections_on_ingest.value();
 
   for (const auto& syscall : kSyscalls) {
     syscalls_.push_back(syscall);
@@ -150,6 +169,7 @@ void CollectorConfig::InitCollectorConfig(CollectorArgs* args) {
 
   if (ports_feature_flag) {
     scrape_listen_endpoints_ = true;
+    track_listen_endpoints_ = listen_endpoints_from_events.value();
   }
 
   if (network_drop_ignored) {
@@ -182,6 +202,11 @@ void CollectorConfig::InitCollectorConfig(CollectorArgs* args) {
   HandleAfterglowEnvVars();
   HandleConnectionStatsEnvVars();
   HandleSinspEnvVars();
+  HandleNetworkEventWorkersEnvVars();
+  HandleMaxConnectionsPerContainerEnvVars();
+  HandleNetworkCheckpointEnvVars();
+  HandleThreadPlacementEnvVars();
+  HandleContinuousProfilerEnvVars();
 
   host_config_ = ProcessHostHeuristics(*this);
 }
@@ -248,11 +273,18 @@ void CollectorConfig::HandleConnectionStatsEnvVars() {
   connection_stats_error_ = 0.01;
 
   if ((envvar = std::getenv("ROX_COLLECTOR_CONNECTION_STATS_ERROR")) != NULL) {
+    double error = 0;
     try {
-      connection_stats_error_ = std::stod(envvar);
-      CLOG(INFO) << "Connection statistics error value: " << connection_stats_error_;
+      error = std::stod(envvar);
     } catch (...) {
-      CLOG(ERROR) << "Invalid quantile error value: '" << envvar << "'";
+    }
+    // The relative error of the sketches must be in (0, 1).
+    if (error > 0 && error < 1) {
+      connection_stats_error_ = error;
+      CLOG(INFO) << "Connection statistics error value: " << connection_stats_error_;
+    } else {
+      CLOG(WARNING) << "Invalid quantile error value: '" << envvar << "', must be in (0, 1), using "
+                    << connection_stats_error_;
     }
   }
 
@@ -304,6 +336,113 @@ void CollectorConfig::HandleSinspEnvVars() {
   }
 }
 
+void CollectorConfig::HandleNetworkEventWorkersEnvVars() {
+  const char* envvar;
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_NETWORK_EVENT_WORKERS")) != NULL) {
+    try {
+      network_event_workers_ = std::stoi(envvar);
+      CLOG(INFO) << "Network event workers: " << network_event_workers_;
+    } catch (...) {
+      CLOG(ERROR) << "Invalid network event workers value: '" << envvar << "'";
+    }
+  }
+}
+
+void CollectorConfig::HandleMaxConnectionsPerContainerEnvVars() {
+  const char* envvar;
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_MAX_CONNECTIONS_PER_CONTAINER")) != NULL) {
+    try {
+      max_connections_per_container_ = std::stoi(envvar);
+      CLOG(INFO) << "Max connections per container: " << max_connections_per_container_;
+    } catch (...) {
+      CLOG(ERROR) << "Invalid max connections per container value: '" << envvar << "'";
+    }
+  }
+}
+
+void CollectorConfig::HandleNetworkCheckpointEnvVars() {
+  const char* envvar;
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_NETWORK_CHECKPOINT_PATH")) != NULL) {
+    network_checkpoint_path_ = envvar;
+    CLOG(INFO) << "Network state checkpoint path: " << network_checkpoint_path_;
+  }
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_NETWORK_CHECKPOINT_MAX_AGE")) != NULL) {
+    try {
+      network_checkpoint_max_age_micros_ = static_cast<int64_t>(std::stoi(envvar)) * 1000000;
+      CLOG(INFO) << "Network state checkpoint max age: " << envvar << " seconds";
+    } catch (...) {
+      CLOG(ERROR) << "Invalid network state checkpoint max age value: '" << envvar << "'";
+    }
+  }
+}
+
+void CollectorConfig::HandleThreadPlacementEnvVars() {
+  const char* envvar;
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_EVENT_LOOP_CPUS")) != NULL) {
+    thread_placement_.event_loop_cpus = envvar;
+  }
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_NETWORK_CPUS")) != NULL) {
+    thread_placement_.network_cpus = envvar;
+  }
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_BACKGROUND_NICE")) != NULL) {
+    try {
+      thread_placement_.background_nice = std::stoi(envvar);
+      CLOG(INFO) << "Background threads nice value: " << thread_placement_.background_nice;
+    } catch (...) {
+      CLOG(ERROR) << "Invalid background threads nice value: '" << envvar << "'";
+    }
+  }
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_BACKGROUND_SCHED_POLICY")) != NULL) {
+    thread_placement_.background_policy = envvar;
+    CLOG(INFO) << "Background threads scheduling policy: " << thread_placement_.background_policy;
+  }
+}
+
+void CollectorConfig::HandleContinuousProfilerEnvVars() {
+  const char* envvar;
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_CONTINUOUS_PROFILING_INTERVAL")) != NULL) {
+    try {
+      continuous_profiler_.interval = std::chrono::seconds(std::max(std::stoi(envvar), 0));
+      CLOG(INFO) << "Continuous profiling interval: " << continuous_profiler_.interval.count() << "s";
+    } catch (...) {
+      CLOG(ERROR) << "Invalid continuous profiling interval value: '" << envvar << "'";
+    }
+  }
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_CONTINUOUS_PROFILING_WINDOW")) != NULL) {
+    try {
+      continuous_profiler_.window = std::chrono::milliseconds(std::max(std::stoi(envvar), 1));
+      CLOG(INFO) << "Continuous profiling window: " << continuous_profiler_.window.count() << "ms";
+    } catch (...) {
+      CLOG(ERROR) << "Invalid continuous profiling window value: '" << envvar << "'";
+    }
+  }
+
+  if ((envvar = std::getenv("ROX_COLLECTOR_CONTINUOUS_PROFILING_WINDOWS")) != NULL) {
+    try {
+      continuous_profiler_.max_windows = std::max(std::stoi(envvar), 1);
+      CLOG(INFO) << "Continuous profiling windows kept: " << continuous_profiler_.max_windows;
+    } catch (...) {
+      CLOG(ERROR) << "Invalid continuous profiling windows value: '" << envvar << "'";
+    }
+  }
+
+  // A window lasting the whole interval would leave no room for the next one.
+  if (continuous_profiler_.window >= continuous_profiler_.interval && continuous_profiler_.interval.count() > 0) {
+    continuous_profiler_.window = std::chrono::milliseconds(continuous_profiler_.interval) / 2;
+    CLOG(WARNING) << "Continuous profiling window reduced to " << continuous_profiler_.window.count() << "ms";
+  }
+}
+
 bool CollectorConfig::TurnOffScrape() const {
   return turn_off_scrape_;
 }
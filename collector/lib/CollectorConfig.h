@@ -9,8 +9,10 @@
 #include <grpcpp/channel.h>
 
 #include "CollectionMethod.h"
+#include "ContinuousProfiler.h"
 #include "HostConfig.h"
 #include "NetworkConnection.h"
+#include "ThreadPlacement.h"
 
 namespace collector {
 
@@ -55,6 +57,7 @@ class CollectorConfig {
 
   bool TurnOffScrape() const;
   bool ScrapeListenEndpoints() const { return scrape_listen_endpoints_; }
+  bool TrackListenEndpoints() const { return track_listen_endpoints_; }
   int ScrapeInterval() const;
   std::string Hostname() const;
   std::string HostProc() const;
@@ -80,6 +83,16 @@ class CollectorConfig {
   unsigned int GetSinspBufferSize() const { return sinsp_buffer_size_; }
   unsigned int GetSinspCpuPerBuffer() const { return sinsp_cpu_per_buffer_; }
   unsigned int GetSinspThreadCacheSize() const { return sinsp_thread_cache_size_; }
+  unsigned int GetNetworkEventWorkers() const { return network_event_workers_; }
+  unsigned int MaxConnectionsPerContainer() const { return max_connections_per_container_; }
+  const std::string& NetworkCheckpointPath() const { return network_checkpoint_path_; }
+  int64_t NetworkCheckpointMaxAge() const { return network_checkpoint_max_age_micros_; }
+  bool AsyncLogging() const { return async_logging_; }
+  bool LockProfiling() const { return lock_profiling_; }
+  bool CaptureSchedSwitch() const { return capture_sched_switch_; }
+  bool NormalizeConnectionsOnIngest() const { return normalize_connections_on_ingest_; }
+  const ThreadPlacementConfig& GetThreadPlacement() const { return thread_placement_; }
+  const ContinuousProfilerConfig& GetContinuousProfiler() const { return continuous_profiler_; }
 
   std::shared_ptr<grpc::Channel> grpc_channel;
 
@@ -92,6 +105,7 @@ class CollectorConfig {
   std::string host_proc_;
   bool disable_network_flows_ = false;
   bool scrape_listen_endpoints_ = false;
+  bool track_listen_endpoints_ = false;
   UnorderedSet<L4ProtoPortPair> ignored_l4proto_port_pairs_;
   std::vector<IPNet> ignored_networks_;
   bool curl_verbose_ = false;
@@ -105,6 +119,10 @@ class CollectorConfig {
   bool collect_connection_status_;
   bool enable_external_ips_;
   bool enable_connection_stats_;
+  bool async_logging_ = false;
+  bool lock_profiling_ = false;
+  bool capture_sched_switch_ = true;
+  bool normalize_connections_on_ingest_ = false;
   std::vector<double> connection_stats_quantiles_;
   double connection_stats_error_;
   unsigned int connection_stats_window_;
@@ -120,11 +138,35 @@ class CollectorConfig {
   // is 2^17 (131072) and twice as large.
   unsigned int sinsp_thread_cache_size_ = 32768;
 
+  // Number of threads applying connection updates from network events to the
+  // connection tracker. 0 means the updates are applied from the event loop.
+  unsigned int network_event_workers_ = 0;
+
+  // Maximum number of connections (and of listen endpoints) tracked for a
+  // single container. 0 means no limit.
+  unsigned int max_connections_per_container_ = 0;
+
+  // File the reported network state is checkpointed to, so that it survives
+  // restarts. Empty means checkpointing is disabled.
+  std::string network_checkpoint_path_;
+  int64_t network_checkpoint_max_age_micros_ = 300000000;  // 5 minutes in microseconds
+
+  // CPUs and scheduling parameters of the collector threads, by role.
+  ThreadPlacementConfig thread_placement_;
+
+  // Periodic CPU profile windows, disabled by default.
+  ContinuousProfilerConfig continuous_profiler_;
+
   Json::Value tls_config_;
 
   void HandleAfterglowEnvVars();
   void HandleConnectionStatsEnvVars();
   void HandleSinspEnvVars();
+  void HandleNetworkEventWorkersEnvVars();
+  void HandleMaxConnectionsPerContainerEnvVars();
+  void HandleNetworkCheckpointEnvVars();
+  void HandleThreadPlacementEnvVars();
+  void HandleContinuousProfilerEnvVars();
 };
 
 std::ostream& operator<<(std::ostream& os, const CollectorConfig& c);
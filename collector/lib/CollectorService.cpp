@@ -4,20 +4,27 @@ extern "C" {
 #include <signal.h>
 }
 
+#include <future>
 #include <memory>
 
+#include "CPUBudget.h"
 #include "CivetServer.h"
 #include "CollectorStatsExporter.h"
 #include "ConnTracker.h"
 #include "Containers.h"
+#include "ContinuousProfiler.h"
 #include "Diagnostics.h"
 #include "GRPCUtil.h"
 #include "GetKernelObject.h"
 #include "GetStatus.h"
 #include "LogLevel.h"
+#include "MemoryHandler.h"
 #include "NetworkStatusNotifier.h"
+#include "Profiler.h"
 #include "ProfilerHandler.h"
+#include "Scheduler.h"
 #include "SysdigService.h"
+#include "ThreadPlacement.h"
 #include "Utility.h"
 #include "prometheus/exposer.h"
 
@@ -32,6 +39,8 @@ CollectorService::CollectorService(const CollectorConfig& config, std::atomic<Co
 }
 
 void CollectorService::RunForever() {
+  STARTUP_PHASE_BEGIN(CollectorStats::startup);
+
   // Start monitoring services.
   // Some of these variables must remain in scope, so
   // be cautious if decomposing to a separate function.
@@ -39,6 +48,7 @@ void CollectorService::RunForever() {
   CivetServer server(options);
 
   std::shared_ptr<ConnectionTracker> conn_tracker;
+  std::shared_ptr<ProcessStore> process_store;
 
   GetStatus getStatus(config_.Hostname(), &sysdig_);
 
@@ -47,42 +57,102 @@ void CollectorService::RunForever() {
   server.addHandler("/ready", getStatus);
   LogLevelHandler setLogLevel;
   server.addHandler("/loglevel", setLogLevel);
+  MemoryHandler memory_handler;
+  server.addHandler("/memory", memory_handler);
 
-  ProfilerHandler profiler_handler;
+  ContinuousProfiler continuous_profiler(config_.GetContinuousProfiler());
+  ProfilerHandler profiler_handler(&continuous_profiler);
   server.addHandler(ProfilerHandler::kBaseRoute, profiler_handler);
 
   prometheus::Exposer exposer("9090");
   exposer.RegisterCollectable(registry);
 
-  CollectorStatsExporter exporter(registry, &config_, &sysdig_);
+  // Runs the periodic background tasks, such as the stats export. Those marked
+  // deferrable are postponed while collector is throttled by its CPU quota.
+  CgroupCPUReader cgroup_cpu_reader;
+  CPUBudget cpu_budget;
+  Scheduler scheduler;
+  scheduler.SetDeferral([&cpu_budget] { return cpu_budget.Throttled(); });
+  if (!scheduler.Start()) {
+    CLOG(FATAL) << "Unable to start the background task scheduler";
+  }
+
+  if (!cgroup_cpu_reader.cgroup_dir().empty()) {
+    scheduler.SchedulePeriodic("cpu_throttling", std::chrono::seconds(1), [&cgroup_cpu_reader, &cpu_budget] {
+      CgroupCPUStat stat;
+      if (!cgroup_cpu_reader.Read(&stat)) {
+        return;
+      }
+      cpu_budget.Update(stat);
+      COUNTER_SET(CollectorStats::cgroup_cpu_nr_periods, stat.nr_periods);
+      COUNTER_SET(CollectorStats::cgroup_cpu_nr_throttled, stat.nr_throttled);
+      COUNTER_SET(CollectorStats::cgroup_cpu_throttled_usec, stat.throttled_usec);
+      COUNTER_SET(CollectorStats::cgroup_cpu_quota_usec, stat.quota_usec);
+    });
+  }
+
+  if (continuous_profiler.IsEnabled()) {
+    if (Profiler::IsCPUProfilerSupported()) {
+      continuous_profiler.Schedule(&scheduler);
+    } else {
+      CLOG(WARNING) << "Continuous profiling is enabled, but CPU profiling is not supported by this build";
+    }
+  }
+
+  CollectorStatsExporter exporter(registry, &config_, &sysdig_, &scheduler);
+  for (const auto& collectable : exporter.GetCollectables()) {
+    exposer.RegisterCollectable(collectable);
+  }
 
   std::unique_ptr<NetworkStatusNotifier> net_status_notifier;
 
   CLOG(INFO) << "Network scrape interval set to " << config_.ScrapeInterval() << " seconds";
 
+  // Startup dependency graph:
+  //
+  //   sensor_connectivity ---------------------------------> (streams open)
+  //   network_setup --> sysdig_init --> sysdig_start ------> event loop
+  //
+  // Nothing on the bottom path depends on Sensor being reachable. Events
+  // observed before the streams are open are kept in the connection tracker
+  // and in the signal client's startup buffer, and the thread table is resent
+  // once the signal stream is up, so we wait for Sensor concurrently instead
+  // of blocking the rest of the startup on it.
+  std::future<bool> sensor_ready;
   if (config_.grpc_channel) {
     CLOG(INFO) << "Waiting for Sensor to become ready ...";
-    if (!WaitForGRPCServer()) {
-      CLOG(INFO) << "Interrupted while waiting for Sensor to become ready ...";
-      return;
-    }
-    CLOG(INFO) << "Sensor connectivity is successful";
+    sensor_ready = std::async(std::launch::async, [this] {
+      bool ready;
+      WITH_STARTUP_PHASE(CollectorStats::sensor_connectivity) {
+        ready = WaitForGRPCServer();
+      }
+      if (ready) {
+        CLOG(INFO) << "Sensor connectivity is successful";
+      } else {
+        CLOG(INFO) << "Interrupted while waiting for Sensor to become ready ...";
+      }
+      return ready;
+    });
   }
 
   if (!config_.grpc_channel || !config_.DisableNetworkFlows()) {
+    STARTUP_PHASE_BEGIN(CollectorStats::network_setup);
+
     // In case if no GRPC is used, continue to setup networking infrasturcture
     // with empty grpc_channel. NetworkConnectionInfoServiceComm will pick it
     // up and use stdout instead.
-    std::shared_ptr<ProcessStore> process_store;
     if (config_.IsProcessesListeningOnPortsEnabled()) {
       process_store = std::make_shared<ProcessStore>(&sysdig_);
     }
-    std::shared_ptr<IConnScraper> conn_scraper = std::make_shared<ConnScraper>(config_.HostProc(), process_store);
+    std::shared_ptr<IConnScraper> conn_scraper = std::make_shared<ConnScraper>(config_.HostProc(), process_store, &cpu_budget,
+                                                                                 std::chrono::milliseconds(std::chrono::seconds(config_.ScrapeInterval())) / 4);
     conn_tracker = std::make_shared<ConnectionTracker>();
     UnorderedSet<L4ProtoPortPair> ignored_l4proto_port_pairs(config_.IgnoredL4ProtoPortPairs());
     conn_tracker->UpdateIgnoredL4ProtoPortPairs(std::move(ignored_l4proto_port_pairs));
     conn_tracker->UpdateIgnoredNetworks(config_.IgnoredNetworks());
     conn_tracker->EnableExternalIPs(config_.EnableExternalIPs());
+    conn_tracker->SetMaxEntriesPerContainer(config_.MaxConnectionsPerContainer());
+    conn_tracker->SetNormalizeOnIngest(config_.NormalizeConnectionsOnIngest());
 
     auto network_connection_info_service_comm = std::make_shared<NetworkConnectionInfoServiceComm>(config_.Hostname(), config_.grpc_channel);
 
@@ -91,16 +161,31 @@ void CollectorService::RunForever() {
                                                             network_connection_info_service_comm,
                                                             config_,
                                                             config_.EnableConnectionStats() ? exporter.GetConnectionsTotalReporter() : 0,
-                                                            config_.EnableConnectionStats() ? exporter.GetConnectionsRateReporter() : 0);
+                                                            config_.EnableConnectionStats() ? exporter.GetConnectionsRateReporter() : 0,
+                                                            &cpu_budget);
+    // The notifier performs its first procfs scrape while its stream to
+    // Sensor is being established.
     net_status_notifier->Start();
+
+    STARTUP_PHASE_END(CollectorStats::network_setup);
   }
 
   if (!exporter.start()) {
     CLOG(FATAL) << "Unable to start collector stats exporter";
   }
 
-  sysdig_.Init(config_, conn_tracker);
-  sysdig_.Start();
+  WITH_STARTUP_PHASE(CollectorStats::sysdig_init) {
+    sysdig_.Init(config_, conn_tracker, process_store);
+  }
+  WITH_STARTUP_PHASE(CollectorStats::sysdig_start) {
+    sysdig_.Start();
+  }
+
+  STARTUP_PHASE_END(CollectorStats::startup);
+
+  // Threads started from here on inherit the placement of the event loop,
+  // hence it is applied last. The main thread keeps the name of the process.
+  ThreadPlacement::Apply(nullptr, ThreadRole::EVENT_LOOP);
 
   ControlValue cv;
   while ((cv = control_->load(std::memory_order_relaxed)) != STOP_COLLECTOR) {
@@ -116,9 +201,13 @@ void CollectorService::RunForever() {
 
   CLOG(INFO) << "Shutting down collector.";
 
+  // The wait for Sensor observes the control value, so this returns promptly.
+  if (sensor_ready.valid()) sensor_ready.wait();
+
   if (net_status_notifier) net_status_notifier->Stop();
   // Shut down these first since they access the sysdig object.
   exporter.stop();
+  scheduler.Stop();
   server.close();
 
   sysdig_.CleanUp();
@@ -12,6 +12,18 @@ std::array<std::string, CollectorStats::counter_type_max> CollectorStats::counte
     COUNTER_NAMES};
 #undef X
 
+#define X(n) #n,
+std::array<std::string, CollectorStats::startup_phase_max> CollectorStats::startup_phase_to_name = {
+    STARTUP_PHASE_NAMES};
+#undef X
+
+#define X(n) #n,
+std::array<std::string, CollectorStats::lock_type_max> CollectorStats::lock_type_to_name = {
+    LOCK_NAMES};
+#undef X
+
+constexpr int CollectorStats::kLockHistogramBuckets;
+
 CollectorStats& CollectorStats::GetOrCreate() {
   static CollectorStats stats;
 
@@ -26,6 +38,20 @@ void CollectorStats::Reset() {
   for (int i = 0; i < counter_type_max; i++) {
     CollectorStats::GetOrCreate().counter_[i] = 0;
   }
+  for (int i = 0; i < startup_phase_max; i++) {
+    CollectorStats::GetOrCreate().startup_begin_us_[i] = 0;
+    CollectorStats::GetOrCreate().startup_end_us_[i] = 0;
+  }
+  for (int i = 0; i < lock_type_max; i++) {
+    CollectorStats::GetOrCreate().lock_acquisitions_[i] = 0;
+    CollectorStats::GetOrCreate().lock_contentions_[i] = 0;
+    CollectorStats::GetOrCreate().lock_wait_us_[i] = 0;
+    CollectorStats::GetOrCreate().lock_hold_us_[i] = 0;
+    for (int b = 0; b < kLockHistogramBuckets; b++) {
+      CollectorStats::GetOrCreate().lock_wait_buckets_[i][b] = 0;
+      CollectorStats::GetOrCreate().lock_hold_buckets_[i][b] = 0;
+    }
+  }
 }
 
 }  // namespace collector
@@ -1,6 +1,7 @@
 #ifndef COLLECTOR_COLLECTORSTATS_H
 #define COLLECTOR_COLLECTORSTATS_H
 
+#include <algorithm>
 #include <atomic>
 #include <string>
 #include <unordered_map>
@@ -8,13 +9,17 @@
 
 #include "TimeUtil.h"
 
-#define TIMER_NAMES     \
-  X(net_scrape_read)    \
-  X(net_scrape_update)  \
-  X(net_fetch_state)    \
-  X(net_create_message) \
-  X(net_write_message)  \
-  X(process_info_wait)
+#define TIMER_NAMES            \
+  X(net_scrape_read)           \
+  X(net_scrape_update)         \
+  X(net_fetch_state)           \
+  X(net_create_message)        \
+  X(net_write_message)         \
+  X(net_write_checkpoint)      \
+  X(process_info_wait)         \
+  X(process_existing_snapshot) \
+  X(process_existing_send)     \
+  X(scheduler_task_lateness)
 
 #define COUNTER_NAMES                       \
   X(net_conn_updates)                       \
@@ -25,12 +30,17 @@
   X(net_cep_inactive)                       \
   X(net_known_ip_networks)                  \
   X(net_known_public_ips)                   \
+  X(net_tracked_containers)                 \
+  X(net_max_container_conns)                \
+  X(net_container_limit_drops)              \
+  X(net_conn_worker_inline)                 \
   X(process_lineage_counts)                 \
   X(process_lineage_total)                  \
   X(process_lineage_sqr_total)              \
   X(process_lineage_string_total)           \
   X(process_info_hit)                       \
   X(process_info_miss)                      \
+  X(process_existing_waits)                 \
   X(rate_limit_flushing_counts)             \
   X(procfs_could_not_open_fd_dir)           \
   X(procfs_could_not_open_proc_dir)         \
@@ -40,7 +50,28 @@
   X(procfs_could_not_read_exe)              \
   X(procfs_could_not_read_cmdline)          \
   X(event_timestamp_distant_past)           \
-  X(event_timestamp_future)
+  X(event_timestamp_future)                 \
+  X(cgroup_cpu_nr_periods)                  \
+  X(cgroup_cpu_nr_throttled)                \
+  X(cgroup_cpu_throttled_usec)              \
+  X(cgroup_cpu_quota_usec)                  \
+  X(cpu_budget_paced_usec)                  \
+  X(scheduler_deferred_runs)
+
+// Locks whose contention is profiled, see ProfiledMutex.
+#define LOCK_NAMES                \
+  X(lock_conn_tracker)            \
+  X(lock_sysdig_process_requests)
+
+// Startup phases, recorded once per process lifetime. Phases may overlap, as
+// the ones not depending on Sensor connectivity run concurrently.
+#define STARTUP_PHASE_NAMES \
+  X(startup)                \
+  X(sensor_connectivity)    \
+  X(network_setup)          \
+  X(sysdig_init)            \
+  X(sysdig_start)           \
+  X(first_event)
 
 namespace collector {
 
@@ -84,12 +115,75 @@ class CollectorStats {
     counter_[index] += val;
   }
 
+#define X(n) n,
+  enum StartupPhase {
+    STARTUP_PHASE_NAMES
+        X(startup_phase_max)
+  };
+#undef X
+  static std::array<std::string, startup_phase_max> startup_phase_to_name;
+
+  // Begin and end of a startup phase, in microseconds since epoch. A value of
+  // zero means the phase has not begun (or ended) yet.
+  inline int64_t GetStartupPhaseBegin(size_t index) const { return startup_begin_us_[index]; }
+  inline int64_t GetStartupPhaseEnd(size_t index) const { return startup_end_us_[index]; }
+  inline void StartupPhaseBegin(size_t index) { startup_begin_us_[index] = NowMicros(); }
+  inline void StartupPhaseEnd(size_t index) { startup_end_us_[index] = NowMicros(); }
+
+#define X(n) n,
+  enum LockType {
+    LOCK_NAMES
+        X(lock_type_max)
+  };
+#undef X
+  static std::array<std::string, lock_type_max> lock_type_to_name;
+
+  // Lock wait and hold times are recorded in histograms with power of two
+  // buckets: bucket 0 counts durations below 1us, bucket i those in
+  // [2^(i-1), 2^i) us, and the last one all the longer ones.
+  static constexpr int kLockHistogramBuckets = 20;
+  static inline int LockHistogramBucket(int64_t duration_us) {
+    if (duration_us < 1) return 0;
+    return std::min(64 - __builtin_clzll(duration_us), kLockHistogramBuckets - 1);
+  }
+
+  inline int64_t GetLockAcquisitions(size_t index) const { return lock_acquisitions_[index]; }
+  inline int64_t GetLockContentions(size_t index) const { return lock_contentions_[index]; }
+  inline int64_t GetLockWaitMicros(size_t index) const { return lock_wait_us_[index]; }
+  inline int64_t GetLockHoldMicros(size_t index) const { return lock_hold_us_[index]; }
+  inline int64_t GetLockWaitBucket(size_t index, int bucket) const { return lock_wait_buckets_[index][bucket]; }
+  inline int64_t GetLockHoldBucket(size_t index, int bucket) const { return lock_hold_buckets_[index][bucket]; }
+  inline void LockAcquired(size_t index) {
+    lock_acquisitions_[index].fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void LockContended(size_t index, int64_t wait_us) {
+    lock_contentions_[index].fetch_add(1, std::memory_order_relaxed);
+    lock_wait_us_[index].fetch_add(wait_us, std::memory_order_relaxed);
+    lock_wait_buckets_[index][LockHistogramBucket(wait_us)].fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void LockReleased(size_t index, int64_t hold_us) {
+    lock_hold_us_[index].fetch_add(hold_us, std::memory_order_relaxed);
+    lock_hold_buckets_[index][LockHistogramBucket(hold_us)].fetch_add(1, std::memory_order_relaxed);
+  }
+
  private:
+  using LockHistogram = std::array<std::atomic<int64_t>, kLockHistogramBuckets>;
+
   std::array<std::atomic<int64_t>, timer_type_max> timer_count_ = {{}};
   std::array<std::atomic<int64_t>, timer_type_max> timer_total_us_ = {{}};
 
   std::array<std::atomic<int64_t>, counter_type_max> counter_ = {{}};
 
+  std::array<std::atomic<int64_t>, startup_phase_max> startup_begin_us_ = {{}};
+  std::array<std::atomic<int64_t>, startup_phase_max> startup_end_us_ = {{}};
+
+  std::array<std::atomic<int64_t>, lock_type_max> lock_acquisitions_ = {{}};
+  std::array<std::atomic<int64_t>, lock_type_max> lock_contentions_ = {{}};
+  std::array<std::atomic<int64_t>, lock_type_max> lock_wait_us_ = {{}};
+  std::array<std::atomic<int64_t>, lock_type_max> lock_hold_us_ = {{}};
+  std::array<LockHistogram, lock_type_max> lock_wait_buckets_ = {};
+  std::array<LockHistogram, lock_type_max> lock_hold_buckets_ = {};
+
   CollectorStats(){};
 };
 
@@ -126,11 +220,36 @@ ScopedTimer<T> scoped_timer(T* timer_array, size_t index) {
   return ScopedTimer<T>(timer_array, index);
 }
 
+template <typename T>
+class ScopedStartupPhase {
+ public:
+  ScopedStartupPhase(T* stats, size_t index) : stats_(stats), index_(index) {
+    stats_->StartupPhaseBegin(index_);
+  }
+  ~ScopedStartupPhase() {
+    stats_->StartupPhaseEnd(index_);
+  }
+  constexpr operator bool() const { return true; }
+
+ private:
+  T* stats_;
+  size_t index_;
+};
+
+template <typename T>
+ScopedStartupPhase<T> scoped_startup_phase(T* stats, size_t index) {
+  return ScopedStartupPhase<T>(stats, index);
+}
+
 }  // namespace internal
 
 #define SCOPED_TIMER(i) auto __scoped_timer_##__LINE__ = internal::scoped_timer(&CollectorStats::GetOrCreate(), i)
 #define WITH_TIMER(i) if (SCOPED_TIMER(i))
 
+#define WITH_STARTUP_PHASE(i) if (auto __scoped_startup_phase_##__LINE__ = internal::scoped_startup_phase(&CollectorStats::GetOrCreate(), i))
+#define STARTUP_PHASE_BEGIN(i) CollectorStats::GetOrCreate().StartupPhaseBegin(i);
+#define STARTUP_PHASE_END(i) CollectorStats::GetOrCreate().StartupPhaseEnd(i);
+
 #define COUNTER_SET(i, v) CollectorStats::GetOrCreate().CounterSet(i, static_cast<int64_t>(v));
 #define COUNTER_ADD(i, v) CollectorStats::GetOrCreate().CounterAdd(i, static_cast<int64_t>(v));
 
@@ -0,0 +1,205 @@
+#include "CollectorStatsCollectable.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "MemoryAccounting.h"
+#include "Sysdig.h"
+
+namespace collector {
+
+namespace {
+
+prometheus::ClientMetric MakeGauge(std::vector<prometheus::ClientMetric::Label> labels, double value) {
+  prometheus::ClientMetric metric;
+  metric.label = std::move(labels);
+  metric.gauge.value = value;
+  return metric;
+}
+
+prometheus::MetricFamily MakeFamily(std::string name, std::string help) {
+  prometheus::MetricFamily family;
+  family.name = std::move(name);
+  family.help = std::move(help);
+  family.type = prometheus::MetricType::Gauge;
+  return family;
+}
+
+// Converts a lock histogram of CollectorStats, read with get_bucket.
+template <typename Fn>
+prometheus::ClientMetric MakeLockHistogram(const std::string& lock, int64_t total_us, Fn get_bucket) {
+  prometheus::ClientMetric metric;
+  metric.label = {{"lock", lock}};
+  metric.histogram.sample_sum = total_us;
+
+  uint64_t cumulative_count = 0;
+  for (int b = 0; b < CollectorStats::kLockHistogramBuckets; b++) {
+    cumulative_count += get_bucket(b);
+    bool last = b == CollectorStats::kLockHistogramBuckets - 1;
+    metric.histogram.bucket.push_back({cumulative_count, last ? INFINITY : static_cast<double>(int64_t{1} << b)});
+  }
+  metric.histogram.sample_count = cumulative_count;
+
+  return metric;
+}
+
+}  // namespace
+
+CollectorStatsCollectable::CollectorStatsCollectable(StatsSource get_stats, std::vector<EventType> event_types)
+    : get_stats_(std::move(get_stats)),
+      event_types_(std::move(event_types)),
+      stats_(std::make_unique<SysdigStats>()) {
+  idle_events_.reserve(event_types_.size());
+  for (size_t i = 0; i < event_types_.size(); i++) {
+    if (event_types_[i].id >= 0 && event_types_[i].id < PPM_EVENT_MAX) {
+      idle_events_.push_back(i);
+    }
+  }
+}
+
+CollectorStatsCollectable::~CollectorStatsCollectable() = default;
+
+std::vector<prometheus::MetricFamily> CollectorStatsCollectable::Collect() const {
+  std::vector<prometheus::MetricFamily> families;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  CollectEvents(&families);
+  CollectTimers(&families);
+  CollectLocks(&families);
+  CollectMemory(&families);
+
+  return families;
+}
+
+void CollectorStatsCollectable::CollectEvents(std::vector<prometheus::MetricFamily>* families) const {
+  if (!get_stats_ || !get_stats_(stats_.get())) {
+    return;
+  }
+  const SysdigStats& stats = *stats_;
+
+  // Only the event types not seen so far are checked for activity.
+  auto seen = std::stable_partition(idle_events_.begin(), idle_events_.end(), [&](size_t i) {
+    int id = event_types_[i].id;
+    return stats.nUserspaceEvents[id] == 0 && stats.event_process_micros[id] == 0;
+  });
+  if (seen != idle_events_.end()) {
+    active_events_.insert(active_events_.end(), seen, idle_events_.end());
+    idle_events_.erase(seen, idle_events_.end());
+    std::sort(active_events_.begin(), active_events_.end());
+  }
+
+  if (active_events_.empty()) {
+    return;
+  }
+
+  auto counts = MakeFamily("rox_collector_events_typed", "Collector events by event type");
+  auto times_total = MakeFamily("rox_collector_event_times_us_total", "Collector event timings (total)");
+  auto times_avg = MakeFamily("rox_collector_event_times_us_avg", "Collector event timings (average)");
+  counts.metric.reserve(active_events_.size());
+  times_total.metric.reserve(2 * active_events_.size());
+  times_avg.metric.reserve(2 * active_events_.size());
+
+  for (size_t i : active_events_) {
+    const auto& event_type = event_types_[i];
+    uint64_t userspace = stats.nUserspaceEvents[event_type.id];
+    uint64_t filtered = stats.nFilteredEvents[event_type.id];
+    uint64_t parse_micros = stats.event_parse_micros[event_type.id];
+    uint64_t process_micros = stats.event_process_micros[event_type.id];
+
+    counts.metric.push_back(MakeGauge({{"quantity", "userspace"}, {"event_type", event_type.name}, {"event_dir", event_type.dir}}, userspace));
+
+    times_total.metric.push_back(MakeGauge({{"step", "parse"}, {"event_type", event_type.name}, {"event_dir", event_type.dir}}, parse_micros));
+    times_total.metric.push_back(MakeGauge({{"step", "process"}, {"event_type", event_type.name}, {"event_dir", event_type.dir}}, process_micros));
+
+    times_avg.metric.push_back(MakeGauge({{"step", "parse"}, {"event_type", event_type.name}, {"event_dir", event_type.dir}},
+                                         userspace ? parse_micros / userspace : 0));
+    times_avg.metric.push_back(MakeGauge({{"step", "process"}, {"event_type", event_type.name}, {"event_dir", event_type.dir}},
+                                         filtered ? process_micros / filtered : 0));
+  }
+
+  families->push_back(std::move(counts));
+  families->push_back(std::move(times_total));
+  families->push_back(std::move(times_avg));
+}
+
+void CollectorStatsCollectable::CollectTimers(std::vector<prometheus::MetricFamily>* families) const {
+  auto& collector_stats = CollectorStats::GetOrCreate();
+
+  for (int i = 0; i < CollectorStats::timer_type_max; i++) {
+    if (!active_timers_[i] && collector_stats.GetTimerCount(i) > 0) {
+      active_timers_.set(i);
+    }
+  }
+
+  if (active_timers_.none()) {
+    return;
+  }
+
+  auto timers = MakeFamily("rox_collector_timers", "Collector timers");
+  timers.metric.reserve(3 * active_timers_.count());
+  for (int i = 0; i < CollectorStats::timer_type_max; i++) {
+    if (!active_timers_[i]) {
+      continue;
+    }
+    const auto& name = CollectorStats::timer_type_to_name[i];
+    int64_t count = collector_stats.GetTimerCount(i);
+    int64_t total_us = collector_stats.GetTimerDurationMicros(i);
+
+    timers.metric.push_back(MakeGauge({{"type", name + "_events"}}, count));
+    timers.metric.push_back(MakeGauge({{"type", name + "_times_us_total"}}, total_us));
+    timers.metric.push_back(MakeGauge({{"type", name + "_times_us_avg"}}, count ? total_us / count : 0));
+  }
+
+  families->push_back(std::move(timers));
+}
+
+void CollectorStatsCollectable::CollectLocks(std::vector<prometheus::MetricFamily>* families) const {
+  auto& collector_stats = CollectorStats::GetOrCreate();
+
+  auto acquisitions = MakeFamily("rox_collector_lock_acquisitions", "Collector lock acquisitions, while lock profiling is enabled");
+  auto wait = MakeFamily("rox_collector_lock_wait_us", "Time waited for contended collector locks");
+  wait.type = prometheus::MetricType::Histogram;
+  auto hold = MakeFamily("rox_collector_lock_hold_us", "Time collector locks were held");
+  hold.type = prometheus::MetricType::Histogram;
+
+  for (int i = 0; i < CollectorStats::lock_type_max; i++) {
+    int64_t num_acquisitions = collector_stats.GetLockAcquisitions(i);
+    if (num_acquisitions == 0) {
+      continue;
+    }
+    const auto& name = CollectorStats::lock_type_to_name[i];
+
+    acquisitions.metric.push_back(MakeGauge({{"lock", name}, {"type", "total"}}, num_acquisitions));
+    acquisitions.metric.push_back(MakeGauge({{"lock", name}, {"type", "contended"}}, collector_stats.GetLockContentions(i)));
+    wait.metric.push_back(MakeLockHistogram(name, collector_stats.GetLockWaitMicros(i),
+                                            [&](int b) { return collector_stats.GetLockWaitBucket(i, b); }));
+    hold.metric.push_back(MakeLockHistogram(name, collector_stats.GetLockHoldMicros(i),
+                                            [&](int b) { return collector_stats.GetLockHoldBucket(i, b); }));
+  }
+
+  if (acquisitions.metric.empty()) {
+    return;
+  }
+  families->push_back(std::move(acquisitions));
+  families->push_back(std::move(wait));
+  families->push_back(std::move(hold));
+}
+
+void CollectorStatsCollectable::CollectMemory(std::vector<prometheus::MetricFamily>* families) const {
+  auto usage = MemoryAccounting::GetOrCreate().Collect();
+  if (usage.empty()) {
+    return;
+  }
+
+  auto bytes = MakeFamily("rox_collector_memory_bytes", "Approximate memory used by collector subsystems");
+  auto entries = MakeFamily("rox_collector_memory_entries", "Number of entries held by collector subsystems");
+  for (const auto& subsystem : usage) {
+    bytes.metric.push_back(MakeGauge({{"subsystem", subsystem.first}}, subsystem.second.bytes));
+    entries.metric.push_back(MakeGauge({{"subsystem", subsystem.first}}, subsystem.second.entries));
+  }
+
+  families->push_back(std::move(bytes));
+  families->push_back(std::move(entries));
+}
+
+}  // namespace collector
@@ -0,0 +1,61 @@
+#ifndef COLLECTOR_COLLECTORSTATSCOLLECTABLE_H
+#define COLLECTOR_COLLECTORSTATSCOLLECTABLE_H
+
+#include <bitset>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "CollectorStats.h"
+#include "prometheus/collectable.h"
+#include "prometheus/metric_family.h"
+
+namespace collector {
+
+struct SysdigStats;
+
+// CollectorStatsCollectable computes the per event type metrics, the
+// collector timers, the lock profiles and the memory used by each subsystem,
+// when they are collected by Prometheus. Most event types never occur, hence a series is only exported
+// once the event type, timer or lock it describes has been seen, and stays
+// exported from then on.
+class CollectorStatsCollectable : public prometheus::Collectable {
+ public:
+  using StatsSource = std::function<bool(SysdigStats*)>;
+
+  struct EventType {
+    int id;
+    std::string name;
+    std::string dir;  // ">" for enter events, "<" for exit events
+  };
+
+  // Only the given event types are exported.
+  CollectorStatsCollectable(StatsSource get_stats, std::vector<EventType> event_types);
+  ~CollectorStatsCollectable();
+
+  std::vector<prometheus::MetricFamily> Collect() const override;
+
+ private:
+  void CollectEvents(std::vector<prometheus::MetricFamily>* families) const;
+  void CollectTimers(std::vector<prometheus::MetricFamily>* families) const;
+  void CollectLocks(std::vector<prometheus::MetricFamily>* families) const;
+  void CollectMemory(std::vector<prometheus::MetricFamily>* families) const;
+
+  StatsSource get_stats_;
+  std::vector<EventType> event_types_;
+
+  // Collect may be called concurrently by the HTTP server threads.
+  mutable std::mutex mutex_;
+  // Reused across collections, the statistics being large.
+  std::unique_ptr<SysdigStats> stats_;
+  // Indices in event_types_ of the event types seen, and of the others.
+  mutable std::vector<size_t> active_events_;
+  mutable std::vector<size_t> idle_events_;
+  mutable std::bitset<CollectorStats::timer_type_max> active_timers_;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_COLLECTORSTATSCOLLECTABLE_H
@@ -3,136 +3,190 @@
 #include <chrono>
 #include <iostream>
 #include <math.h>
+#include <mutex>
 
 #include "Containers.h"
+#include "DDSketch.h"
 #include "EventNames.h"
 #include "Logging.h"
 #include "SysdigService.h"
+#include "ThreadPlacement.h"
 #include "Utility.h"
 #include "prometheus/gauge.h"
-#include "prometheus/summary.h"
 
 namespace collector {
 
 template <typename T>
-class CollectorConnectionStatsPrometheus : public CollectorConnectionStats<T> {
+class CollectorConnectionStatsSketch : public CollectorConnectionStats<T>, public prometheus::Collectable {
  public:
-  CollectorConnectionStatsPrometheus(
-      std::shared_ptr<prometheus::Registry> registry,
+  CollectorConnectionStatsSketch(
       std::string name,
       std::string help,
-      std::chrono::milliseconds max_age,
-      const std::vector<double>& quantiles,
-      double error) : family_(prometheus::BuildSummary().Name(name).Help(help).Register(*registry)),
-                      inbound_private_summary_(family_.Add({{"dir", "in"}, {"peer", "private"}}, MakeQuantiles(quantiles, error), max_age)),
-                      inbound_public_summary_(family_.Add({{"dir", "in"}, {"peer", "public"}}, MakeQuantiles(quantiles, error), max_age)),
-                      outbound_private_summary_(family_.Add({{"dir", "out"}, {"peer", "private"}}, MakeQuantiles(quantiles, error), max_age)),
-                      outbound_public_summary_(family_.Add({{"dir", "out"}, {"peer", "public"}}, MakeQuantiles(quantiles, error), max_age)) {}
+      std::chrono::milliseconds window,
+      std::vector<double> quantiles,
+      double relative_accuracy) : name_(std::move(name)),
+                                  help_(std::move(help)),
+                                  quantiles_(std::move(quantiles)) {
+    for (int i = 0; i < kNumSeries; i++) {
+      series_.push_back({SlidingDDSketch(relative_accuracy, window), DDSketch(kExportedAccuracy, kExportedMinValue, kExportedMaxValue)});
+    }
+  }
 
   void Observe(T inbound_private, T inbound_public, T outbound_private, T outbound_public) override {
-    inbound_private_summary_.Observe(inbound_private);
-    inbound_public_summary_.Observe(inbound_public);
-    outbound_private_summary_.Observe(outbound_private);
-    outbound_public_summary_.Observe(outbound_public);
+    std::lock_guard<std::mutex> lock(mutex_);
+    T values[kNumSeries] = {inbound_private, inbound_public, outbound_private, outbound_public};
+    for (int i = 0; i < kNumSeries; i++) {
+      series_[i].window.Add(values[i]);
+      series_[i].cumulative.Add(values[i]);
+    }
   }
 
- private:
-  prometheus::Family<prometheus::Summary>& family_;
-  prometheus::Summary& inbound_private_summary_;
-  prometheus::Summary& inbound_public_summary_;
-  prometheus::Summary& outbound_private_summary_;
-  prometheus::Summary& outbound_public_summary_;
+  // Exports the quantiles over the window as a summary, and the bins of the
+  // cumulative sketch as counters, which can be summed across collectors.
+  // The cumulative sketch has a fixed, coarser, accuracy and a fixed range, to
+  // bound the number of exported series and keep the same bins everywhere.
+  std::vector<prometheus::MetricFamily> Collect() const override {
+    prometheus::MetricFamily summary;
+    summary.name = name_;
+    summary.help = help_;
+    summary.type = prometheus::MetricType::Summary;
+
+    prometheus::MetricFamily bins;
+    bins.name = name_ + "_sketch";
+    bins.help = help_ + " (sketch bins)";
+    bins.type = prometheus::MetricType::Counter;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < kNumSeries; i++) {
+      auto& series = series_[i];
+
+      DDSketch window = series.window.Snapshot();
+      prometheus::ClientMetric metric;
+      metric.label = {{"dir", kLabels[i].dir}, {"peer", kLabels[i].peer}};
+      metric.summary.sample_count = window.count();
+      metric.summary.sample_sum = window.sum();
+      for (double q : quantiles_) {
+        metric.summary.quantile.push_back({q, window.Quantile(q)});
+      }
+      summary.metric.push_back(std::move(metric));
+
+      auto add_bin = [&](const std::string& bin, uint64_t count) {
+        prometheus::ClientMetric metric;
+        metric.label = {{"dir", kLabels[i].dir}, {"peer", kLabels[i].peer}, {"bin", bin}};
+        metric.counter.value = count;
+        bins.metric.push_back(std::move(metric));
+      };
+      if (series.cumulative.zero_count()) {
+        add_bin("zero", series.cumulative.zero_count());
+      }
+      series.cumulative.ForEachBin([&](int index, uint64_t count) { add_bin(std::to_string(index), count); });
+    }
 
-  prometheus::Summary::Quantiles MakeQuantiles(std::vector<double> quantiles, double error) {
-    prometheus::Summary::Quantiles result;
+    return {std::move(summary), std::move(bins)};
+  }
 
-    result.reserve(quantiles.size());
+ private:
+  static constexpr int kNumSeries = 4;
+  // Bins of 10% relative width, the 186 of them (indexes -46 to 139) covering
+  // values from 0.01 to 10^6. Values out of the range are counted in the
+  // first or last bin.
+  static constexpr double kExportedAccuracy = 0.05;
+  static constexpr double kExportedMinValue = 0.01;
+  static constexpr double kExportedMaxValue = 1e6;
+  struct SeriesLabels {
+    const char* dir;
+    const char* peer;
+  };
+  static constexpr SeriesLabels kLabels[kNumSeries] = {{"in", "private"}, {"in", "public"}, {"out", "private"}, {"out", "public"}};
+
+  struct Series {
+    SlidingDDSketch window;
+    DDSketch cumulative;
+  };
+
+  std::string name_;
+  std::string help_;
+  std::vector<double> quantiles_;
+
+  mutable std::mutex mutex_;
+  // Snapshots of the windows rotate them, hence the mutability.
+  mutable std::vector<Series> series_;
+};
 
-    auto make_quantile = [error](double q) -> prometheus::detail::CKMSQuantiles::Quantile {
-      return {q, error};
-    };
+namespace {
 
-    std::transform(quantiles.begin(), quantiles.end(), std::back_inserter(result), make_quantile);
+// The event types of the configured syscalls, the only ones exported.
+std::vector<CollectorStatsCollectable::EventType> ConfiguredEventTypes(const CollectorConfig& config) {
+  const auto& active_syscalls = config.Syscalls();
+  UnorderedSet<std::string> syscall_set(active_syscalls.begin(), active_syscalls.end());
 
-    return result;
+  std::vector<CollectorStatsCollectable::EventType> event_types;
+  const auto& event_names = EventNames::GetInstance();
+  for (int i = 0; i < PPM_EVENT_MAX; i++) {
+    const auto& event_name = event_names.GetEventName(i);
+    if (Contains(syscall_set, event_name)) {
+      event_types.push_back({i, event_name, PPME_IS_ENTER(i) ? ">" : "<"});
+    }
   }
-};
+  return event_types;
+}
+
+}  // namespace
 
-CollectorStatsExporter::CollectorStatsExporter(std::shared_ptr<prometheus::Registry> registry, const CollectorConfig* config, SysdigService* sysdig)
+CollectorStatsExporter::CollectorStatsExporter(std::shared_ptr<prometheus::Registry> registry, const CollectorConfig* config, SysdigService* sysdig, Scheduler* scheduler)
     : registry_(std::move(registry)),
       config_(config),
       sysdig_(sysdig),
-      connections_total_reporter_(std::make_shared<CollectorConnectionStatsPrometheus<unsigned int>>(
-          registry_,
+      scheduler_(scheduler),
+      connections_total_reporter_(std::make_shared<CollectorConnectionStatsSketch<unsigned int>>(
           "rox_connections_total",
           "Amount of stored connections over time",
           std::chrono::minutes{config->GetConnectionStatsWindow()},
           config->GetConnectionStatsQuantiles(),
           config->GetConnectionStatsError())),
-      connections_rate_reporter_(std::make_shared<CollectorConnectionStatsPrometheus<float>>(
-          registry_,
+      connections_rate_reporter_(std::make_shared<CollectorConnectionStatsSketch<float>>(
           "rox_connections_rate",
           "Rate of connections over time",
           std::chrono::minutes{config->GetConnectionStatsWindow()},
           config->GetConnectionStatsQuantiles(),
-          config->GetConnectionStatsError())) {}
+          config->GetConnectionStatsError())),
+      stats_collectable_(std::make_shared<CollectorStatsCollectable>(
+          [sysdig](SysdigStats* stats) { return sysdig->GetStats(stats); },
+          ConfiguredEventTypes(*config))) {
+  collectables_ = {
+      stats_collectable_,
+      std::static_pointer_cast<CollectorConnectionStatsSketch<unsigned int>>(connections_total_reporter_),
+      std::static_pointer_cast<CollectorConnectionStatsSketch<float>>(connections_rate_reporter_),
+  };
+}
 
 bool CollectorStatsExporter::start() {
-  if (!thread_.Start(&CollectorStatsExporter::run, this)) {
+  if (task_) {
     CLOG(ERROR) << "Could not start stats exporter: already running";
     return false;
   }
-  return true;
-}
-
-class CollectorTimerGauge {
- public:
-  CollectorTimerGauge(prometheus::Family<prometheus::Gauge>& g, const std::string& timer_name)
-      : events_(&g.Add({{"type", timer_name + "_events"}})),
-        times_us_total_(&g.Add({{"type", timer_name + "_times_us_total"}})),
-        times_us_avg_(&g.Add({{"type", timer_name + "_times_us_avg"}})) {}
-
-  void Update(int64_t count, int64_t total_us) {
-    events_->Set(count);
-    times_us_total_->Set(total_us);
-    times_us_avg_->Set(count ? total_us / count : 0);
-  }
 
- private:
-  prometheus::Gauge* events_;
-  prometheus::Gauge* times_us_total_;
-  prometheus::Gauge* times_us_avg_;
-};
-
-void CollectorStatsExporter::run() {
   auto& collectorEventCounters = prometheus::BuildGauge()
                                      .Name("rox_collector_events")
                                      .Help("Collector events")
                                      .Register(*registry_);
 
-  auto& kernel = collectorEventCounters.Add({{"type", "kernel"}});
-  auto& drops = collectorEventCounters.Add({{"type", "drops"}});
-  auto& preemptions = collectorEventCounters.Add({{"type", "preemptions"}});
-  auto& userspaceEvents = collectorEventCounters.Add({{"type", "userspace"}});
-  auto& grpcSendFailures = collectorEventCounters.Add({{"type", "grpcSendFailures"}});
-  auto& threadTableSize = collectorEventCounters.Add({{"type", "threadCacheSize"}});
-
-  auto& processSent = collectorEventCounters.Add({{"type", "processSent"}});
-  auto& processSendFailures = collectorEventCounters.Add({{"type", "processSendFailures"}});
-  auto& processResolutionFailuresByEvt = collectorEventCounters.Add({{"type", "processResolutionFailuresByEvt"}});
-  auto& processResolutionFailuresByTinfo = collectorEventCounters.Add({{"type", "processResolutionFailuresByTinfo"}});
-  auto& processRateLimitCount = collectorEventCounters.Add({{"type", "processRateLimitCount"}});
-
-  auto& collector_timers_gauge = prometheus::BuildGauge()
-                                     .Name("rox_collector_timers")
-                                     .Help("Collector timers")
-                                     .Register(*registry_);
-  std::array<std::unique_ptr<CollectorTimerGauge>, CollectorStats::timer_type_max> collector_timers;
-  for (int i = 0; i < CollectorStats::timer_type_max; i++) {
-    auto tt = (CollectorStats::TimerType)(i);
-    collector_timers[tt] = MakeUnique<CollectorTimerGauge>(collector_timers_gauge,
-                                                           CollectorStats::timer_type_to_name[tt]);
-  }
+  auto* kernel = &collectorEventCounters.Add({{"type", "kernel"}});
+  auto* drops = &collectorEventCounters.Add({{"type", "drops"}});
+  auto* preemptions = &collectorEventCounters.Add({{"type", "preemptions"}});
+  auto* userspaceEvents = &collectorEventCounters.Add({{"type", "userspace"}});
+  auto* grpcSendFailures = &collectorEventCounters.Add({{"type", "grpcSendFailures"}});
+  auto* threadTableSize = &collectorEventCounters.Add({{"type", "threadCacheSize"}});
+
+  auto* processSent = &collectorEventCounters.Add({{"type", "processSent"}});
+  auto* processSendFailures = &collectorEventCounters.Add({{"type", "processSendFailures"}});
+  auto* processResolutionFailuresByEvt = &collectorEventCounters.Add({{"type", "processResolutionFailuresByEvt"}});
+  auto* processResolutionFailuresByTinfo = &collectorEventCounters.Add({{"type", "processResolutionFailuresByTinfo"}});
+  auto* processRateLimitCount = &collectorEventCounters.Add({{"type", "processRateLimitCount"}});
+
+  auto* logRecords = &collectorEventCounters.Add({{"type", "logRecords"}});
+  auto* logDrops = &collectorEventCounters.Add({{"type", "logDrops"}});
+
   auto& collector_counters_gauge = prometheus::BuildGauge()
                                        .Name("rox_collector_counters")
                                        .Help("Collector counters")
@@ -143,20 +197,19 @@ void CollectorStatsExporter::run() {
     collector_counters[ct] = &(collector_counters_gauge.Add({{"type", CollectorStats::counter_type_to_name[ct]}}));
   }
 
-  auto& collectorTypedEventCounters = prometheus::BuildGauge()
-                                          .Name("rox_collector_events_typed")
-                                          .Help("Collector events by event type")
-                                          .Register(*registry_);
-
-  auto& collectorTypedEventTimesTotal = prometheus::BuildGauge()
-                                            .Name("rox_collector_event_times_us_total")
-                                            .Help("Collector event timings (total)")
-                                            .Register(*registry_);
-
-  auto& collectorTypedEventTimesAvg = prometheus::BuildGauge()
-                                          .Name("rox_collector_event_times_us_avg")
-                                          .Help("Collector event timings (average)")
-                                          .Register(*registry_);
+  auto& collector_startup_gauge = prometheus::BuildGauge()
+                                      .Name("rox_collector_startup_phases")
+                                      .Help("Collector startup timeline (phase offsets from the start of startup, and durations)")
+                                      .Register(*registry_);
+  struct {
+    prometheus::Gauge* begin_offset_us;
+    prometheus::Gauge* duration_us;
+  } startup_phases[CollectorStats::startup_phase_max];
+  for (int i = 0; i < CollectorStats::startup_phase_max; i++) {
+    const auto& phase_name = CollectorStats::startup_phase_to_name[i];
+    startup_phases[i].begin_offset_us = &collector_startup_gauge.Add({{"phase", phase_name}, {"type", "begin_offset_us"}});
+    startup_phases[i].duration_us = &collector_startup_gauge.Add({{"phase", phase_name}, {"type", "duration_us"}});
+  }
 
   auto& collectorProcessLineageInfo = prometheus::BuildGauge()
                                           .Name("rox_collector_process_lineage_info")
@@ -168,93 +221,64 @@ void CollectorStatsExporter::run() {
   prometheus::Gauge* lineage_std_dev = &collectorProcessLineageInfo.Add({{"type", "std_dev"}});
   prometheus::Gauge* lineage_avg_string_len = &collectorProcessLineageInfo.Add({{"type", "lineage_avg_string_len"}});
 
-  struct {
-    prometheus::Gauge* userspace = nullptr;
-
-    prometheus::Gauge* parse_micros_total = nullptr;
-    prometheus::Gauge* process_micros_total = nullptr;
-
-    prometheus::Gauge* parse_micros_avg = nullptr;
-    prometheus::Gauge* process_micros_avg = nullptr;
-  } typed[PPM_EVENT_MAX] = {};
-
-  const auto& active_syscalls = config_->Syscalls();
-  UnorderedSet<std::string> syscall_set(active_syscalls.begin(), active_syscalls.end());
-
-  const auto& event_names = EventNames::GetInstance();
-  for (int i = 0; i < PPM_EVENT_MAX; i++) {
-    const auto& event_name = event_names.GetEventName(i);
-
-    if (!Contains(syscall_set, event_name)) {
-      continue;
-    }
-
-    const char* event_dir = PPME_IS_ENTER(i) ? ">" : "<";
-
-    typed[i].userspace = &collectorTypedEventCounters.Add(
-        std::map<std::string, std::string>{{"quantity", "userspace"}, {"event_type", event_name}, {"event_dir", event_dir}});
-
-    typed[i].parse_micros_total = &collectorTypedEventTimesTotal.Add(
-        std::map<std::string, std::string>{{"step", "parse"}, {"event_type", event_name}, {"event_dir", event_dir}});
-    typed[i].process_micros_total = &collectorTypedEventTimesTotal.Add(
-        std::map<std::string, std::string>{{"step", "process"}, {"event_type", event_name}, {"event_dir", event_dir}});
-
-    typed[i].parse_micros_avg = &collectorTypedEventTimesAvg.Add(
-        std::map<std::string, std::string>{{"step", "parse"}, {"event_type", event_name}, {"event_dir", event_dir}});
-    typed[i].process_micros_avg = &collectorTypedEventTimesAvg.Add(
-        std::map<std::string, std::string>{{"step", "process"}, {"event_type", event_name}, {"event_dir", event_dir}});
-  }
+  auto* collectorThreadCPU = &prometheus::BuildGauge()
+                                  .Name("rox_collector_thread_cpu_seconds")
+                                  .Help("CPU time used by the collector threads, summed by thread name")
+                                  .Register(*registry_);
+  UnorderedMap<std::string, std::pair<prometheus::Gauge*, prometheus::Gauge*>> thread_cpu_gauges;
+  std::vector<ThreadCPUUsage> thread_cpu_usage;
 
-  while (thread_.Pause(std::chrono::seconds(5))) {
+  // The gauges are owned by the registry, the task only keeps pointers to them.
+  auto export_stats = [=]() mutable {
     SysdigStats stats;
     if (!sysdig_->GetStats(&stats)) {
-      continue;
+      return;
     }
 
-    kernel.Set(stats.nEvents);
-    drops.Set(stats.nDrops);
-    preemptions.Set(stats.nPreemptions);
-    threadTableSize.Set(stats.nThreadCacheSize);
+    kernel->Set(stats.nEvents);
+    drops->Set(stats.nDrops);
+    preemptions->Set(stats.nPreemptions);
+    threadTableSize->Set(stats.nThreadCacheSize);
 
+    // The per event type metrics are computed on collection, by the
+    // CollectorStatsCollectable.
     uint64_t nUserspace = 0;
     for (int i = 0; i < PPM_EVENT_MAX; i++) {
-      auto& counters = typed[i];
-
-      auto userspace = stats.nUserspaceEvents[i];
-      auto parse_micros_total = stats.event_parse_micros[i];
-      auto process_micros_total = stats.event_process_micros[i];
-
-      nUserspace += userspace;
-
-      if (counters.userspace) counters.userspace->Set(userspace);
-
-      if (counters.parse_micros_total) counters.parse_micros_total->Set(parse_micros_total);
-      if (counters.process_micros_total) counters.process_micros_total->Set(process_micros_total);
-
-      if (counters.parse_micros_avg) counters.parse_micros_avg->Set(userspace ? parse_micros_total / userspace : 0);
+      nUserspace += stats.nUserspaceEvents[i];
     }
 
-    userspaceEvents.Set(nUserspace);
+    userspaceEvents->Set(nUserspace);
 
-    grpcSendFailures.Set(stats.nGRPCSendFailures);
+    grpcSendFailures->Set(stats.nGRPCSendFailures);
 
     // process related metrics
-    processSent.Set(stats.nProcessSent);
-    processSendFailures.Set(stats.nProcessSendFailures);
-    processResolutionFailuresByEvt.Set(stats.nProcessResolutionFailuresByEvt);
-    processResolutionFailuresByTinfo.Set(stats.nProcessResolutionFailuresByTinfo);
-    processRateLimitCount.Set(stats.nProcessRateLimitCount);
-
-    for (int i = 0; i < CollectorStats::timer_type_max; i++) {
-      auto tt = (CollectorStats::TimerType)(i);
-      collector_timers[tt]->Update(CollectorStats::GetOrCreate().GetTimerCount(tt),
-                                   CollectorStats::GetOrCreate().GetTimerDurationMicros(tt));
-    }
+    processSent->Set(stats.nProcessSent);
+    processSendFailures->Set(stats.nProcessSendFailures);
+    processResolutionFailuresByEvt->Set(stats.nProcessResolutionFailuresByEvt);
+    processResolutionFailuresByTinfo->Set(stats.nProcessResolutionFailuresByTinfo);
+    processRateLimitCount->Set(stats.nProcessRateLimitCount);
+
+    auto log_stats = logging::GetAsyncLogStats();
+    logRecords->Set(log_stats.records);
+    logDrops->Set(log_stats.drops);
+
     for (int i = 0; i < CollectorStats::counter_type_max; i++) {
       auto ct = (CollectorStats::CounterType)(i);
       collector_counters[ct]->Set(CollectorStats::GetOrCreate().GetCounter(ct));
     }
 
+    int64_t startup_begin = CollectorStats::GetOrCreate().GetStartupPhaseBegin(CollectorStats::startup);
+    for (int i = 0; i < CollectorStats::startup_phase_max; i++) {
+      int64_t begin = CollectorStats::GetOrCreate().GetStartupPhaseBegin(i);
+      int64_t end = CollectorStats::GetOrCreate().GetStartupPhaseEnd(i);
+      if (begin == 0 || end == 0) {
+        // Not started, or still in progress.
+        continue;
+      }
+      startup_phases[i].begin_offset_us->Set(begin - startup_begin);
+      startup_phases[i].duration_us->Set(end - begin);
+    }
+
     int64_t lineage_count_stat = CollectorStats::GetOrCreate().GetCounter(CollectorStats::process_lineage_counts);
     int64_t lineage_count_total = CollectorStats::GetOrCreate().GetCounter(CollectorStats::process_lineage_total);
     int64_t lineage_count_sqr_total = CollectorStats::GetOrCreate().GetCounter(CollectorStats::process_lineage_sqr_total);
@@ -269,11 +293,38 @@ void CollectorStatsExporter::run() {
     lineage_avg->Set(lineage_count_avg);
     lineage_std_dev->Set(lineage_count_std_dev);
     lineage_avg_string_len->Set(lineage_count_string_avg);
-  }
+
+    // Threads sharing a name (e.g., workers of a pool) are reported together.
+    if (ReadThreadCPUUsage(&thread_cpu_usage)) {
+      UnorderedMap<std::string, std::pair<double, double>> usage_by_name;
+      for (const auto& usage : thread_cpu_usage) {
+        auto& total = usage_by_name[usage.name];
+        total.first += usage.user_seconds;
+        total.second += usage.system_seconds;
+      }
+      for (const auto& entry : usage_by_name) {
+        auto& gauges = thread_cpu_gauges[entry.first];
+        if (!gauges.first) {
+          gauges.first = &collectorThreadCPU->Add({{"thread", entry.first}, {"mode", "user"}});
+          gauges.second = &collectorThreadCPU->Add({{"thread", entry.first}, {"mode", "system"}});
+        }
+        gauges.first->Set(entry.second.first);
+        gauges.second->Set(entry.second.second);
+      }
+    }
+  };
+  // Not deferrable, the metrics are how throttling is noticed in the first
+  // place, and the export is cheap compared to the event processing.
+  task_ = scheduler_->SchedulePeriodic("stats_exporter", std::chrono::seconds(5), std::move(export_stats));
+
+  return true;
 }
 
 void CollectorStatsExporter::stop() {
-  thread_.Stop();
+  if (task_) {
+    scheduler_->Cancel(task_);
+    task_ = 0;
+  }
 }
 
 }  // namespace collector
@@ -2,10 +2,12 @@
 #define _COLLECTOR_STATS_EXPORTER_H_
 
 #include <memory>
+#include <vector>
 
 #include "CollectorConfig.h"
 #include "CollectorStats.h"
-#include "StoppableThread.h"
+#include "CollectorStatsCollectable.h"
+#include "Scheduler.h"
 #include "SysdigService.h"
 #include "prometheus/registry.h"
 
@@ -13,22 +15,28 @@ namespace collector {
 
 class CollectorStatsExporter {
  public:
-  CollectorStatsExporter(std::shared_ptr<prometheus::Registry> registry, const CollectorConfig* config, SysdigService* sysdig);
+  CollectorStatsExporter(std::shared_ptr<prometheus::Registry> registry, const CollectorConfig* config, SysdigService* sysdig, Scheduler* scheduler);
 
+  // Registers the metrics, and schedules their periodic update.
   bool start();
-  void run();
   void stop();
 
   std::shared_ptr<CollectorConnectionStats<unsigned int>> GetConnectionsTotalReporter() { return connections_total_reporter_; }
   std::shared_ptr<CollectorConnectionStats<float>> GetConnectionsRateReporter() { return connections_rate_reporter_; }
 
+  // The metrics computed on collection, to be registered with the exposer.
+  const std::vector<std::shared_ptr<prometheus::Collectable>>& GetCollectables() { return collectables_; }
+
  private:
   std::shared_ptr<prometheus::Registry> registry_;
   const CollectorConfig* config_;
   SysdigService* sysdig_;
   std::shared_ptr<CollectorConnectionStats<unsigned int>> connections_total_reporter_;
   std::shared_ptr<CollectorConnectionStats<float>> connections_rate_reporter_;
-  StoppableThread thread_;
+  std::shared_ptr<CollectorStatsCollectable> stats_collectable_;
+  std::vector<std::shared_ptr<prometheus::Collectable>> collectables_;
+  Scheduler* scheduler_;
+  Scheduler::TaskId task_ = 0;
 };
 
 }  // namespace collector
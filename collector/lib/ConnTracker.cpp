@@ -46,6 +46,34 @@ void ConnectionTracker::UpdateConnection(const Connection& conn, int64_t timesta
   }
 }
 
+void ConnectionTracker::UpdateConnections(const std::vector<std::pair<Connection, ConnStatus>>& updates) {
+  WITH_LOCK(mutex_) {
+    for (const auto& update : updates) {
+      EmplaceOrUpdateNoLock(update.first, update.second);
+    }
+  }
+}
+
+void ConnectionTracker::UpdateEndpoint(const ContainerEndpoint& ep, int64_t timestamp, bool added) {
+  WITH_LOCK(mutex_) {
+    if (added) {
+      EmplaceOrUpdateNoLock(ep, ConnStatus(timestamp, true));
+      return;
+    }
+
+    // The originator is not part of the hash, so all the entries for this endpoint are in the same bucket.
+    auto bucket = endpoint_state_.bucket(ep);
+    for (auto it = endpoint_state_.begin(bucket); it != endpoint_state_.end(bucket); ++it) {
+      const auto& cep = it->first;
+      if (cep.container() == ep.container() && cep.endpoint() == ep.endpoint() && cep.l4proto() == ep.l4proto() &&
+          it->second.LastActiveTime() < timestamp) {
+        COUNTER_INC(CollectorStats::net_cep_updates);
+        it->second = ConnStatus(timestamp, false);
+      }
+    }
+  }
+}
+
 void ConnectionTracker::Update(
     const std::vector<Connection>& all_conns,
     const std::vector<ContainerEndpoint>& all_listen_endpoints,
@@ -55,8 +83,12 @@ void ConnectionTracker::Update(
     for (auto& prev_conn : conn_state_) {
       prev_conn.second.SetActive(false);
     }
+    active_flow_members_.clear();
     for (auto& prev_endpoint : endpoint_state_) {
-      prev_endpoint.second.SetActive(false);
+      // Listen endpoints reported by events more recent than the scrape are kept as is.
+      if (prev_endpoint.second.LastActiveTime() <= timestamp) {
+        prev_endpoint.second.SetActive(false);
+      }
     }
 
     ConnStatus new_status(timestamp, true);
@@ -71,6 +103,23 @@ void ConnectionTracker::Update(
   }
 }
 
+void ConnectionTracker::Update(const std::vector<Connection>& all_conns, int64_t timestamp) {
+  WITH_LOCK(mutex_) {
+    // Mark all existing connections as inactive
+    for (auto& prev_conn : conn_state_) {
+      prev_conn.second.SetActive(false);
+    }
+    active_flow_members_.clear();
+
+    ConnStatus new_status(timestamp, true);
+
+    // Insert (or mark as active) all current connections.
+    for (const auto& curr_conn : all_conns) {
+      EmplaceOrUpdateNoLock(curr_conn, new_status);
+    }
+  }
+}
+
 IPNet ConnectionTracker::NormalizeAddressNoLock(const Address& address) const {
   if (address.IsNull()) {
     return {};
@@ -106,23 +155,37 @@ IPNet ConnectionTracker::NormalizeAddressNoLock(const Address& address) const {
   }
 }
 
-Connection ConnectionTracker::NormalizeConnectionNoLock(const Connection& conn) const {
-  bool is_server = conn.is_server();
-  if (conn.l4proto() == L4Proto::UDP) {
+bool ConnectionTracker::IsServerConnection(L4Proto l4proto, bool is_server, uint16_t local_port, uint16_t remote_port) {
+  if (l4proto == L4Proto::UDP) {
     // Inference of server role is unreliable for UDP, so go by port.
-    is_server = IsEphemeralPort(conn.remote().port()) > IsEphemeralPort(conn.local().port());
+    return IsEphemeralPort(remote_port) > IsEphemeralPort(local_port);
   }
+  return is_server;
+}
 
-  Endpoint local, remote = conn.remote();
+Connection ConnectionTracker::PreNormalizeConnection(const Connection& conn) {
+  bool is_server = IsServerConnection(conn);
+  if (is_server) {
+    return Connection(conn.container(), Endpoint(IPNet(Address()), conn.local().port()), Endpoint(conn.remote().network(), 0),
+                      conn.l4proto(), is_server);
+  }
+  return Connection(conn.container(), Endpoint(), conn.remote(), conn.l4proto(), is_server);
+}
+
+Connection ConnectionTracker::NormalizeConnectionNoLock(const CompactConnection& conn) const {
+  // The role of pre-normalized connections was already inferred, and their ports no longer allow it.
+  bool is_server = normalize_on_ingest_ ? conn.is_server() : IsServerConnection(conn.l4proto(), conn.is_server(), conn.local_port(), conn.remote_port());
+
+  Endpoint local, remote;
 
   if (is_server) {
     // If this is the server, only the local port is relevant, while the remote port does not matter.
-    local = Endpoint(IPNet(Address()), conn.local().port());
-    remote = Endpoint(NormalizeAddressNoLock(conn.remote().address()), 0);
+    local = Endpoint(IPNet(Address()), conn.local_port());
+    remote = Endpoint(NormalizeAddressNoLock(conn.remote_address()), 0);
   } else {
     // If this is the client, the local port and address are not relevant.
     local = Endpoint();
-    remote = Endpoint(NormalizeAddressNoLock(remote.address()), remote.port());
+    remote = Endpoint(NormalizeAddressNoLock(conn.remote_address()), conn.remote_port());
   }
 
   return Connection(conn.container(), local, remote, conn.l4proto(), is_server);
@@ -130,28 +193,114 @@ Connection ConnectionTracker::NormalizeConnectionNoLock(const Connection& conn)
 
 namespace {
 
-/* return: true if the element has been added */
+/* return: true if the element has been added, in which case it is also added to the index */
 template <typename T>
-bool EmplaceOrUpdate(UnorderedMap<T, ConnStatus>* m, const T& obj, ConnStatus status) {
-  auto emplace_res = m->emplace(obj, status);
+bool EmplaceOrUpdate(UnorderedMap<T, ConnStatus>* m, ContainerIndex<T>* index, const T& obj, ConnStatus status) {
+  // Unlike emplace, try_emplace only allocates a node if the element is not already in the map.
+  auto emplace_res = m->try_emplace(obj, status);
   if (!emplace_res.second && status.LastActiveTime() > emplace_res.first->second.LastActiveTime()) {
     emplace_res.first->second = status;
   }
+  if (emplace_res.second) {
+    index->Add(&*emplace_res.first);
+  }
   return emplace_res.second;
 }
 
+template <typename T>
+void CloseEntries(const ContainerIndex<T>& index, const std::string& container, int64_t timestamp) {
+  const auto* entries = index.Find(container);
+  if (!entries) return;
+
+  for (auto* entry : *entries) {
+    if (entry->second.IsActive() && entry->second.LastActiveTime() < timestamp) {
+      entry->second = ConnStatus(timestamp, false);
+    }
+  }
+}
+
 }  // namespace
 
 void ConnectionTracker::EmplaceOrUpdateNoLock(const Connection& conn, ConnStatus status) {
   COUNTER_INC(CollectorStats::net_conn_updates);
-  if (EmplaceOrUpdate(&conn_state_, conn, status)) {
+  if (normalize_on_ingest_ && !ShouldFetchConnection(conn)) {
+    // The ports filtered on are about to be dropped.
+    return;
+  }
+  CompactConnection key = normalize_on_ingest_ ? CompactConnection(PreNormalizeConnection(conn)) : CompactConnection(conn);
+  if (ExceedsContainerLimitNoLock(conn_state_, conn_index_, key)) {
+    COUNTER_INC(CollectorStats::net_container_limit_drops);
+    return;
+  }
+  if (normalize_on_ingest_) {
+    status = FlowStatusNoLock(key, status);
+  }
+  if (EmplaceOrUpdate(&conn_state_, &conn_index_, key, status)) {
     IncrementConnectionStats(conn, inserted_connections_counters_);
   }
 }
 
 void ConnectionTracker::EmplaceOrUpdateNoLock(const ContainerEndpoint& ep, ConnStatus status) {
   COUNTER_INC(CollectorStats::net_cep_updates);
-  EmplaceOrUpdate(&endpoint_state_, ep, status);
+  if (ExceedsContainerLimitNoLock(endpoint_state_, endpoint_index_, ep)) {
+    COUNTER_INC(CollectorStats::net_container_limit_drops);
+    return;
+  }
+  EmplaceOrUpdate(&endpoint_state_, &endpoint_index_, ep, status);
+}
+
+ConnStatus ConnectionTracker::FlowStatusNoLock(const CompactConnection& flow, ConnStatus status) {
+  // Counts left over by a flow closed as a whole (e.g. its container exited) are not carried over.
+  const ConnStatus* current = Lookup(conn_state_, flow);
+  bool flow_active = current && current->IsActive();
+
+  if (status.IsActive()) {
+    uint32_t& members = active_flow_members_[flow];
+    members = flow_active ? members + 1 : 1;
+    return status;
+  }
+
+  auto it = active_flow_members_.find(flow);
+  if (it == active_flow_members_.end()) {
+    return status;
+  }
+  if (!flow_active || it->second <= 1) {
+    active_flow_members_.erase(it);
+    return status;
+  }
+  // As when merging the connections of a flow on fetch, the open ones win.
+  it->second--;
+  return *current;
+}
+
+void ConnectionTracker::SetNormalizeOnIngest(bool enable) {
+  WITH_LOCK(mutex_) {
+    if (enable == normalize_on_ingest_) {
+      return;
+    }
+    // The stored connections are in the form of the previous mode.
+    if (!conn_state_.empty()) {
+      CLOG(WARNING) << "Dropping " << conn_state_.size() << " connections stored before changing the ingest normalization";
+      conn_state_.clear();
+      conn_index_ = ContainerIndex<CompactConnection>();
+      active_flow_members_.clear();
+    }
+    normalize_on_ingest_ = enable;
+  }
+}
+
+void ConnectionTracker::CloseContainer(const std::string& container, int64_t timestamp) {
+  WITH_LOCK(mutex_) {
+    CloseEntries(conn_index_, container, timestamp);
+    CloseEntries(endpoint_index_, container, timestamp);
+  }
+}
+
+size_t ConnectionTracker::GetContainerEntryCount(const std::string& container) {
+  WITH_LOCK(mutex_) {
+    return conn_index_.Count(container) + endpoint_index_.Count(container);
+  }
+  return 0;
 }
 
 namespace {
@@ -170,25 +319,72 @@ struct dont_filter {
   }
 };
 
-template <typename T, typename ProcessFn, typename FilterFn, typename E = std::equal_to<T>>
-UnorderedMap<T, ConnStatus, E> FetchState(UnorderedMap<T, ConnStatus>* state, bool clear_inactive,
-                                          const ProcessFn& process_fn, const FilterFn& filter_fn) {
+// Expand returns the fetched form of a stored key. It is only called for the entries which are fetched as is.
+inline const ContainerEndpoint& Expand(const ContainerEndpoint& cep) { return cep; }
+inline Connection Expand(const CompactConnection& conn) { return conn.ToConnection(); }
+
+// NodeRecycler refills a map with new entries, reusing the nodes of its previous entries instead of allocating new ones.
+template <typename Map>
+class NodeRecycler {
+ public:
+  explicit NodeRecycler(Map* map) : map_(map) {
+    size_t bucket_count = map->bucket_count();
+    spare_.swap(*map);
+    map->rehash(bucket_count);
+  }
+
+  // Inserts the entry, if its key is not in the map yet. Returns the entry with the key, and whether it was inserted.
+  template <typename K, typename V>
+  std::pair<typename Map::iterator, bool> Emplace(K&& key, const V& value) {
+    if (!node_) {
+      if (spare_.empty()) {
+        return map_->emplace(std::forward<K>(key), value);
+      }
+      node_ = spare_.extract(spare_.begin());
+    }
+
+    node_.key() = std::forward<K>(key);
+    node_.mapped() = value;
+    auto res = map_->insert(std::move(node_));
+    if (!res.inserted) {
+      // Kept for the next entry.
+      node_ = std::move(res.node);
+    }
+    return {res.position, res.inserted};
+  }
+
+ private:
+  Map* map_;
+  Map spare_;
+  typename Map::node_type node_;
+};
+
+// T is the type of the fetched keys, and K the type of the stored ones. The filter and the normalization are applied to
+// the stored keys.
+template <typename T, typename ProcessFn, typename FilterFn, typename E = std::equal_to<T>, typename K = T>
+void FetchState(UnorderedMap<K, ConnStatus>* state, ContainerIndex<K>* index, bool clear_inactive,
+                const ProcessFn& process_fn, const FilterFn& filter_fn, UnorderedMap<T, ConnStatus, E>* fetched_state) {
   constexpr bool normalize = !std::is_same<ProcessFn, dont_normalize>::value;
   constexpr bool filter = !std::is_same<FilterFn, dont_filter>::value;
 
-  UnorderedMap<T, ConnStatus, E> fetched_state;
+  NodeRecycler<UnorderedMap<T, ConnStatus, E>> recycler(fetched_state);
+
+  // The entries erased below are exactly the inactive ones.
+  if (clear_inactive) {
+    index->RemoveInactive();
+  }
 
   for (auto it = state->begin(); it != state->end();) {
     const auto& entry = *it;
 
     if (!filter || filter_fn(entry.first)) {
-      if (normalize) {
-        auto emplace_res = fetched_state.emplace(process_fn(entry.first), entry.second);
+      if constexpr (normalize) {
+        auto emplace_res = recycler.Emplace(process_fn(entry.first), entry.second);
         if (!emplace_res.second) {
           emplace_res.first->second.MergeFrom(entry.second);
         }
       } else {
-        fetched_state.insert(entry);
+        recycler.Emplace(Expand(entry.first), entry.second);
       }
     }
 
@@ -198,75 +394,83 @@ UnorderedMap<T, ConnStatus, E> FetchState(UnorderedMap<T, ConnStatus>* state, bo
       ++it;
     }
   }
-
-  return fetched_state;
 }
 
 }  // namespace
 
 ConnMap ConnectionTracker::FetchConnState(bool normalize, bool clear_inactive) {
   ConnMap cm;
+  FetchConnState(&cm, normalize, clear_inactive);
+  return cm;
+}
+
+void ConnectionTracker::FetchConnState(ConnMap* cm, bool normalize, bool clear_inactive) {
   size_t state_size;
   WITH_LOCK(mutex_) {
     state_size = conn_state_.size();
     if (HasConnectionFilters()) {
       if (normalize) {
-        cm = FetchState(
-            &conn_state_, clear_inactive,
-            [this](const Connection& conn) { return this->NormalizeConnectionNoLock(conn); },
-            [this](const Connection& conn) { return this->ShouldFetchConnection(conn); });
+        FetchState<Connection>(
+            &conn_state_, &conn_index_, clear_inactive,
+            [this](const CompactConnection& conn) { return this->NormalizeConnectionNoLock(conn); },
+            [this](const CompactConnection& conn) { return this->ShouldFetchConnection(conn); }, cm);
       } else {
-        cm = FetchState(&conn_state_, clear_inactive, dont_normalize(),
-                        [this](const Connection& conn) { return this->ShouldFetchConnection(conn); });
+        FetchState<Connection>(&conn_state_, &conn_index_, clear_inactive, dont_normalize(),
+                               [this](const CompactConnection& conn) { return this->ShouldFetchConnection(conn); }, cm);
       }
     } else {
       if (normalize) {
-        cm = FetchState(
-            &conn_state_, clear_inactive,
-            [this](const Connection& conn) { return this->NormalizeConnectionNoLock(conn); },
-            dont_filter());
+        FetchState<Connection>(
+            &conn_state_, &conn_index_, clear_inactive,
+            [this](const CompactConnection& conn) { return this->NormalizeConnectionNoLock(conn); },
+            dont_filter(), cm);
       } else {
-        cm = FetchState(&conn_state_, clear_inactive, dont_normalize(), dont_filter());
+        FetchState<Connection>(&conn_state_, &conn_index_, clear_inactive, dont_normalize(), dont_filter(), cm);
       }
     }
     COUNTER_ADD(CollectorStats::net_conn_inactive, (state_size - conn_state_.size()));
+    COUNTER_SET(CollectorStats::net_tracked_containers, conn_index_.NumContainers());
+    COUNTER_SET(CollectorStats::net_max_container_conns, conn_index_.MaxCount());
   }
-  return cm;
 }
 
 AdvertisedEndpointMap ConnectionTracker::FetchEndpointState(bool normalize, bool clear_inactive) {
   AdvertisedEndpointMap cem;
+  FetchEndpointState(&cem, normalize, clear_inactive);
+  return cem;
+}
+
+void ConnectionTracker::FetchEndpointState(AdvertisedEndpointMap* cem, bool normalize, bool clear_inactive) {
   size_t state_size;
   WITH_LOCK(mutex_) {
     state_size = conn_state_.size();
     if (HasConnectionFilters()) {
       if (normalize) {
-        cem = FetchState<ContainerEndpoint, std::function<ContainerEndpoint(const ContainerEndpoint&)>, std::function<bool(const ContainerEndpoint&)>, AdvertisedEndpointEquality>(
-            &endpoint_state_, clear_inactive,
+        FetchState<ContainerEndpoint, std::function<ContainerEndpoint(const ContainerEndpoint&)>, std::function<bool(const ContainerEndpoint&)>, AdvertisedEndpointEquality>(
+            &endpoint_state_, &endpoint_index_, clear_inactive,
             [this](const ContainerEndpoint& cep) { return this->NormalizeContainerEndpoint(cep); },
-            [this](const ContainerEndpoint& cep) { return this->ShouldFetchContainerEndpoint(cep); });
+            [this](const ContainerEndpoint& cep) { return this->ShouldFetchContainerEndpoint(cep); }, cem);
       } else {
-        cem = FetchState<ContainerEndpoint, dont_normalize, std::function<bool(const ContainerEndpoint&)>, AdvertisedEndpointEquality>(
-            &endpoint_state_, clear_inactive,
+        FetchState<ContainerEndpoint, dont_normalize, std::function<bool(const ContainerEndpoint&)>, AdvertisedEndpointEquality>(
+            &endpoint_state_, &endpoint_index_, clear_inactive,
             dont_normalize(),
-            [this](const ContainerEndpoint& cep) { return this->ShouldFetchContainerEndpoint(cep); });
+            [this](const ContainerEndpoint& cep) { return this->ShouldFetchContainerEndpoint(cep); }, cem);
       }
     } else {
       if (normalize) {
-        cem = FetchState<ContainerEndpoint, std::function<ContainerEndpoint(const ContainerEndpoint&)>, dont_filter, AdvertisedEndpointEquality>(
-            &endpoint_state_, clear_inactive,
+        FetchState<ContainerEndpoint, std::function<ContainerEndpoint(const ContainerEndpoint&)>, dont_filter, AdvertisedEndpointEquality>(
+            &endpoint_state_, &endpoint_index_, clear_inactive,
             [this](const ContainerEndpoint& cep) { return this->NormalizeContainerEndpoint(cep); },
-            dont_filter());
+            dont_filter(), cem);
       } else {
-        cem = FetchState<ContainerEndpoint, dont_normalize, dont_filter, AdvertisedEndpointEquality>(
-            &endpoint_state_, clear_inactive,
+        FetchState<ContainerEndpoint, dont_normalize, dont_filter, AdvertisedEndpointEquality>(
+            &endpoint_state_, &endpoint_index_, clear_inactive,
             dont_normalize(),
-            dont_filter());
+            dont_filter(), cem);
       }
     }
     COUNTER_ADD(CollectorStats::net_cep_inactive, (state_size - endpoint_state_.size()));
   }
-  return cem;
 }
 
 void ConnectionTracker::UpdateKnownPublicIPs(collector::UnorderedSet<collector::Address>&& known_public_ips) {
@@ -330,8 +534,16 @@ void ConnectionTracker::UpdateIgnoredNetworks(const std::vector<IPNet>& network_
   }
 }
 
+namespace {
+
+inline Address RemoteAddress(const Connection& conn) { return conn.remote().address(); }
+inline Address RemoteAddress(const CompactConnection& conn) { return conn.remote_address(); }
+
+}  // namespace
+
 // Increment the stat counter matching the connection's characteristics
-inline void ConnectionTracker::IncrementConnectionStats(Connection conn, ConnectionTracker::Stats& stats) const {
+template <typename Conn>
+inline void ConnectionTracker::IncrementConnectionStats(const Conn& conn, ConnectionTracker::Stats& stats) const {
   auto& direction = conn.is_server() ? stats.inbound : stats.outbound;
 
   if (!ShouldFetchConnection(conn)) {
@@ -339,7 +551,7 @@ inline void ConnectionTracker::IncrementConnectionStats(Connection conn, Connect
     return;
   }
 
-  if (conn.remote().address().IsPublic()) {
+  if (RemoteAddress(conn).IsPublic()) {
     direction.public_++;
   } else {
     direction.private_++;
@@ -368,4 +580,26 @@ ConnectionTracker::Stats ConnectionTracker::GetConnectionStats_NewConnectionCoun
   }
   return stats;
 }
+
+MemoryUsage ConnectionTracker::GetConnectionsMemoryUsage() {
+  MemoryUsage usage;
+
+  WITH_LOCK(mutex_) {
+    usage.entries = conn_state_.size();
+    usage.bytes = ApproxHashContainerBytes(conn_state_) + conn_index_.ApproxBytes() +
+                  ApproxHashContainerBytes(active_flow_members_);
+  }
+  return usage;
+}
+
+MemoryUsage ConnectionTracker::GetEndpointsMemoryUsage() {
+  MemoryUsage usage;
+
+  WITH_LOCK(mutex_) {
+    usage.entries = endpoint_state_.size();
+    usage.bytes = ApproxHashContainerBytes(endpoint_state_) + endpoint_index_.ApproxBytes();
+  }
+  return usage;
+}
+
 }  // namespace collector
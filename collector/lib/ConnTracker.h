@@ -1,13 +1,17 @@
 #ifndef COLLECTOR_CONNTRACKER_H
 #define COLLECTOR_CONNTRACKER_H
 
+#include <algorithm>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "Containers.h"
 #include "Hash.h"
+#include "MemoryAccounting.h"
 #include "NRadix.h"
 #include "NetworkConnection.h"
+#include "ProfiledMutex.h"
 
 namespace collector {
 
@@ -76,6 +80,62 @@ class AdvertisedEndpointEquality {
   bool operator()(const ContainerEndpoint& lhs, const ContainerEndpoint& rhs) const;
 };
 
+// ContainerIndex indexes the entries of a state map by container. Entries are referenced by address, which is stable for
+// as long as they are in the map, as unordered maps never move their elements. The entries of a container are kept in a
+// flat vector, and are only removed in bulk, when the inactive entries are swept from the map.
+template <typename T>
+class ContainerIndex {
+ public:
+  using Entry = std::pair<const T, ConnStatus>;
+
+  // entry must not be in the index already, i.e. it has just been inserted in the map.
+  void Add(Entry* entry) {
+    index_[entry->first.container()].push_back(entry);
+  }
+
+  // Removes all the inactive entries, which must be done right before erasing them from the map.
+  void RemoveInactive() {
+    for (auto it = index_.begin(); it != index_.end();) {
+      auto& entries = it->second;
+      entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry* entry) { return !entry->second.IsActive(); }),
+                    entries.end());
+      if (entries.empty()) {
+        it = index_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  const std::vector<Entry*>* Find(const std::string& container) const { return Lookup(index_, container); }
+
+  size_t Count(const std::string& container) const {
+    const auto* entries = Find(container);
+    return entries ? entries->size() : 0;
+  }
+
+  size_t NumContainers() const { return index_.size(); }
+
+  size_t MaxCount() const {
+    size_t max_count = 0;
+    for (const auto& container_entries : index_) {
+      max_count = std::max(max_count, container_entries.second.size());
+    }
+    return max_count;
+  }
+
+  size_t ApproxBytes() const {
+    size_t bytes = ApproxHashContainerBytes(index_);
+    for (const auto& container_entries : index_) {
+      bytes += container_entries.second.capacity() * sizeof(Entry*);
+    }
+    return bytes;
+  }
+
+ private:
+  UnorderedMap<std::string, std::vector<Entry*>> index_;
+};
+
 using ConnMap = UnorderedMap<Connection, ConnStatus>;
 using ContainerEndpointMap = UnorderedMap<ContainerEndpoint, ConnStatus>;
 using AdvertisedEndpointMap = UnorderedMap<ContainerEndpoint, ConnStatus, AdvertisedEndpointEquality>;
@@ -91,12 +151,37 @@ class ConnectionTracker {
   void RemoveConnection(const Connection& conn, int64_t timestamp) {
     UpdateConnection(conn, timestamp, false);
   }
+  // Apply a batch of connection updates, taking the lock only once.
+  void UpdateConnections(const std::vector<std::pair<Connection, ConnStatus>>& updates);
+
+  // Update the status of a listen endpoint from a kernel event. On removal, the originator process is not taken into
+  // account, as a listening socket can be closed by another process than the one which opened it.
+  void UpdateEndpoint(const ContainerEndpoint& ep, int64_t timestamp, bool added);
 
   void Update(const std::vector<Connection>& all_conns, const std::vector<ContainerEndpoint>& all_listen_endpoints, int64_t timestamp);
+  // Same as above, but leaves the listen endpoints untouched, for when they are maintained from kernel events.
+  void Update(const std::vector<Connection>& all_conns, int64_t timestamp);
+
+  // Mark all the connections and listen endpoints of a container as inactive, e.g. when it is known to have exited.
+  void CloseContainer(const std::string& container, int64_t timestamp);
+  // Limit the number of connections, and of listen endpoints, stored for a single container. New entries beyond this
+  // limit are dropped. 0 means no limit.
+  void SetMaxEntriesPerContainer(size_t max_entries) { max_entries_per_container_ = max_entries; }
+  // Store connections with the parts that normalization drops regardless of the configuration already removed, i.e.,
+  // the client port of server connections and the local endpoint of client connections, so that the connections of
+  // a flow are stored as one entry. Connections are then filtered when added, as the dropped ports can no longer be
+  // filtered when fetched. Changing the mode clears the stored connections.
+  void SetNormalizeOnIngest(bool enable);
+  // Number of connections and listen endpoints currently stored for a container.
+  size_t GetContainerEntryCount(const std::string& container);
 
   // Atomically fetch a snapshot of the current state, removing all inactive connections if requested.
   ConnMap FetchConnState(bool normalize = false, bool clear_inactive = true);
   AdvertisedEndpointMap FetchEndpointState(bool normalize = false, bool clear_inactive = true);
+  // Same as above, replacing the contents of the given container with the snapshot. The entries of the previous
+  // contents are reused for the new ones, so that refilling a container of a previous snapshot does not allocate.
+  void FetchConnState(ConnMap* cm, bool normalize = false, bool clear_inactive = true);
+  void FetchEndpointState(AdvertisedEndpointMap* cem, bool normalize = false, bool clear_inactive = true);
 
   template <typename T>
   static void UpdateOldState(UnorderedMap<T, ConnStatus>* old_state, const UnorderedMap<T, ConnStatus>& new_state, int64_t time_micros, int64_t afterglow_period_micros);
@@ -154,9 +239,27 @@ class ConnectionTracker {
   // Those counters are updated as new connections are reported by the system.
   Stats GetConnectionStats_NewConnectionCounters();
 
+  // Approximate memory used by the stored connections and listen endpoints, along with their container index.
+  MemoryUsage GetConnectionsMemoryUsage();
+  MemoryUsage GetEndpointsMemoryUsage();
+
  private:
-  // NormalizeConnection transforms a connection into a normalized form.
-  Connection NormalizeConnectionNoLock(const Connection& conn) const;
+  // NormalizeConnection transforms a stored connection into a normalized form.
+  Connection NormalizeConnectionNoLock(const CompactConnection& conn) const;
+
+  // IsServerConnection returns whether the connection is on the server side. This is inferred from the ports for UDP.
+  static bool IsServerConnection(L4Proto l4proto, bool is_server, uint16_t local_port, uint16_t remote_port);
+  static bool IsServerConnection(const Connection& conn) {
+    return IsServerConnection(conn.l4proto(), conn.is_server(), conn.local().port(), conn.remote().port());
+  }
+
+  // Returns the status to store for a flow when one of its connections has the given status, when normalizing on
+  // ingest: a flow stays active until all of its connections are closed.
+  ConnStatus FlowStatusNoLock(const CompactConnection& flow, ConnStatus status);
+
+  // PreNormalizeConnection applies the part of the normalization which does not depend on the configuration, and
+  // leaves the addresses as is.
+  static Connection PreNormalizeConnection(const Connection& conn);
 
   IPNet NormalizeAddressNoLock(const Address& address) const;
 
@@ -177,10 +280,16 @@ class ConnectionTracker {
   }
 
   // Determine if a connection should be ignored
+  inline bool ShouldFetchConnection(L4Proto l4proto, uint16_t local_port, uint16_t remote_port, const Address& remote) const {
+    return !IsIgnoredL4ProtoPortPair(L4ProtoPortPair(l4proto, local_port)) &&
+           !IsIgnoredL4ProtoPortPair(L4ProtoPortPair(l4proto, remote_port)) &&
+           ignored_networks_.Find(remote).IsNull();
+  }
   inline bool ShouldFetchConnection(const Connection& conn) const {
-    return !IsIgnoredL4ProtoPortPair(L4ProtoPortPair(conn.l4proto(), conn.local().port())) &&
-           !IsIgnoredL4ProtoPortPair(L4ProtoPortPair(conn.l4proto(), conn.remote().port())) &&
-           ignored_networks_.Find(conn.remote().address()).IsNull();
+    return ShouldFetchConnection(conn.l4proto(), conn.local().port(), conn.remote().port(), conn.remote().address());
+  }
+  inline bool ShouldFetchConnection(const CompactConnection& conn) const {
+    return ShouldFetchConnection(conn.l4proto(), conn.local_port(), conn.remote_port(), conn.remote_address());
   }
 
   // Determine if a container endpoint should be ignored
@@ -188,11 +297,27 @@ class ConnectionTracker {
     return !IsIgnoredL4ProtoPortPair(L4ProtoPortPair(cep.l4proto(), cep.endpoint().port()));
   }
 
-  inline void IncrementConnectionStats(Connection conn, ConnectionTracker::Stats& stats) const;
+  // Conn is either a Connection or a CompactConnection.
+  template <typename Conn>
+  inline void IncrementConnectionStats(const Conn& conn, ConnectionTracker::Stats& stats) const;
 
-  std::mutex mutex_;
-  ConnMap conn_state_;
+  // Returns true if a new entry for this container must be dropped, because of the per-container limit.
+  template <typename T>
+  bool ExceedsContainerLimitNoLock(const UnorderedMap<T, ConnStatus>& state, const ContainerIndex<T>& index, const T& key) const {
+    return max_entries_per_container_ > 0 && index.Count(key.container()) >= max_entries_per_container_ && !Contains(state, key);
+  }
+
+  ProfiledMutex mutex_{CollectorStats::lock_conn_tracker};
+  // Connections are stored in their compact form, and converted back when fetched.
+  UnorderedMap<CompactConnection, ConnStatus> conn_state_;
   ContainerEndpointMap endpoint_state_;
+  ContainerIndex<CompactConnection> conn_index_;
+  ContainerIndex<ContainerEndpoint> endpoint_index_;
+  size_t max_entries_per_container_ = 0;
+  bool normalize_on_ingest_ = false;
+  // Number of open connections of the active flows, when normalizing on ingest. It is reset by scrapes, which report
+  // all the open connections.
+  UnorderedMap<CompactConnection, uint32_t> active_flow_members_;
 
   UnorderedSet<Address> known_public_ips_;
   NRadixTree known_ip_networks_;
@@ -202,6 +327,12 @@ class ConnectionTracker {
   NRadixTree ignored_networks_;
 
   Stats inserted_connections_counters_ = {};
+
+  // Last, to be unregistered before the state is destroyed.
+  MemoryAccounting::Registration connections_memory_ = MemoryAccounting::GetOrCreate().Register(
+      "conn_tracker_connections", [this] { return GetConnectionsMemoryUsage(); });
+  MemoryAccounting::Registration endpoints_memory_ = MemoryAccounting::GetOrCreate().Register(
+      "conn_tracker_endpoints", [this] { return GetEndpointsMemoryUsage(); });
 };
 
 /* static */
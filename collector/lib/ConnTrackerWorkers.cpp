@@ -0,0 +1,93 @@
+#include "ConnTrackerWorkers.h"
+
+#include "CollectorStats.h"
+#include "Hash.h"
+#include "Profiler.h"
+#include "ThreadPlacement.h"
+
+namespace collector {
+
+ConnectionTrackerWorkers::ConnectionTrackerWorkers(std::shared_ptr<ConnectionTracker> conn_tracker, size_t num_workers,
+                                                   size_t queue_capacity)
+    : conn_tracker_(std::move(conn_tracker)) {
+  for (size_t i = 0; i < num_workers; i++) {
+    workers_.push_back(std::make_unique<Worker>(queue_capacity));
+  }
+}
+
+void ConnectionTrackerWorkers::Start() {
+  for (auto& worker : workers_) {
+    Worker* w = worker.get();
+    {
+      std::lock_guard<std::mutex> lock(w->mutex);
+      w->stopping = false;
+    }
+    w->thread.Start([this, w] { Run(w); });
+  }
+}
+
+void ConnectionTrackerWorkers::Stop() {
+  for (auto& worker : workers_) {
+    if (worker->thread.running()) {
+      {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->stopping = true;
+      }
+      worker->cond.notify_one();
+      worker->thread.Stop();
+    }
+  }
+}
+
+void ConnectionTrackerWorkers::UpdateConnection(const Connection& conn, int64_t timestamp, bool added) {
+  Worker& worker = *workers_[Hash(conn) % workers_.size()];
+
+  if (!worker.queue.Push(conn, ConnStatus(timestamp, added))) {
+    // Updates are never dropped, a close would otherwise leave the connection
+    // active. Overtaking the queued updates of the connection is fine, as the
+    // tracker keeps the most recent status of a connection.
+    COUNTER_INC(CollectorStats::net_conn_worker_inline);
+    conn_tracker_->UpdateConnection(conn, timestamp, added);
+    return;
+  }
+
+  // Pairs with the fence of the worker, so that either it sees the update, or
+  // the update sees it waiting.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (worker.waiting.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.cond.notify_one();
+  }
+}
+
+void ConnectionTrackerWorkers::Run(Worker* worker) {
+  Profiler::RegisterCPUThread();
+  ThreadPlacement::Apply("conn-worker", ThreadRole::NETWORK);
+
+  std::vector<Update> batch;
+  for (;;) {
+    if (worker->queue.Empty()) {
+      std::unique_lock<std::mutex> lock(worker->mutex);
+      worker->waiting.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      worker->cond.wait(lock, [worker] { return worker->stopping.load() || !worker->queue.Empty(); });
+      worker->waiting.store(false, std::memory_order_relaxed);
+    }
+    // Read before draining, the updates pushed before the stop request are
+    // then all drained.
+    bool stopping = worker->stopping.load();
+    worker->queue.Drain(&batch);
+
+    if (batch.empty()) {
+      if (stopping) {
+        break;
+      }
+      continue;
+    }
+
+    conn_tracker_->UpdateConnections(batch);
+    batch.clear();
+  }
+}
+
+}  // namespace collector
@@ -0,0 +1,107 @@
+#ifndef COLLECTOR_CONNTRACKERWORKERS_H
+#define COLLECTOR_CONNTRACKERWORKERS_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "ConnTracker.h"
+#include "StoppableThread.h"
+
+namespace collector {
+
+// ConnectionTrackerWorkers applies connection updates to a ConnectionTracker
+// from a pool of worker threads, so that the event loop does not have to wait
+// on the tracker lock (e.g., while the network status notifier fetches the
+// state).
+//
+// Updates are dispatched to a worker based on the hash of the connection,
+// which guarantees updates of a given connection are applied in order. Each
+// worker has a bounded queue, updates dispatched to a full queue are applied
+// directly to the tracker instead, and counted in net_conn_worker_inline.
+//
+// UpdateConnection must always be called from the same thread.
+class ConnectionTrackerWorkers {
+ public:
+  static constexpr size_t kDefaultQueueCapacity = 8192;
+
+  ConnectionTrackerWorkers(std::shared_ptr<ConnectionTracker> conn_tracker, size_t num_workers,
+                           size_t queue_capacity = kDefaultQueueCapacity);
+  ~ConnectionTrackerWorkers() { Stop(); }
+
+  void Start();
+  // Stops the workers, after all the pending updates have been applied.
+  void Stop();
+
+  void UpdateConnection(const Connection& conn, int64_t timestamp, bool added);
+
+  size_t NumWorkers() const { return workers_.size(); }
+
+ private:
+  using Update = std::pair<Connection, ConnStatus>;
+
+  // Bounded single producer, single consumer queue of updates. The producer
+  // is the thread calling UpdateConnection, the consumer is the worker.
+  class UpdateQueue {
+   public:
+    explicit UpdateQueue(size_t capacity) : updates_(std::max<size_t>(capacity, 1)) {}
+
+    bool Push(const Connection& conn, ConnStatus status) {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail - head_.load(std::memory_order_acquire) == updates_.size()) {
+        return false;
+      }
+      Update& update = updates_[tail % updates_.size()];
+      update.first = conn;
+      update.second = status;
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Appends all queued updates to out.
+    void Drain(std::vector<Update>* out) {
+      size_t head = head_.load(std::memory_order_relaxed);
+      size_t tail = tail_.load(std::memory_order_acquire);
+      for (size_t i = head; i != tail; ++i) {
+        out->push_back(std::move(updates_[i % updates_.size()]));
+      }
+      head_.store(tail, std::memory_order_release);
+    }
+
+    bool Empty() const {
+      return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+   private:
+    std::vector<Update> updates_;
+    std::atomic<size_t> head_{0};
+    std::atomic<size_t> tail_{0};
+  };
+
+  struct Worker {
+    explicit Worker(size_t queue_capacity) : queue(queue_capacity) {}
+
+    StoppableThread thread;
+    UpdateQueue queue;
+    // Only used to wake up the worker when it waits for updates, or when it
+    // is stopped.
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::atomic<bool> waiting{false};
+    // Set under the mutex, so that the worker cannot miss it while waiting.
+    std::atomic<bool> stopping{false};
+  };
+
+  void Run(Worker* worker);
+
+  std::shared_ptr<ConnectionTracker> conn_tracker_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_CONNTRACKERWORKERS_H
@@ -3,6 +3,7 @@
 
 #include "container_engine/container_cache_interface.h"
 #include "container_engine/container_engine_base.h"
+#include "container_info.h"
 #include "threadinfo.h"
 
 namespace collector {
@@ -16,6 +17,15 @@ class ContainerEngine : public libsinsp::container_engine::container_engine_base
 
       if (container_id) {
         tinfo->m_container_id = *container_id;
+        // Registering the container is what makes the container manager
+        // report its removal, once none of its threads is left. This is only
+        // done the first time the container is seen, and collector does not
+        // subscribe to new containers.
+        if (!container_cache().get_container(tinfo->m_container_id)) {
+          auto container = std::make_shared<sinsp_container_info>();
+          container->m_id = tinfo->m_container_id;
+          container_cache().add_container(container, tinfo);
+        }
         return true;
       }
     }
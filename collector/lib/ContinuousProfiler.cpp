@@ -0,0 +1,130 @@
+#include "ContinuousProfiler.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "Logging.h"
+#include "Profiler.h"
+#include "Utility.h"
+
+namespace collector {
+
+const std::string ContinuousProfiler::kProfileFilename = "/module/cpu_profile_window";
+
+ContinuousProfiler::ContinuousProfiler(const ContinuousProfilerConfig& config, std::string profile_path)
+    : ContinuousProfiler(config, std::move(profile_path), Profiler::StartCPUProfiler, Profiler::StopCPUProfiler) {}
+
+ContinuousProfiler::ContinuousProfiler(const ContinuousProfilerConfig& config, std::string profile_path, StartFn start, StopFn stop)
+    : config_(config), profile_path_(std::move(profile_path)), start_(std::move(start)), stop_(std::move(stop)) {}
+
+ContinuousProfiler::~ContinuousProfiler() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (running_) {
+    stop_();
+    running_ = false;
+    std::remove(profile_path_.c_str());
+  }
+}
+
+bool ContinuousProfiler::Schedule(Scheduler* scheduler) {
+  if (!IsEnabled()) {
+    return false;
+  }
+
+  CLOG(INFO) << "Continuous CPU profiling: " << config_.window.count() << "ms every " << config_.interval.count()
+             << "s, keeping " << config_.max_windows << " windows";
+
+  // Not deferrable, profiles taken while collector is throttled are the
+  // interesting ones.
+  scheduler->SchedulePeriodic("cpu_profile_window", config_.interval, [this, scheduler] {
+    if (StartWindow()) {
+      scheduler->ScheduleOnce("cpu_profile_window_end", config_.window, [this] { EndWindow(); });
+    }
+  });
+  return true;
+}
+
+bool ContinuousProfiler::StartWindow() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (suspended_ || running_) {
+    return false;
+  }
+  if (!start_(profile_path_)) {
+    CLOG_THROTTLED(WARNING, std::chrono::minutes(10)) << "Failed to start a CPU profile window";
+    return false;
+  }
+  running_ = true;
+  window_start_ = std::chrono::system_clock::now();
+  window_start_steady_ = Clock::now();
+  return true;
+}
+
+void ContinuousProfiler::EndWindow() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  EndWindowLocked();
+}
+
+void ContinuousProfiler::EndWindowLocked() {
+  if (!running_) {
+    return;
+  }
+  stop_();
+  running_ = false;
+
+  Window window;
+  window.info.start = window_start_;
+  window.info.duration = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - window_start_steady_);
+
+  std::ifstream file(profile_path_, std::ios::binary);
+  if (!file) {
+    CLOG(WARNING) << "Unable to read CPU profile window " << profile_path_ << ": " << StrError();
+    return;
+  }
+  std::ostringstream profile;
+  profile << file.rdbuf();
+  window.profile = profile.str();
+  file.close();
+  std::remove(profile_path_.c_str());
+
+  window.info.id = next_id_++;
+  window.info.size = window.profile.size();
+  windows_.push_back(std::move(window));
+  while (windows_.size() > config_.max_windows) {
+    windows_.pop_front();
+  }
+}
+
+void ContinuousProfiler::Suspend() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  suspended_ = true;
+  EndWindowLocked();
+}
+
+void ContinuousProfiler::Resume() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  suspended_ = false;
+}
+
+std::vector<ContinuousProfiler::WindowInfo> ContinuousProfiler::ListWindows() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<WindowInfo> infos;
+  infos.reserve(windows_.size());
+  for (const auto& window : windows_) {
+    infos.push_back(window.info);
+  }
+  return infos;
+}
+
+bool ContinuousProfiler::GetWindow(uint64_t id, std::string* profile) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& window : windows_) {
+    if (window.info.id == id) {
+      *profile = window.profile;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace collector
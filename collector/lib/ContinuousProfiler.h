@@ -0,0 +1,99 @@
+#ifndef COLLECTOR_CONTINUOUSPROFILER_H
+#define COLLECTOR_CONTINUOUSPROFILER_H
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Scheduler.h"
+
+namespace collector {
+
+struct ContinuousProfilerConfig {
+  // Time between the starts of two profile windows, zero disables continuous
+  // profiling.
+  std::chrono::seconds interval{0};
+  // Length of each profile window.
+  std::chrono::milliseconds window{1000};
+  // Number of windows kept, the oldest ones are dropped first.
+  size_t max_windows = 12;
+};
+
+// ContinuousProfiler periodically runs the CPU profiler for a short window,
+// and keeps the resulting profiles in a bounded ring, so that CPU spikes can
+// be investigated after the fact.
+//
+// Windows are skipped while the profiler is suspended, e.g., while it is
+// started manually through the ProfilerHandler, since only one CPU profile
+// can be recorded at a time.
+class ContinuousProfiler {
+ public:
+  static const std::string kProfileFilename;
+
+  using Clock = std::chrono::steady_clock;
+  // Start the CPU profiler writing to the given file, and stop it, flushing
+  // the profile.
+  using StartFn = std::function<bool(const std::string&)>;
+  using StopFn = std::function<void()>;
+
+  struct WindowInfo {
+    uint64_t id;
+    std::chrono::system_clock::time_point start;
+    std::chrono::milliseconds duration;
+    size_t size;
+  };
+
+  explicit ContinuousProfiler(const ContinuousProfilerConfig& config, std::string profile_path = kProfileFilename);
+  ContinuousProfiler(const ContinuousProfilerConfig& config, std::string profile_path, StartFn start, StopFn stop);
+  ~ContinuousProfiler();
+
+  // Schedules the profile windows, returns false if continuous profiling is
+  // disabled.
+  bool Schedule(Scheduler* scheduler);
+
+  // Starts a profile window, returns false if the profiler is suspended or
+  // already running.
+  bool StartWindow();
+  // Ends the current profile window, and adds its profile to the ring.
+  void EndWindow();
+
+  // Suspends profiling, ending the current window, until Resume is called.
+  void Suspend();
+  void Resume();
+
+  bool IsEnabled() const { return config_.interval.count() > 0; }
+
+  // Lists the windows in the ring, oldest first.
+  std::vector<WindowInfo> ListWindows() const;
+  // Gets the profile of the window with the given id, returns false if it is
+  // not in the ring.
+  bool GetWindow(uint64_t id, std::string* profile) const;
+
+ private:
+  struct Window {
+    WindowInfo info;
+    std::string profile;
+  };
+
+  void EndWindowLocked();
+
+  ContinuousProfilerConfig config_;
+  std::string profile_path_;
+  StartFn start_;
+  StopFn stop_;
+
+  mutable std::mutex mutex_;
+  bool suspended_ = false;
+  bool running_ = false;
+  std::chrono::system_clock::time_point window_start_;
+  Clock::time_point window_start_steady_;
+  std::deque<Window> windows_;
+  uint64_t next_id_ = 1;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_CONTINUOUSPROFILER_H
@@ -0,0 +1,159 @@
+#include "DDSketch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace collector {
+
+constexpr size_t DDSketch::kDefaultMaxBins;
+constexpr double DDSketch::kMinValue;
+
+DDSketch::DDSketch(double relative_accuracy, size_t max_bins)
+    : relative_accuracy_(relative_accuracy),
+      gamma_((1 + relative_accuracy) / (1 - relative_accuracy)),
+      log_gamma_(std::log(gamma_)),
+      max_bins_(std::max<size_t>(max_bins, 1)) {
+  assert(relative_accuracy > 0 && relative_accuracy < 1);
+}
+
+DDSketch::DDSketch(double relative_accuracy, double min_value, double max_value)
+    : DDSketch(relative_accuracy) {
+  assert(min_value >= kMinValue && min_value < max_value);
+  min_index_ = Index(min_value);
+  max_index_ = Index(max_value);
+  // All the bins of the range fit, nothing is ever collapsed.
+  max_bins_ = max_index_ - min_index_ + 1;
+}
+
+int DDSketch::Index(double value) const {
+  return static_cast<int>(std::ceil(std::log(value) / log_gamma_));
+}
+
+double DDSketch::Value(int index) const {
+  // The midpoint of (gamma^(i-1), gamma^i] in relative terms.
+  return 2 * std::pow(gamma_, index) / (gamma_ + 1);
+}
+
+int DDSketch::Reserve(int index) {
+  if (bins_.empty()) {
+    offset_ = index;
+    bins_.push_back(0);
+    return index;
+  }
+
+  int first = offset_;
+  int last = offset_ + static_cast<int>(bins_.size()) - 1;
+  if (index >= first && index <= last) {
+    return index;
+  }
+
+  int new_first = std::min(first, index);
+  int new_last = std::max(last, index);
+  if (new_last - new_first + 1 > static_cast<int>(max_bins_)) {
+    new_first = new_last - static_cast<int>(max_bins_) + 1;
+  }
+
+  std::vector<uint64_t> bins(new_last - new_first + 1, 0);
+  for (size_t i = 0; i < bins_.size(); i++) {
+    int bin_index = std::max(offset_ + static_cast<int>(i), new_first);
+    bins[bin_index - new_first] += bins_[i];
+  }
+  bins_.swap(bins);
+  offset_ = new_first;
+
+  return std::max(index, new_first);
+}
+
+void DDSketch::Add(double value) {
+  count_++;
+  if (value < kMinValue) {
+    zero_count_++;
+    return;
+  }
+  sum_ += value;
+  bins_[Reserve(std::clamp(Index(value), min_index_, max_index_)) - offset_]++;
+}
+
+void DDSketch::Merge(const DDSketch& other) {
+  assert(other.min_index_ == min_index_ && other.max_index_ == max_index_);
+  if (other.bins_.empty()) {
+    zero_count_ += other.zero_count_;
+    count_ += other.count_;
+    sum_ += other.sum_;
+    return;
+  }
+
+  // Reserving both ends first avoids reallocating for every bin.
+  Reserve(other.offset_ + static_cast<int>(other.bins_.size()) - 1);
+  Reserve(other.offset_);
+  other.ForEachBin([this](int index, uint64_t count) { bins_[Reserve(index) - offset_] += count; });
+
+  zero_count_ += other.zero_count_;
+  count_ += other.count_;
+  sum_ += other.sum_;
+}
+
+void DDSketch::Clear() {
+  bins_.clear();
+  offset_ = 0;
+  zero_count_ = 0;
+  count_ = 0;
+  sum_ = 0;
+}
+
+double DDSketch::Quantile(double q) const {
+  if (count_ == 0) {
+    return 0;
+  }
+
+  double rank = std::clamp(q, 0.0, 1.0) * (count_ - 1);
+  uint64_t seen = zero_count_;
+  if (rank < seen) {
+    return 0;
+  }
+  for (size_t i = 0; i < bins_.size(); i++) {
+    seen += bins_[i];
+    if (rank < seen) {
+      return Value(offset_ + static_cast<int>(i));
+    }
+  }
+  return Value(offset_ + static_cast<int>(bins_.size()) - 1);
+}
+
+constexpr size_t SlidingDDSketch::kDefaultSlices;
+
+SlidingDDSketch::SlidingDDSketch(double relative_accuracy, std::chrono::milliseconds window, size_t num_slices, size_t max_bins)
+    : slice_duration_(std::max<Clock::duration>(window / std::max<size_t>(num_slices, 1), std::chrono::milliseconds(1))),
+      start_(Clock::now()),
+      slices_(std::max<size_t>(num_slices, 1), DDSketch(relative_accuracy, max_bins)) {}
+
+void SlidingDDSketch::Rotate(Clock::time_point now) {
+  int64_t slice = (now - start_) / slice_duration_;
+  if (slice <= current_slice_) {
+    return;
+  }
+
+  // Clears the slices which were not written since they were last used.
+  int64_t num_slices = slices_.size();
+  for (int64_t i = std::max(current_slice_ + 1, slice - num_slices + 1); i <= slice; i++) {
+    slices_[i % num_slices].Clear();
+  }
+  current_slice_ = slice;
+}
+
+void SlidingDDSketch::Add(double value, Clock::time_point now) {
+  Rotate(now);
+  slices_[current_slice_ % slices_.size()].Add(value);
+}
+
+DDSketch SlidingDDSketch::Snapshot(Clock::time_point now) {
+  Rotate(now);
+  DDSketch merged = slices_.front();
+  for (size_t i = 1; i < slices_.size(); i++) {
+    merged.Merge(slices_[i]);
+  }
+  return merged;
+}
+
+}  // namespace collector
@@ -0,0 +1,118 @@
+#ifndef COLLECTOR_DDSKETCH_H
+#define COLLECTOR_DDSKETCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace collector {
+
+// DDSketch is a quantile sketch with a relative accuracy guarantee: quantiles
+// are estimated within relative_accuracy of the actual value. Values are
+// counted in bins of exponentially increasing size, the bin of index i
+// holding the values in (gamma^(i-1), gamma^i], with
+// gamma = (1 + relative_accuracy) / (1 - relative_accuracy).
+//
+// The bins only depend on the relative accuracy, hence sketches with the same
+// accuracy can be merged. Memory is bounded by max_bins: once reached, the
+// lowest bins are collapsed, which only affects the accuracy of the lowest
+// quantiles, but makes the lowest bin depend on the values observed so far.
+//
+// Sketches with a fixed range instead count values below min_value in the bin
+// of min_value, and values above max_value in the bin of max_value. Their bins
+// never move, so that sketches with the same accuracy and range have the same
+// bins, including across collectors.
+//
+// Values lower than kMinValue, including negative ones, are counted as zero.
+class DDSketch {
+ public:
+  static constexpr size_t kDefaultMaxBins = 2048;
+  static constexpr double kMinValue = 1e-9;
+
+  // relative_accuracy must be in (0, 1).
+  explicit DDSketch(double relative_accuracy, size_t max_bins = kDefaultMaxBins);
+  // Sketch with a fixed range, min_value must be at least kMinValue, and lower
+  // than max_value.
+  DDSketch(double relative_accuracy, double min_value, double max_value);
+
+  void Add(double value);
+  // Adds the values of other, which must have the same relative accuracy and
+  // range.
+  void Merge(const DDSketch& other);
+  void Clear();
+
+  // Returns the estimated q-quantile, 0 if the sketch is empty.
+  double Quantile(double q) const;
+
+  uint64_t count() const { return count_; }
+  double sum() const { return sum_; }
+  uint64_t zero_count() const { return zero_count_; }
+  double relative_accuracy() const { return relative_accuracy_; }
+
+  // Calls fn(index, count) for each non-empty bin, by increasing index.
+  template <typename Fn>
+  void ForEachBin(Fn fn) const {
+    for (size_t i = 0; i < bins_.size(); i++) {
+      if (bins_[i]) fn(offset_ + static_cast<int>(i), bins_[i]);
+    }
+  }
+
+  int Index(double value) const;
+  // Value representing the bin of the given index, within the relative
+  // accuracy of all the values it holds.
+  double Value(int index) const;
+
+ private:
+  // Makes room for the bin of the given index, and returns the index of the
+  // bin to use for it, lower bins having possibly been collapsed.
+  int Reserve(int index);
+
+  double relative_accuracy_;
+  double gamma_;
+  double log_gamma_;
+  size_t max_bins_;
+  // Range of the bin indexes, unbounded unless the sketch has a fixed range.
+  int min_index_ = std::numeric_limits<int>::min();
+  int max_index_ = std::numeric_limits<int>::max();
+
+  // Contiguous bins, the first one having index offset_.
+  std::vector<uint64_t> bins_;
+  int offset_ = 0;
+
+  uint64_t zero_count_ = 0;
+  uint64_t count_ = 0;
+  double sum_ = 0;
+};
+
+// SlidingDDSketch summarizes the values observed over a sliding window. The
+// window is divided in a fixed number of slices, each with its own sketch,
+// the oldest of which is cleared as the window moves. Memory is then bounded
+// regardless of the length of the window.
+class SlidingDDSketch {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t kDefaultSlices = 6;
+
+  SlidingDDSketch(double relative_accuracy, std::chrono::milliseconds window, size_t num_slices = kDefaultSlices,
+                  size_t max_bins = DDSketch::kDefaultMaxBins);
+
+  void Add(double value, Clock::time_point now = Clock::now());
+
+  // Returns the sketch of the values observed within the window.
+  DDSketch Snapshot(Clock::time_point now = Clock::now());
+
+ private:
+  void Rotate(Clock::time_point now);
+
+  Clock::duration slice_duration_;
+  Clock::time_point start_;
+  std::vector<DDSketch> slices_;
+  // Number of slice durations elapsed since start_ at the last rotation.
+  int64_t current_slice_ = 0;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_DDSKETCH_H
@@ -0,0 +1,61 @@
+#ifndef COLLECTOR_DOUBLEBUFFER_H
+#define COLLECTOR_DOUBLEBUFFER_H
+
+#include <atomic>
+
+namespace collector {
+
+// DoubleBuffer publishes snapshots of a value from a single writer thread to
+// any number of reader threads, without either side ever waiting for the
+// other.
+//
+// The writer fills the buffer readers are not directed to, then switches
+// them over. Readers register on the buffer they copy from, and if the writer
+// wants to overwrite a buffer still being read, the publication is skipped,
+// to be retried later.
+template <typename T>
+class DoubleBuffer {
+ public:
+  // Publishes value, returns false if readers were still copying the previous
+  // snapshot, in which case nothing is published. Must only be called from a
+  // single thread.
+  bool Publish(const T& value) {
+    int current = current_.load();
+    int next = current == 0 ? 1 : 0;
+    if (readers_[next].load() != 0) {
+      return false;
+    }
+    buffers_[next] = value;
+    current_.store(next);
+    return true;
+  }
+
+  // Copies the last published snapshot into value, returns false if nothing
+  // was published yet.
+  bool Read(T* value) const {
+    while (true) {
+      int current = current_.load();
+      if (current < 0) {
+        return false;
+      }
+      readers_[current].fetch_add(1);
+      // The writer may have switched buffers, and started overwriting this
+      // one, before we registered on it.
+      if (current_.load() == current) {
+        *value = buffers_[current];
+        readers_[current].fetch_sub(1);
+        return true;
+      }
+      readers_[current].fetch_sub(1);
+    }
+  }
+
+ private:
+  T buffers_[2];
+  std::atomic<int> current_{-1};
+  mutable std::atomic<int> readers_[2] = {0, 0};
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_DOUBLEBUFFER_H
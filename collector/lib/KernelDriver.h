@@ -51,9 +51,24 @@ class IKernelDriver {
      * syscalls. procexit is essential for keeping threadinfo cache under
      * control, and sched_switch makes conveying process information more
      * reliable.
+     *
+     * sched_switch is by far the most frequent tracepoint on busy nodes, and
+     * can be left out: the thread table is then only maintained through the
+     * clone/fork, execve and procexit events, and threads not seen through
+     * them are read from /proc on their first captured event.
      */
     ppm_sc.insert((ppm_sc_code)PPM_SC_SCHED_PROCESS_EXIT);
-    ppm_sc.insert((ppm_sc_code)PPM_SC_SCHED_SWITCH);
+    if (config.CaptureSchedSwitch()) {
+      ppm_sc.insert((ppm_sc_code)PPM_SC_SCHED_SWITCH);
+    }
+
+    // listen and bind are only needed to maintain the listen endpoints from
+    // events. The local address of a socket is only known to sinsp from the
+    // bind event, without it the socket is not a server socket at listen.
+    if (config.TrackListenEndpoints()) {
+      ppm_sc.insert((ppm_sc_code)PPM_SC_BIND);
+      ppm_sc.insert((ppm_sc_code)PPM_SC_LISTEN);
+    }
     return ppm_sc;
   }
 };
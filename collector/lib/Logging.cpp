@@ -3,9 +3,18 @@
 #include <algorithm>
 #include <atomic>
 #include <cctype>
+#include <condition_variable>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+
+#include <time.h>
+
+#include "ThreadPlacement.h"
 
 namespace collector {
 
@@ -37,6 +46,250 @@ std::unordered_map<std::string, LogLevel>& GetNameToLevelMap() {
   return *name_to_level_map;
 }
 
+std::string FormatLogRecord(LogLevel level, bool throttled, const char* file, int line, const std::string& msg) {
+  auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  struct tm now_tm;
+  gmtime_r(&now, &now_tm);
+  char time_buf[32];
+  strftime(time_buf, sizeof(time_buf), "%Y/%m/%d %H:%M:%S", &now_tm);
+
+  const char* level_name = GetLogLevelName(level);
+  std::string record;
+  record.reserve(64 + msg.size());
+  record += GetGlobalLogPrefix();
+  record += "[";
+  record += level_name;
+  record.append(LevelPaddingWidth - std::min(LevelPaddingWidth, strlen(level_name)), ' ');
+  record += " ";
+  record += time_buf;
+  record += "] ";
+
+  if (throttled) {
+    record += "[Throttled] ";
+  }
+
+  if (file) {
+    const char* basename = strrchr(file, '/');
+    if (!basename) {
+      basename = file;
+    } else {
+      ++basename;
+    }
+    record += "(";
+    record += basename;
+    record += ":";
+    record += std::to_string(line);
+    record += ") ";
+  }
+
+  record += msg;
+  record += "\n";
+  return record;
+}
+
+void WriteToStderr(const std::string& data) {
+  std::cerr.write(data.data(), data.size());
+  std::cerr.flush();
+}
+
+// Bounded single producer, single consumer queue of formatted records. The
+// producer is the thread owning the ring, the consumer is whoever holds the
+// AsyncLogger mutex.
+class LogRing {
+ public:
+  explicit LogRing(size_t capacity) : records_(std::max<size_t>(capacity, 1)) {}
+
+  bool Push(std::string&& record) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == records_.size()) {
+      return false;
+    }
+    records_[tail % records_.size()] = std::move(record);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Appends all queued records to out, and returns their number.
+  size_t Drain(std::string* out) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    for (size_t i = head; i != tail; ++i) {
+      std::string& record = records_[i % records_.size()];
+      out->append(record);
+      record.clear();
+    }
+    head_.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+  void Close() { closed_.store(true, std::memory_order_release); }
+  bool IsClosed() const { return closed_.load(std::memory_order_acquire); }
+
+ private:
+  std::vector<std::string> records_;
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<bool> closed_{false};
+};
+
+// Rings of exited threads are closed, and released once drained.
+struct ThreadLogRing {
+  ~ThreadLogRing() {
+    if (ring) {
+      ring->Close();
+    }
+  }
+
+  std::shared_ptr<LogRing> ring;
+};
+
+thread_local ThreadLogRing t_log_ring;
+
+class AsyncLogger {
+ public:
+  // Never destroyed, as records may be logged during static destruction, and
+  // exit() may be called with the writer thread still running.
+  static AsyncLogger& GetInstance() {
+    static AsyncLogger* instance = new AsyncLogger();
+    return *instance;
+  }
+
+  bool Start(size_t ring_capacity, std::chrono::milliseconds flush_interval) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (thread_.joinable()) {
+      return false;
+    }
+    ring_capacity_ = ring_capacity;
+    flush_interval_ = flush_interval;
+    stop_ = false;
+    thread_ = std::thread(&AsyncLogger::Run, this);
+    running_.store(true, std::memory_order_release);
+    return true;
+  }
+
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!thread_.joinable()) {
+        return;
+      }
+      running_.store(false);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    // Threads which were in the middle of logging when the logger was stopped
+    // may still queue their record, wait for them before the final flush.
+    while (pushing_.load() != 0) {
+      std::this_thread::yield();
+    }
+    Flush();
+  }
+
+  bool Push(std::string&& record) {
+    // Announced before checking whether the logger runs, so that either the
+    // record is written synchronously, or Stop waits for it to be queued.
+    pushing_.fetch_add(1);
+    if (!running_.load()) {
+      pushing_.fetch_sub(1);
+      return false;
+    }
+
+    if (!t_log_ring.ring) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      t_log_ring.ring = std::make_shared<LogRing>(ring_capacity_);
+      rings_.push_back(t_log_ring.ring);
+    }
+
+    if (!t_log_ring.ring->Push(std::move(record))) {
+      drops_.fetch_add(1, std::memory_order_relaxed);
+    }
+    pushing_.fetch_sub(1, std::memory_order_release);
+    return true;
+  }
+
+  void Flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    FlushLocked(lock);
+  }
+
+  AsyncLogStats GetStats() const {
+    return {records_.load(std::memory_order_relaxed), drops_.load(std::memory_order_relaxed)};
+  }
+
+ private:
+  void Run() {
+    ThreadPlacement::Apply("log-writer", ThreadRole::BACKGROUND);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lock, flush_interval_);
+      FlushLocked(lock);
+    }
+  }
+
+  // Drains the rings with the lock held. The lock is released while writing
+  // the records, so that threads registering their ring do not wait on
+  // stderr; the write mutex, taken before, keeps the batches in order.
+  void FlushLocked(std::unique_lock<std::mutex>& lock) {
+    size_t records = 0;
+    for (auto it = rings_.begin(); it != rings_.end();) {
+      // Checking for closing before draining ensures no record is lost.
+      bool closed = (*it)->IsClosed();
+      records += (*it)->Drain(&batch_);
+      if (closed) {
+        it = rings_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    uint64_t drops = drops_.load(std::memory_order_relaxed);
+    if (drops != reported_drops_) {
+      batch_ += FormatLogRecord(LogLevel::WARNING, false, nullptr, 0,
+                                "Dropped " + std::to_string(drops - reported_drops_) + " log messages");
+      reported_drops_ = drops;
+    }
+
+    records_.fetch_add(records, std::memory_order_relaxed);
+    if (batch_.empty()) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> write_lock(write_mutex_);
+    // Swapped rather than moved, so that both buffers keep their capacity.
+    write_batch_.swap(batch_);
+    lock.unlock();
+    WriteToStderr(write_batch_);
+    write_batch_.clear();
+    write_lock.unlock();
+    lock.lock();
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+  bool stop_ = false;
+  std::atomic<bool> running_{false};
+  std::atomic<int> pushing_{0};
+
+  size_t ring_capacity_ = kAsyncLogRingCapacity;
+  std::chrono::milliseconds flush_interval_{20};
+  std::vector<std::shared_ptr<LogRing>> rings_;
+  std::string batch_;
+
+  std::mutex write_mutex_;
+  std::string write_batch_;
+
+  std::atomic<uint64_t> records_{0};
+  std::atomic<uint64_t> drops_{0};
+  uint64_t reported_drops_ = 0;
+};
+
 }  // namespace
 
 LogLevel GetLogLevel() {
@@ -100,6 +353,42 @@ bool ParseLogLevelName(std::string name, LogLevel* level) {
   return true;
 }
 
+bool StartAsyncLogging(size_t ring_capacity, std::chrono::milliseconds flush_interval) {
+  return AsyncLogger::GetInstance().Start(ring_capacity, flush_interval);
+}
+
+void StopAsyncLogging() {
+  AsyncLogger::GetInstance().Stop();
+}
+
+void FlushAsyncLogging() {
+  AsyncLogger::GetInstance().Flush();
+}
+
+AsyncLogStats GetAsyncLogStats() {
+  return AsyncLogger::GetInstance().GetStats();
+}
+
+void WriteLogRecord(LogLevel level, std::string&& record) {
+  if (level != LogLevel::FATAL && AsyncLogger::GetInstance().Push(std::move(record))) {
+    return;
+  }
+  if (level == LogLevel::FATAL) {
+    FlushAsyncLogging();
+  }
+  WriteToStderr(record);
+}
+
+LogMessage::~LogMessage() {
+  std::string msg = buf_.str();
+  WriteLogRecord(level_, FormatLogRecord(level_, throttled_, include_file_ ? file_ : nullptr, line_, msg));
+
+  if (level_ == LogLevel::FATAL) {
+    WriteTerminationLog(msg);
+    exit(1);
+  }
+}
+
 void InspectorLogCallback(std::string&& msg, sinsp_logger::severity severity) {
   auto collector_severity = (LogLevel)severity;
   collector::logging::LogMessage(__FILE__, __LINE__, false, collector_severity) << msg;
@@ -1,6 +1,7 @@
 #ifndef _LOGGING_H_
 #define _LOGGING_H_
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <iomanip>
@@ -54,47 +55,60 @@ void WriteTerminationLog(std::string message);
 
 const size_t LevelPaddingWidth = 7;
 
-class LogMessage {
- public:
-  LogMessage(const char* file, int line, bool throttled, LogLevel level)
-      : file_(file), line_(line), level_(level), throttled_(throttled) {
-    // if in debug mode, output file names associated with log messages
-    include_file_ = CheckLogLevel(LogLevel::DEBUG);
-  }
+// Asynchronous logging. When started, log records are formatted by the logging
+// thread and queued in a bounded ring owned by that thread, from which a writer
+// thread drains them to stderr. Records logged while a ring is full are
+// dropped and counted. Fatal records are always written synchronously, after
+// the queued ones.
+const size_t kAsyncLogRingCapacity = 1024;
 
-  ~LogMessage() {
-    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-    auto nowTm = gmtime(&now);
+struct AsyncLogStats {
+  uint64_t records;  // records written by the writer thread
+  uint64_t drops;    // records dropped because a ring was full
+};
 
-    std::cerr << GetGlobalLogPrefix()
-              << "["
-              << std::left << std::setw(LevelPaddingWidth) << GetLogLevelName(level_)
-              << " " << std::put_time(nowTm, "%Y/%m/%d %H:%M:%S")
-              << "] ";
+bool StartAsyncLogging(size_t ring_capacity = kAsyncLogRingCapacity,
+                       std::chrono::milliseconds flush_interval = std::chrono::milliseconds(20));
+void StopAsyncLogging();
+void FlushAsyncLogging();
+AsyncLogStats GetAsyncLogStats();
 
-    if (throttled_) {
-      std::cerr << "[Throttled] ";
-    }
+// Writes a formatted record, asynchronously if possible.
+void WriteLogRecord(LogLevel level, std::string&& record);
 
-    if (include_file_) {
-      const char* basename = strrchr(file_, '/');
-      if (!basename) {
-        basename = file_;
-      } else {
-        ++basename;
-      }
-      std::cerr << "(" << basename << ":" << line_ << ") ";
+// Per call site state of throttled log statements.
+class LogThrottle {
+ public:
+  // Returns true if at least interval has passed since the last time this
+  // returned true. Among concurrent callers, only one gets to log.
+  template <typename Duration>
+  bool Allow(Duration interval) {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    int64_t next = next_log_ns_.load(std::memory_order_relaxed);
+    if (now < next) {
+      return false;
     }
+    return next_log_ns_.compare_exchange_strong(
+        next, now + std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count(),
+        std::memory_order_relaxed);
+  }
 
-    std::cerr << buf_.str()
-              << std::endl;
+ private:
+  std::atomic<int64_t> next_log_ns_{0};
+};
 
-    if (level_ == LogLevel::FATAL) {
-      WriteTerminationLog(buf_.str());
-      exit(1);
-    }
+class LogMessage {
+ public:
+  LogMessage(const char* file, int line, bool throttled, LogLevel level)
+      : file_(file), line_(line), level_(level), throttled_(throttled) {
+    // if in debug mode, output file names associated with log messages
+    include_file_ = CheckLogLevel(LogLevel::DEBUG);
   }
 
+  ~LogMessage();
+
   template <typename T>
   LogMessage& operator<<(const T& arg) {
     buf_ << arg;
@@ -122,11 +136,15 @@ class LogMessage {
 
 #define CLOG(lvl) CLOG_IF(true, lvl)
 
+#define CLOG_CONCAT_(a, b) a##b
+#define CLOG_CONCAT(a, b) CLOG_CONCAT_(a, b)
+
+// The throttle is checked last, so that it is only consumed by messages that
+// are actually logged, and before anything is formatted.
 #define CLOG_THROTTLED_IF(cond, lvl, interval)                                          \
-  static std::chrono::steady_clock::time_point _clog_lastlog_##__LINE__;                \
+  static collector::logging::LogThrottle CLOG_CONCAT(_clog_throttle_, __LINE__);        \
   if (collector::logging::CheckLogLevel(collector::logging::LogLevel::lvl) && (cond) && \
-      (std::chrono::steady_clock::now() - _clog_lastlog_##__LINE__ >= interval))        \
-  _clog_lastlog_##__LINE__ = std::chrono::steady_clock::now(),                          \
+      CLOG_CONCAT(_clog_throttle_, __LINE__).Allow(interval))                           \
   collector::logging::LogMessage(__FILE__, __LINE__, true, collector::logging::LogLevel::lvl)
 
 #define CLOG_THROTTLED(lvl, interval) CLOG_THROTTLED_IF(true, lvl, interval)
@@ -0,0 +1,65 @@
+#include "MemoryAccounting.h"
+
+#include <fstream>
+
+#include <unistd.h>
+
+namespace collector {
+
+MemoryAccounting::Registration& MemoryAccounting::Registration::operator=(Registration&& other) noexcept {
+  if (this != &other) {
+    if (id_ != 0) {
+      MemoryAccounting::GetOrCreate().Unregister(id_);
+    }
+    id_ = std::exchange(other.id_, 0);
+  }
+  return *this;
+}
+
+MemoryAccounting::Registration::~Registration() {
+  if (id_ != 0) {
+    MemoryAccounting::GetOrCreate().Unregister(id_);
+  }
+}
+
+MemoryAccounting& MemoryAccounting::GetOrCreate() {
+  static MemoryAccounting accounting;
+
+  return accounting;
+}
+
+MemoryAccounting::Registration MemoryAccounting::Register(std::string subsystem, Reporter reporter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t id = next_id_++;
+  reporters_.emplace(id, std::make_pair(std::move(subsystem), std::move(reporter)));
+  return Registration(id);
+}
+
+void MemoryAccounting::Unregister(uint64_t id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  reporters_.erase(id);
+}
+
+std::map<std::string, MemoryUsage> MemoryAccounting::Collect() const {
+  std::map<std::string, MemoryUsage> usage;
+
+  // Reporters are called with the lock held, so that they are not
+  // unregistered, and their subsystem destroyed, while being called.
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& reporter : reporters_) {
+    usage[reporter.second.first] += reporter.second.second();
+  }
+
+  return usage;
+}
+
+size_t ReadResidentBytes(const char* statm_path) {
+  std::ifstream statm(statm_path);
+  size_t size_pages, resident_pages;
+  if (!(statm >> size_pages >> resident_pages)) {
+    return 0;
+  }
+  return resident_pages * sysconf(_SC_PAGESIZE);
+}
+
+}  // namespace collector
@@ -0,0 +1,113 @@
+#ifndef COLLECTOR_MEMORYACCOUNTING_H
+#define COLLECTOR_MEMORYACCOUNTING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace collector {
+
+// Approximate memory used by a subsystem, and the number of entries it holds
+// (connections, processes, ...), where meaningful.
+struct MemoryUsage {
+  size_t entries = 0;
+  size_t bytes = 0;
+
+  MemoryUsage& operator+=(const MemoryUsage& other) {
+    entries += other.entries;
+    bytes += other.bytes;
+    return *this;
+  }
+};
+
+// Approximates the memory used by an unordered container: one node per
+// element, holding the element, the next node pointer and the cached hash,
+// and the bucket array. Memory owned by the elements themselves, e.g., long
+// strings, is not included.
+template <typename Container>
+size_t ApproxHashContainerBytes(const Container& container) {
+  return container.size() * (sizeof(typename Container::value_type) + 2 * sizeof(void*)) +
+         container.bucket_count() * sizeof(void*);
+}
+
+// MemoryAccounting keeps track of the memory used by collector subsystems, so
+// that the overall footprint can be attributed to them. Subsystems register a
+// reporter, called whenever the usage is collected, which must be safe to call
+// from any thread.
+class MemoryAccounting {
+ public:
+  using Reporter = std::function<MemoryUsage()>;
+
+  // Unregisters the reporter when destroyed, waiting for it to return if it is
+  // being called.
+  class Registration {
+   public:
+    Registration() = default;
+    Registration(Registration&& other) noexcept : id_(std::exchange(other.id_, 0)) {}
+    Registration& operator=(Registration&& other) noexcept;
+    ~Registration();
+
+    Registration(const Registration&) = delete;
+    Registration& operator=(const Registration&) = delete;
+
+   private:
+    friend class MemoryAccounting;
+    explicit Registration(uint64_t id) : id_(id) {}
+
+    uint64_t id_ = 0;
+  };
+
+  static MemoryAccounting& GetOrCreate();
+
+  Registration Register(std::string subsystem, Reporter reporter);
+
+  // Returns the usage of each subsystem, by name. Reporters registered under
+  // the same name, e.g., by several instances of a class, are summed.
+  std::map<std::string, MemoryUsage> Collect() const;
+
+ private:
+  void Unregister(uint64_t id);
+
+  mutable std::mutex mutex_;
+  std::map<uint64_t, std::pair<std::string, Reporter>> reporters_;
+  uint64_t next_id_ = 1;
+};
+
+// MemoryGauge reports the usage of state only accessed by its owner thread,
+// which sets it whenever the state changes significantly.
+class MemoryGauge {
+ public:
+  explicit MemoryGauge(std::string subsystem)
+      : registration_(MemoryAccounting::GetOrCreate().Register(std::move(subsystem), [this] { return Get(); })) {}
+
+  void Set(MemoryUsage usage) {
+    entries_.store(usage.entries, std::memory_order_relaxed);
+    bytes_.store(usage.bytes, std::memory_order_relaxed);
+  }
+
+  MemoryUsage Get() const {
+    MemoryUsage usage;
+    usage.entries = entries_.load(std::memory_order_relaxed);
+    usage.bytes = bytes_.load(std::memory_order_relaxed);
+    return usage;
+  }
+
+ private:
+  std::atomic<size_t> entries_{0};
+  std::atomic<size_t> bytes_{0};
+  // Last, to be unregistered before the values are destroyed.
+  MemoryAccounting::Registration registration_;
+};
+
+// Reads the resident set size of collector, returns 0 if unavailable.
+size_t ReadResidentBytes(const char* statm_path = "/proc/self/statm");
+
+}  // namespace collector
+
+#endif  // COLLECTOR_MEMORYACCOUNTING_H
@@ -0,0 +1,30 @@
+#include "MemoryHandler.h"
+
+#include <json/json.h>
+
+#include "MemoryAccounting.h"
+
+namespace collector {
+
+bool MemoryHandler::handleGet(CivetServer* server, struct mg_connection* conn) {
+  Json::Value response(Json::objectValue);
+
+  size_t accounted_bytes = 0;
+  Json::Value& subsystems = response["subsystems"] = Json::Value(Json::objectValue);
+  for (const auto& subsystem : MemoryAccounting::GetOrCreate().Collect()) {
+    Json::Value usage(Json::objectValue);
+    usage["entries"] = Json::UInt64(subsystem.second.entries);
+    usage["bytes"] = Json::UInt64(subsystem.second.bytes);
+    subsystems[subsystem.first] = usage;
+    accounted_bytes += subsystem.second.bytes;
+  }
+  response["accounted_bytes"] = Json::UInt64(accounted_bytes);
+  response["resident_bytes"] = Json::UInt64(ReadResidentBytes());
+
+  mg_printf(conn, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n");
+  mg_printf(conn, "%s\n", response.toStyledString().c_str());
+
+  return true;
+}
+
+}  // namespace collector
@@ -0,0 +1,18 @@
+#ifndef COLLECTOR_MEMORYHANDLER_H
+#define COLLECTOR_MEMORYHANDLER_H
+
+#include "CivetServer.h"
+
+namespace collector {
+
+// GET /memory
+//   - get the approximate memory used by each collector subsystem, along with
+//     the resident set size of collector, as JSON
+class MemoryHandler : public CivetHandler {
+ public:
+  bool handleGet(CivetServer* server, struct mg_connection* conn);
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_MEMORYHANDLER_H
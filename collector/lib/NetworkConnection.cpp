@@ -10,15 +10,6 @@
 
 namespace collector {
 
-bool Address::IsPublic() const {
-  for (const auto& net : PrivateNetworks(family_)) {
-    if (net.Contains(*this)) {
-      return false;
-    }
-  }
-  return true;
-}
-
 std::ostream& operator<<(std::ostream& os, L4Proto l4proto) {
   switch (l4proto) {
     case L4Proto::TCP:
@@ -58,6 +49,53 @@ std::ostream& operator<<(std::ostream& os, const Connection& conn) {
   return os << "]";
 }
 
+CompactConnection::CompactConnection(const Connection& conn)
+    : container_(conn.container()),
+      flags_((static_cast<uint8_t>(conn.l4proto()) << 1) | (conn.is_server() ? 1 : 0)),
+      net_flags_(0) {
+  SetEndpoint(kLocal, conn.local());
+  SetEndpoint(kRemote, conn.remote());
+}
+
+Connection CompactConnection::ToConnection() const {
+  return Connection(container_, GetEndpoint(kLocal), GetEndpoint(kRemote), static_cast<L4Proto>(flags_ >> 1), (flags_ & 0x1) != 0);
+}
+
+void CompactConnection::SetEndpoint(size_t index, const Endpoint& endpoint) {
+  const IPNet& network = endpoint.network();
+  const auto& data = network.address().array();
+  uint64_t* address = &addresses_[index * Address::kU64MaxLen];
+
+  if (network.IsAddress()) {
+    std::copy(data.begin(), data.end(), address);
+  } else {
+    // Only the network address is relevant, the mask is recomputed from it.
+    auto mask = network.net_mask_array();
+    for (size_t i = 0; i < Address::kU64MaxLen; i++) {
+      address[i] = htonll(ntohll(data[i]) & mask[i]);
+    }
+    net_flags_ |= 1 << index;
+  }
+
+  ports_[index] = endpoint.port();
+  families_[index] = static_cast<uint8_t>(network.family());
+  bits_[index] = network.bits();
+}
+
+Address CompactConnection::remote_address() const {
+  std::array<uint64_t, Address::kU64MaxLen> data;
+  std::copy_n(&addresses_[kRemote * Address::kU64MaxLen], Address::kU64MaxLen, data.begin());
+  return Address(static_cast<Address::Family>(families_[kRemote]), data);
+}
+
+Endpoint CompactConnection::GetEndpoint(size_t index) const {
+  std::array<uint64_t, Address::kU64MaxLen> data;
+  std::copy_n(&addresses_[index * Address::kU64MaxLen], Address::kU64MaxLen, data.begin());
+
+  Address address(static_cast<Address::Family>(families_[index]), data);
+  return Endpoint(IPNet(address, bits_[index], (net_flags_ & (1 << index)) == 0), ports_[index]);
+}
+
 static bool parse_address(const char* address, struct sockaddr_storage& sockaddr) {
   struct addrinfo hints = {.ai_flags = AI_NUMERICHOST, 0};
   struct addrinfo* addrinfo = NULL;
@@ -396,6 +396,59 @@ class Connection {
 
 std::ostream& operator<<(std::ostream& os, const Connection& conn);
 
+// CompactConnection is a packed representation of a Connection, used to store connections in bulk. Endpoints are
+// stored as their address bytes, port, family and prefix length only, as the mask of an IPNet can be derived from
+// those. Endpoints which are networks rather than plain addresses are stored with their network address, which
+// preserves equality with Connection.
+class CompactConnection {
+ public:
+  CompactConnection() : ports_({0, 0}), families_({0, 0}), bits_({0, 0}), flags_(0), net_flags_(0) {}
+  explicit CompactConnection(const Connection& conn);
+
+  Connection ToConnection() const;
+
+  // The fields of the connection which can be read without converting it back.
+  const std::string& container() const { return container_; }
+  L4Proto l4proto() const { return static_cast<L4Proto>(flags_ >> 1); }
+  bool is_server() const { return (flags_ & 0x1) != 0; }
+  uint16_t local_port() const { return ports_[kLocal]; }
+  uint16_t remote_port() const { return ports_[kRemote]; }
+  // Same as ToConnection().remote().address().
+  Address remote_address() const;
+
+  // Like IPNet, networks are compared by their prefix only, regardless of their family, so that keys which are equal
+  // as Connection are equal here as well.
+  bool operator==(const CompactConnection& other) const {
+    return container_ == other.container_ && addresses_ == other.addresses_ && ports_ == other.ports_ &&
+           bits_ == other.bits_ && flags_ == other.flags_ && net_flags_ == other.net_flags_ &&
+           SameFamily(other, kLocal) && SameFamily(other, kRemote);
+  }
+
+  bool operator!=(const CompactConnection& other) const {
+    return !(*this == other);
+  }
+
+  size_t Hash() const { return HashAll(container_, addresses_, ports_, flags_); }
+
+ private:
+  static constexpr size_t kLocal = 0;
+  static constexpr size_t kRemote = 1;
+
+  void SetEndpoint(size_t index, const Endpoint& endpoint);
+  Endpoint GetEndpoint(size_t index) const;
+  bool SameFamily(const CompactConnection& other, size_t index) const {
+    return (net_flags_ & (1 << index)) != 0 || families_[index] == other.families_[index];
+  }
+
+  std::string container_;
+  std::array<uint64_t, 2 * Address::kU64MaxLen> addresses_;
+  std::array<uint16_t, 2> ports_;
+  std::array<uint8_t, 2> families_;
+  std::array<uint8_t, 2> bits_;
+  uint8_t flags_;      // same as Connection
+  uint8_t net_flags_;  // bit i is set if endpoint i is a network rather than an address
+};
+
 // Checks if the given connection is relevant (i.e., it is a connection with a remote address that is
 // not a local loopback address).
 inline bool IsRelevantConnection(const Connection& conn) {
@@ -418,15 +471,59 @@ inline int IsEphemeralPort(uint16_t port) {
   return 0;                                    // not ephemeral according to any range
 }
 
+// Private IPv4 networks, as a network address and mask in host byte order.
+struct IPv4Prefix {
+  uint32_t network;
+  uint32_t mask;
+};
+
+inline constexpr IPv4Prefix kPrivateIPv4Prefixes[] = {
+    {0x0a000000, 0xff000000},  // 10.0.0.0/8
+    {0x64400000, 0xffc00000},  // 100.64.0.0/10
+    {0xa9fe0000, 0xffff0000},  // 169.254.0.0/16
+    {0xac100000, 0xfff00000},  // 172.16.0.0/12
+    {0xc0a80000, 0xffff0000},  // 192.168.0.0/16
+};
+
+// IsPrivateIPv4 checks if the given IPv4 address, in host byte order, is in a private network. All prefixes are
+// checked, without branching on any of them, as addresses are classified for every connection.
+inline bool IsPrivateIPv4(uint32_t ipv4) {
+  bool is_private = false;
+  for (const auto& prefix : kPrivateIPv4Prefixes) {
+    is_private |= (ipv4 & prefix.mask) == prefix.network;
+  }
+  return is_private;
+}
+
+// IsPrivateIPv6 checks if the given IPv6 address, as its high and low 64 bits in host byte order, is a unique local
+// address (fd00::/8) or an IPv4-mapped address in a private IPv4 network.
+inline bool IsPrivateIPv6(uint64_t high, uint64_t low) {
+  bool is_ula = (high >> 56) == 0xfd;
+  bool is_ipv4_mapped = high == 0 && (low >> 32) == 0xffff;
+  return is_ula | (is_ipv4_mapped & IsPrivateIPv4(static_cast<uint32_t>(low)));
+}
+
+inline bool Address::IsPublic() const {
+  switch (family_) {
+    case Family::IPV4:
+      return !IsPrivateIPv4(static_cast<uint32_t>(ntohll(data_[0]) >> 32));
+    case Family::IPV6:
+      return !IsPrivateIPv6(ntohll(data_[0]), ntohll(data_[1]));
+    default:
+      return true;
+  }
+}
+
 // PrivateIPv4Networks return private IPv4 networks.
 static inline const std::vector<IPNet>& PrivateIPv4Networks() {
-  static auto* networks = new std::vector<IPNet>{
-      IPNet(Address(10, 0, 0, 0), 8),
-      IPNet(Address(100, 64, 0, 0), 10),
-      IPNet(Address(169, 254, 0, 0), 16),
-      IPNet(Address(172, 16, 0, 0), 12),
-      IPNet(Address(192, 168, 0, 0), 16),
-  };
+  static auto* networks = []() {
+    auto* networks = new std::vector<IPNet>();
+    networks->reserve(std::size(kPrivateIPv4Prefixes));
+    for (const auto& prefix : kPrivateIPv4Prefixes) {
+      networks->emplace_back(Address(htonl(prefix.network)), __builtin_popcount(prefix.mask));
+    }
+    return networks;
+  }();
 
   return *networks;
 }
@@ -3,6 +3,8 @@
 #include <optional>
 
 #include "EventMap.h"
+#include "Logging.h"
+#include "TimeUtil.h"
 
 namespace collector {
 
@@ -12,6 +14,7 @@ enum class Modifier : uint8_t {
   INVALID = 0,
   ADD,
   REMOVE,
+  CONTAINER_EXIT,
 };
 
 EventMap<Modifier> modifiers = {
@@ -21,6 +24,8 @@ EventMap<Modifier> modifiers = {
         {"connect<", Modifier::ADD},
         {"accept<", Modifier::ADD},
         {"getsockopt<", Modifier::ADD},
+        {"listen<", Modifier::ADD},
+        {"procexit>", Modifier::CONTAINER_EXIT},
     },
     Modifier::INVALID,
 };
@@ -112,24 +117,133 @@ std::optional<Connection> NetworkSignalHandler::GetConnection(sinsp_evt* evt) {
   return {Connection(*container_id, *local, *remote, l4proto, is_server)};
 }
 
+/*
+ * Listen endpoint life-cycle:
+ *   - events:  bind() = 0 --> listen() = 0 --> close() = 0
+ *     fd_info: server socket  server socket    server socket
+ *     result:  (none)         ADD              REMOVE
+ */
+std::optional<ContainerEndpoint> NetworkSignalHandler::GetContainerEndpoint(sinsp_evt* evt, bool with_originator) {
+  auto* fd_info = evt->get_fd_info();
+
+  if (!fd_info) return std::nullopt;
+
+  Endpoint endpoint;
+  switch (fd_info->m_type) {
+    case SCAP_FD_IPV4_SERVSOCK: {
+      const auto& ipv4_info = fd_info->m_sockinfo.m_ipv4serverinfo;
+      if (ipv4_info.m_l4proto != SCAP_L4_TCP) return std::nullopt;
+      endpoint = Endpoint(Address(ipv4_info.m_ip), ipv4_info.m_port);
+      break;
+    }
+    case SCAP_FD_IPV6_SERVSOCK: {
+      const auto& ipv6_info = fd_info->m_sockinfo.m_ipv6serverinfo;
+      if (ipv6_info.m_l4proto != SCAP_L4_TCP) return std::nullopt;
+      endpoint = Endpoint(Address(ipv6_info.m_ip.m_b), ipv6_info.m_port);
+      break;
+    }
+    default:
+      return std::nullopt;
+  }
+
+  const int64_t* res = event_extractor_.get_event_rawres(evt);
+  if (!res || *res < 0) {
+    return std::nullopt;
+  }
+
+  const std::string* container_id = event_extractor_.get_container_id(evt);
+  if (!container_id) return std::nullopt;
+
+  std::shared_ptr<IProcess> originator;
+  if (with_originator && process_store_) {
+    if (const auto* tinfo = evt->get_thread_info()) {
+      originator = process_store_->Fetch(tinfo->m_pid);
+    }
+  }
+
+  return {ContainerEndpoint(*container_id, endpoint, L4Proto::TCP, originator)};
+}
+
+SignalHandler::Result NetworkSignalHandler::HandleContainerExit(sinsp_evt* evt) {
+  const auto* tinfo = evt->get_thread_info();
+
+  // All the processes of a container are gone once the init process of its
+  // pid namespace exits. This closes the container without waiting for the
+  // container manager to notice it is gone.
+  if (!tinfo || tinfo->m_container_id.empty() || tinfo->m_vpid != 1 || !tinfo->is_main_thread()) {
+    return SignalHandler::IGNORED;
+  }
+
+  conn_tracker_->CloseContainer(tinfo->m_container_id, evt->get_ts() / 1000UL);
+  return SignalHandler::PROCESSED;
+}
+
+void NetworkSignalHandler::HandleContainerRemoved(const std::string& container_id) {
+  conn_tracker_->CloseContainer(container_id, NowMicros());
+}
+
 SignalHandler::Result NetworkSignalHandler::HandleSignal(sinsp_evt* evt) {
   auto modifier = modifiers[evt->get_type()];
   if (modifier == Modifier::INVALID) return SignalHandler::IGNORED;
 
+  if (modifier == Modifier::CONTAINER_EXIT) {
+    return HandleContainerExit(evt);
+  }
+
+  if (track_listen_endpoints_) {
+    bool added = modifier == Modifier::ADD;
+    auto endpoint = GetContainerEndpoint(evt, added);
+    if (endpoint.has_value()) {
+      if (!IsRelevantEndpoint(endpoint->endpoint())) {
+        return SignalHandler::IGNORED;
+      }
+
+      conn_tracker_->UpdateEndpoint(*endpoint, evt->get_ts() / 1000UL, added);
+      return SignalHandler::PROCESSED;
+    }
+  }
+
   auto result = GetConnection(evt);
   if (!result.has_value() || !IsRelevantConnection(*result)) {
     return SignalHandler::IGNORED;
   }
 
-  conn_tracker_->UpdateConnection(*result, evt->get_ts() / 1000UL, modifier == Modifier::ADD);
+  if (workers_) {
+    workers_->UpdateConnection(*result, evt->get_ts() / 1000UL, modifier == Modifier::ADD);
+  } else {
+    conn_tracker_->UpdateConnection(*result, evt->get_ts() / 1000UL, modifier == Modifier::ADD);
+  }
   return SignalHandler::PROCESSED;
 }
 
 std::vector<std::string> NetworkSignalHandler::GetRelevantEvents() {
-  return {"close<", "shutdown<", "connect<", "accept<", "getsockopt<"};
+  std::vector<std::string> events = {"close<", "shutdown<", "connect<", "accept<", "getsockopt<", "procexit>"};
+  if (track_listen_endpoints_) {
+    events.push_back("listen<");
+  }
+  return events;
+}
+
+void NetworkSignalHandler::SetNumWorkers(size_t num_workers) {
+  if (num_workers == 0) {
+    workers_.reset();
+    return;
+  }
+  workers_ = std::make_unique<ConnectionTrackerWorkers>(conn_tracker_, num_workers);
+}
+
+bool NetworkSignalHandler::Start() {
+  if (workers_) {
+    CLOG(INFO) << "Applying connection updates from " << workers_->NumWorkers() << " worker threads";
+    workers_->Start();
+  }
+  return true;
 }
 
 bool NetworkSignalHandler::Stop() {
+  if (workers_) {
+    workers_->Stop();
+  }
   event_extractor_.ClearWrappers();
   return true;
 }
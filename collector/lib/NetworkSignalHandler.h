@@ -3,7 +3,11 @@
 
 #include <optional>
 
+#include <gtest/gtest_prod.h>
+
 #include "ConnTracker.h"
+#include "ConnTrackerWorkers.h"
+#include "Process.h"
 #include "SignalHandler.h"
 #include "SysdigEventExtractor.h"
 #include "SysdigService.h"
@@ -15,23 +19,48 @@ class NetworkSignalHandler final : public SignalHandler {
   explicit NetworkSignalHandler(sinsp* inspector, std::shared_ptr<ConnectionTracker> conn_tracker, SysdigStats* stats)
       : conn_tracker_(std::move(conn_tracker)), stats_(stats), collect_connection_status_(true) {
     event_extractor_.Init(inspector);
+    // Removals are reported from the event loop, by the periodic sweep of the
+    // containers without threads (see SysdigService::InitKernel).
+    inspector->m_container_manager.subscribe_on_remove_container([this](const sinsp_container_info& container) {
+      HandleContainerRemoved(container.m_id);
+    });
   }
 
   std::string GetName() override { return "NetworkSignalHandler"; }
   Result HandleSignal(sinsp_evt* evt) override;
   std::vector<std::string> GetRelevantEvents() override;
+  bool Start() override;
   bool Stop() override;
 
   void SetCollectConnectionStatus(bool collect_connection_status) { collect_connection_status_ = collect_connection_status; }
+  // Experimental: apply connection updates from this many worker threads
+  // instead of the event loop. 0 disables the workers.
+  void SetNumWorkers(size_t num_workers);
+  // Maintain listen endpoints from listen() and close() events. process_store,
+  // when provided, is used to link the originator process of the endpoints.
+  void SetTrackListenEndpoints(bool track_listen_endpoints, std::shared_ptr<ProcessStore> process_store) {
+    track_listen_endpoints_ = track_listen_endpoints;
+    process_store_ = std::move(process_store);
+  }
 
  private:
+  FRIEND_TEST(NetworkSignalHandlerTest, TestContainerRemoved);
+
   std::optional<Connection> GetConnection(sinsp_evt* evt);
+  std::optional<ContainerEndpoint> GetContainerEndpoint(sinsp_evt* evt, bool with_originator);
+  // The entries of a container are closed when the init process of its pid
+  // namespace exits, or else when the container manager removes it.
+  Result HandleContainerExit(sinsp_evt* evt);
+  void HandleContainerRemoved(const std::string& container_id);
 
   SysdigEventExtractor event_extractor_;
   std::shared_ptr<ConnectionTracker> conn_tracker_;
+  std::unique_ptr<ConnectionTrackerWorkers> workers_;
   SysdigStats* stats_;
 
   bool collect_connection_status_;
+  bool track_listen_endpoints_ = false;
+  std::shared_ptr<ProcessStore> process_store_;
 };
 
 }  // namespace collector
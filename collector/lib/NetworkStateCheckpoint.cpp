@@ -0,0 +1,339 @@
+#include "NetworkStateCheckpoint.h"
+
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FileSystem.h"
+#include "Logging.h"
+#include "Process.h"
+
+namespace collector {
+
+namespace {
+
+bool WriteAll(int fd, const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t rv = write(fd, data.data() + written, data.size() - written);
+    if (rv < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    written += rv;
+  }
+  return true;
+}
+
+// Originator process of a restored endpoint. Only the attributes reported to Sensor are available.
+class CheckpointProcess : public IProcess {
+ public:
+  CheckpointProcess(uint64_t pid, std::string container_id, std::string comm, std::string exe, std::string exe_path,
+                    std::string args)
+      : pid_(pid), container_id_(std::move(container_id)), comm_(std::move(comm)), exe_(std::move(exe)), exe_path_(std::move(exe_path)), args_(std::move(args)) {}
+
+  uint64_t pid() const override { return pid_; }
+  std::string container_id() const override { return container_id_; }
+  std::string comm() const override { return comm_; }
+  std::string exe() const override { return exe_; }
+  std::string exe_path() const override { return exe_path_; }
+  std::string args() const override { return args_; }
+
+ private:
+  uint64_t pid_;
+  std::string container_id_;
+  std::string comm_;
+  std::string exe_;
+  std::string exe_path_;
+  std::string args_;
+};
+
+// The checkpoint is only ever read back on the host it was written on, hence values are stored in host byte order.
+class Encoder {
+ public:
+  template <typename T>
+  void Put(T value) {
+    static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable values can be encoded");
+    buf_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void PutString(const std::string& str) {
+    Put<uint32_t>(str.size());
+    buf_.append(str);
+  }
+
+  void PutEndpoint(const Endpoint& endpoint) {
+    const IPNet& network = endpoint.network();
+    Put<uint8_t>(static_cast<uint8_t>(network.family()));
+    Put(network.address().array());
+    Put<uint8_t>(network.bits());
+    Put<uint8_t>(network.IsAddress());
+    Put<uint16_t>(endpoint.port());
+  }
+
+  void PutStatus(const ConnStatus& status) {
+    Put<int64_t>(status.LastActiveTime());
+    Put<uint8_t>(status.IsActive());
+  }
+
+  const std::string& data() const { return buf_; }
+
+ private:
+  std::string buf_;
+};
+
+class Decoder {
+ public:
+  Decoder(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+  template <typename T>
+  bool Get(T* value) {
+    if (static_cast<size_t>(end_ - p_) < sizeof(T)) return false;
+    std::memcpy(value, p_, sizeof(T));
+    p_ += sizeof(T);
+    return true;
+  }
+
+  bool GetString(std::string* str) {
+    uint32_t size;
+    if (!Get(&size) || static_cast<size_t>(end_ - p_) < size) return false;
+    str->assign(p_, size);
+    p_ += size;
+    return true;
+  }
+
+  bool GetEndpoint(Endpoint* endpoint) {
+    uint8_t family, bits, is_addr;
+    std::array<uint64_t, Address::kU64MaxLen> data;
+    uint16_t port;
+    if (!Get(&family) || !Get(&data) || !Get(&bits) || !Get(&is_addr) || !Get(&port)) return false;
+    if (family > static_cast<uint8_t>(Address::Family::IPV6)) return false;
+
+    Address address(static_cast<Address::Family>(family), data);
+    *endpoint = Endpoint(IPNet(address, bits, is_addr != 0), port);
+    return true;
+  }
+
+  bool GetL4Proto(L4Proto* l4proto) {
+    uint8_t value;
+    if (!Get(&value) || value > static_cast<uint8_t>(L4Proto::ICMP)) return false;
+    *l4proto = static_cast<L4Proto>(value);
+    return true;
+  }
+
+  bool GetStatus(ConnStatus* status) {
+    int64_t last_active_time;
+    uint8_t active;
+    if (!Get(&last_active_time) || !Get(&active)) return false;
+    *status = ConnStatus(last_active_time, active != 0);
+    return true;
+  }
+
+  bool AtEnd() const { return p_ == end_; }
+
+ private:
+  const char* p_;
+  const char* end_;
+};
+
+bool DecodeConnections(Decoder* decoder, ConnMap* conn_state) {
+  uint64_t count;
+  if (!decoder->Get(&count)) return false;
+
+  for (uint64_t i = 0; i < count; i++) {
+    std::string container;
+    Endpoint local, remote;
+    L4Proto l4proto;
+    uint8_t is_server;
+    ConnStatus status;
+    if (!decoder->GetString(&container) || !decoder->GetEndpoint(&local) || !decoder->GetEndpoint(&remote) ||
+        !decoder->GetL4Proto(&l4proto) || !decoder->Get(&is_server) || !decoder->GetStatus(&status)) {
+      return false;
+    }
+    conn_state->emplace(Connection(std::move(container), local, remote, l4proto, is_server != 0), status);
+  }
+  return true;
+}
+
+bool DecodeEndpoints(Decoder* decoder, AdvertisedEndpointMap* endpoint_state) {
+  uint64_t count;
+  if (!decoder->Get(&count)) return false;
+
+  for (uint64_t i = 0; i < count; i++) {
+    std::string container;
+    Endpoint endpoint;
+    L4Proto l4proto;
+    uint8_t has_originator;
+    if (!decoder->GetString(&container) || !decoder->GetEndpoint(&endpoint) || !decoder->GetL4Proto(&l4proto) ||
+        !decoder->Get(&has_originator)) {
+      return false;
+    }
+
+    std::shared_ptr<IProcess> originator;
+    if (has_originator) {
+      uint64_t pid;
+      std::string container_id, comm, exe, exe_path, args;
+      if (!decoder->Get(&pid) || !decoder->GetString(&container_id) || !decoder->GetString(&comm) ||
+          !decoder->GetString(&exe) || !decoder->GetString(&exe_path) || !decoder->GetString(&args)) {
+        return false;
+      }
+      originator = std::make_shared<CheckpointProcess>(pid, std::move(container_id), std::move(comm), std::move(exe),
+                                                       std::move(exe_path), std::move(args));
+    }
+
+    ConnStatus status;
+    if (!decoder->GetStatus(&status)) return false;
+    endpoint_state->emplace(ContainerEndpoint(std::move(container), endpoint, l4proto, originator), status);
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string NetworkStateCheckpoint::ReadBootId() {
+  std::ifstream file("/proc/sys/kernel/random/boot_id");
+  std::string boot_id;
+  if (!file || !std::getline(file, boot_id)) {
+    CLOG(WARNING) << "Failed to read the kernel boot ID";
+    return "";
+  }
+  return boot_id;
+}
+
+bool NetworkStateCheckpoint::Write(const ConnMap& conn_state, const AdvertisedEndpointMap& endpoint_state,
+                                   int64_t timestamp_micros) const {
+  Encoder encoder;
+  encoder.Put(kMagic);
+  encoder.Put(kVersion);
+  encoder.PutString(boot_id_);
+  encoder.Put(timestamp_micros);
+
+  encoder.Put<uint64_t>(conn_state.size());
+  for (const auto& entry : conn_state) {
+    const Connection& conn = entry.first;
+    encoder.PutString(conn.container());
+    encoder.PutEndpoint(conn.local());
+    encoder.PutEndpoint(conn.remote());
+    encoder.Put<uint8_t>(static_cast<uint8_t>(conn.l4proto()));
+    encoder.Put<uint8_t>(conn.is_server());
+    encoder.PutStatus(entry.second);
+  }
+
+  encoder.Put<uint64_t>(endpoint_state.size());
+  for (const auto& entry : endpoint_state) {
+    const ContainerEndpoint& cep = entry.first;
+    encoder.PutString(cep.container());
+    encoder.PutEndpoint(cep.endpoint());
+    encoder.Put<uint8_t>(static_cast<uint8_t>(cep.l4proto()));
+    encoder.Put<uint8_t>(cep.originator() != nullptr);
+    if (cep.originator()) {
+      const IProcess& process = *cep.originator();
+      encoder.Put<uint64_t>(process.pid());
+      encoder.PutString(process.container_id());
+      encoder.PutString(process.comm());
+      encoder.PutString(process.exe());
+      encoder.PutString(process.exe_path());
+      encoder.PutString(process.args());
+    }
+    encoder.PutStatus(entry.second);
+  }
+
+  // The data must be on disk before the rename, or a crash could leave an empty or partial file in place of the
+  // previous checkpoint.
+  std::string tmp_path = path_ + ".tmp";
+  {
+    FDHandle fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (!fd.valid()) {
+      CLOG(ERROR) << "Failed to create network state checkpoint " << tmp_path << ": " << StrError();
+      return false;
+    }
+    if (!WriteAll(fd.get(), encoder.data()) || fsync(fd.get()) != 0) {
+      CLOG(ERROR) << "Failed to write network state checkpoint " << tmp_path << ": " << StrError();
+      return false;
+    }
+  }
+
+  if (rename(tmp_path.c_str(), path_.c_str()) != 0) {
+    CLOG(ERROR) << "Failed to rename network state checkpoint " << tmp_path << ": " << StrError();
+    return false;
+  }
+
+  // Persists the rename itself.
+  auto slash = path_.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path_.substr(0, slash));
+  FDHandle dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (!dir_fd.valid() || fsync(dir_fd.get()) != 0) {
+    CLOG(WARNING) << "Failed to sync the directory of network state checkpoint " << path_ << ": " << StrError();
+  }
+
+  return true;
+}
+
+bool NetworkStateCheckpoint::Read(int64_t now_micros, int64_t max_age_micros,
+                                  ConnMap* conn_state, AdvertisedEndpointMap* endpoint_state, int64_t* timestamp_micros) const {
+  if (boot_id_.empty()) {
+    return false;
+  }
+
+  FDHandle fd = open(path_.c_str(), O_RDONLY);
+  if (!fd.valid()) {
+    if (errno != ENOENT) {
+      CLOG(WARNING) << "Failed to open network state checkpoint " << path_ << ": " << StrError();
+    }
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd.get(), &st) != 0 || st.st_size == 0) {
+    return false;
+  }
+
+  size_t size = st.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+  if (data == MAP_FAILED) {
+    CLOG(WARNING) << "Failed to map network state checkpoint " << path_ << ": " << StrError();
+    return false;
+  }
+
+  Decoder decoder(static_cast<const char*>(data), size);
+  uint32_t magic, version;
+  std::string boot_id;
+  int64_t timestamp;
+  ConnMap conns;
+  AdvertisedEndpointMap endpoints;
+
+  bool valid = false;
+  if (!decoder.Get(&magic) || magic != kMagic || !decoder.Get(&version)) {
+    CLOG(WARNING) << "Ignoring invalid network state checkpoint " << path_;
+  } else if (version != kVersion) {
+    CLOG(INFO) << "Ignoring network state checkpoint with version " << version << " (expected " << kVersion << ")";
+  } else if (!decoder.GetString(&boot_id) || !decoder.Get(&timestamp)) {
+    CLOG(WARNING) << "Ignoring invalid network state checkpoint " << path_;
+  } else if (boot_id != boot_id_) {
+    CLOG(INFO) << "Ignoring network state checkpoint from a previous boot";
+  } else if (now_micros - timestamp > max_age_micros) {
+    CLOG(INFO) << "Ignoring network state checkpoint older than " << max_age_micros / 1000000 << " seconds";
+  } else if (!DecodeConnections(&decoder, &conns) || !DecodeEndpoints(&decoder, &endpoints) || !decoder.AtEnd()) {
+    CLOG(WARNING) << "Ignoring invalid network state checkpoint " << path_;
+  } else {
+    valid = true;
+  }
+
+  munmap(data, size);
+
+  if (!valid) {
+    return false;
+  }
+
+  *conn_state = std::move(conns);
+  *endpoint_state = std::move(endpoints);
+  *timestamp_micros = timestamp;
+  return true;
+}
+
+}  // namespace collector
@@ -0,0 +1,46 @@
+#ifndef COLLECTOR_NETWORKSTATECHECKPOINT_H
+#define COLLECTOR_NETWORKSTATECHECKPOINT_H
+
+#include <string>
+
+#include "ConnTracker.h"
+
+namespace collector {
+
+// NetworkStateCheckpoint persists the network state last reported to Sensor (the connections and the listen endpoints,
+// including the ones kept during the afterglow period) to a compact binary file. A restarted collector can read it back
+// and resume reporting deltas, instead of sending the full state again.
+//
+// A checkpoint is only read back if it was written with the same format version, during the same boot of the kernel,
+// and if it is not older than the given maximum age. Originator processes of endpoints are stored with the attributes
+// that are reported to Sensor, which is what AdvertisedEndpointMap compares.
+class NetworkStateCheckpoint {
+ public:
+  static constexpr uint32_t kMagic = 0x4b434e52;  // "RNCK"
+  static constexpr uint32_t kVersion = 1;
+
+  explicit NetworkStateCheckpoint(std::string path, std::string boot_id = ReadBootId())
+      : path_(std::move(path)), boot_id_(std::move(boot_id)) {}
+
+  // Writes the state to the checkpoint file. The file is replaced atomically, so that a crash while writing leaves
+  // the previous checkpoint in place.
+  bool Write(const ConnMap& conn_state, const AdvertisedEndpointMap& endpoint_state, int64_t timestamp_micros) const;
+
+  // Reads the state from the checkpoint file. Returns false if the file does not exist, is invalid, or is not
+  // usable anymore (other kernel boot, or older than max_age_micros at now_micros).
+  bool Read(int64_t now_micros, int64_t max_age_micros,
+            ConnMap* conn_state, AdvertisedEndpointMap* endpoint_state, int64_t* timestamp_micros) const;
+
+  const std::string& path() const { return path_; }
+
+  // Returns the ID of the current kernel boot, or an empty string if it cannot be read.
+  static std::string ReadBootId();
+
+ private:
+  std::string path_;
+  std::string boot_id_;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_NETWORKSTATECHECKPOINT_H
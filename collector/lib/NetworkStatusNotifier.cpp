@@ -109,8 +109,15 @@ void NetworkStatusNotifier::ReceiveIPNetworks(const sensor::IPNetworkList& netwo
 
 void NetworkStatusNotifier::Run() {
   Profiler::RegisterCPUThread();
+  ThreadPlacement::Apply("net-notifier", ThreadRole::NETWORK);
   auto next_attempt = std::chrono::system_clock::now();
 
+  // The initial procfs scrape does not depend on Sensor, so perform it while
+  // the stream is being established rather than after.
+  if (UpdateAllConnsAndEndpoints()) {
+    primed_scrape_micros_ = NowMicros();
+  }
+
   while (thread_.PauseUntil(next_attempt)) {
     comm_->ResetClientContext();
 
@@ -197,23 +204,72 @@ void NetworkStatusNotifier::ReportConnectionStats() {
   }
 }
 
+bool NetworkStatusNotifier::ConsumePrimedScrape() {
+  int64_t primed_scrape_micros = primed_scrape_micros_;
+  primed_scrape_micros_ = 0;
+
+  return primed_scrape_micros > 0 && NowMicros() - primed_scrape_micros < scrape_interval_ * 1000000LL;
+}
+
+void NetworkStatusNotifier::RestoreCheckpoint(ConnMap* old_conn_state, AdvertisedEndpointMap* old_cep_state, int64_t* time_at_last_scrape) {
+  if (!checkpoint_ || checkpoint_restore_done_) {
+    return;
+  }
+  checkpoint_restore_done_ = true;
+
+  if (checkpoint_->Read(NowMicros(), checkpoint_max_age_micros_, old_conn_state, old_cep_state, time_at_last_scrape)) {
+    CLOG(INFO) << "Restored network state checkpoint with " << old_conn_state->size() << " connections and "
+               << old_cep_state->size() << " endpoints";
+  }
+}
+
+void NetworkStatusNotifier::WriteCheckpoint(const ConnMap& old_conn_state, const AdvertisedEndpointMap& old_cep_state, int64_t time_at_last_scrape, bool force) {
+  if (!checkpoint_) {
+    return;
+  }
+
+  if (!force && --scrapes_until_checkpoint_ > 0) {
+    return;
+  }
+  scrapes_until_checkpoint_ = kCheckpointScrapes;
+
+  WITH_TIMER(CollectorStats::net_write_checkpoint) {
+    checkpoint_->Write(old_conn_state, old_cep_state, time_at_last_scrape);
+  }
+}
+
+CPUPacer NetworkStatusNotifier::MakePacer() const {
+  return CPUPacer(cpu_budget_, std::chrono::steady_clock::now() + std::chrono::milliseconds(std::chrono::seconds(scrape_interval_)) / 2);
+}
+
 bool NetworkStatusNotifier::UpdateAllConnsAndEndpoints() {
   if (turn_off_scraping_) {
     return true;
   }
 
+  bool update_listen_endpoints = true;
+  if (scrape_listen_endpoints_ && track_listen_endpoints_) {
+    update_listen_endpoints = scrapes_until_reconcile_ == 0;
+    scrapes_until_reconcile_ = update_listen_endpoints ? kListenEndpointsReconcileScrapes - 1 : scrapes_until_reconcile_ - 1;
+  }
+
   int64_t ts = NowMicros();
   std::vector<Connection> all_conns;
   std::vector<ContainerEndpoint> all_listen_endpoints;
   WITH_TIMER(CollectorStats::net_scrape_read) {
-    bool success = conn_scraper_->Scrape(&all_conns, scrape_listen_endpoints_ ? &all_listen_endpoints : nullptr);
+    bool scrape_listen_endpoints = scrape_listen_endpoints_ && update_listen_endpoints;
+    bool success = conn_scraper_->Scrape(&all_conns, scrape_listen_endpoints ? &all_listen_endpoints : nullptr);
     if (!success) {
       CLOG(ERROR) << "Failed to scrape connections and no pending connections to send";
       return false;
     }
   }
   WITH_TIMER(CollectorStats::net_scrape_update) {
-    conn_tracker_->Update(all_conns, all_listen_endpoints, ts);
+    if (update_listen_endpoints) {
+      conn_tracker_->Update(all_conns, all_listen_endpoints, ts);
+    } else {
+      conn_tracker_->Update(all_conns, ts);
+    }
   }
 
   return true;
@@ -224,33 +280,42 @@ void NetworkStatusNotifier::RunSingle(IDuplexClientWriter<sensor::NetworkConnect
 
   ConnMap old_conn_state;
   AdvertisedEndpointMap old_cep_state;
+  // The snapshots are fetched in the containers of the previous ones, to reuse their entries.
+  ConnMap new_conn_state;
+  AdvertisedEndpointMap new_cep_state;
   auto next_scrape = std::chrono::system_clock::now();
+  int64_t time_at_last_scrape = NowMicros();
+  RestoreCheckpoint(&old_conn_state, &old_cep_state, &time_at_last_scrape);
 
   while (writer->Sleep(next_scrape)) {
     next_scrape = std::chrono::system_clock::now() + std::chrono::seconds(scrape_interval_);
+    WriteCheckpoint(old_conn_state, old_cep_state, time_at_last_scrape, false);
 
-    if (!UpdateAllConnsAndEndpoints()) {
+    CPUPacer pacer = MakePacer();
+    if (!ConsumePrimedScrape() && !UpdateAllConnsAndEndpoints()) {
       continue;
     }
 
     ReportConnectionStats();
+    pacer.Pace();
 
     const sensor::NetworkConnectionInfoMessage* msg;
-    ConnMap new_conn_state;
-    AdvertisedEndpointMap new_cep_state;
     WITH_TIMER(CollectorStats::net_fetch_state) {
-      new_conn_state = conn_tracker_->FetchConnState(true, true);
+      conn_tracker_->FetchConnState(&new_conn_state, true, true);
       ConnectionTracker::ComputeDelta(new_conn_state, &old_conn_state);
 
-      new_cep_state = conn_tracker_->FetchEndpointState(true, true);
+      conn_tracker_->FetchEndpointState(&new_cep_state, true, true);
       ConnectionTracker::ComputeDelta(new_cep_state, &old_cep_state);
     }
 
+    pacer.Pace();
     WITH_TIMER(CollectorStats::net_create_message) {
       msg = CreateInfoMessage(old_conn_state, old_cep_state);
-      old_conn_state = std::move(new_conn_state);
-      old_cep_state = std::move(new_cep_state);
+      old_conn_state.swap(new_conn_state);
+      old_cep_state.swap(new_cep_state);
+      time_at_last_scrape = NowMicros();
     }
+    ReportStateMemory(old_conn_state, old_cep_state, new_conn_state, new_cep_state);
 
     if (!msg) {
       continue;
@@ -263,6 +328,8 @@ void NetworkStatusNotifier::RunSingle(IDuplexClientWriter<sensor::NetworkConnect
       }
     }
   }
+
+  WriteCheckpoint(old_conn_state, old_cep_state, time_at_last_scrape, true);
 }
 
 void NetworkStatusNotifier::RunSingleAfterglow(IDuplexClientWriter<sensor::NetworkConnectionInfoMessage>* writer) {
@@ -270,38 +337,46 @@ void NetworkStatusNotifier::RunSingleAfterglow(IDuplexClientWriter<sensor::Netwo
 
   ConnMap old_conn_state;
   AdvertisedEndpointMap old_cep_state;
+  // The snapshots are fetched in the containers of the previous ones, to reuse their entries.
+  ConnMap new_conn_state;
+  AdvertisedEndpointMap new_cep_state;
   auto next_scrape = std::chrono::system_clock::now();
   int64_t time_at_last_scrape = NowMicros();
+  RestoreCheckpoint(&old_conn_state, &old_cep_state, &time_at_last_scrape);
 
   while (writer->Sleep(next_scrape)) {
     next_scrape = std::chrono::system_clock::now() + std::chrono::seconds(scrape_interval_);
+    WriteCheckpoint(old_conn_state, old_cep_state, time_at_last_scrape, false);
 
-    if (!UpdateAllConnsAndEndpoints()) {
+    CPUPacer pacer = MakePacer();
+    if (!ConsumePrimedScrape() && !UpdateAllConnsAndEndpoints()) {
       continue;
     }
 
     ReportConnectionStats();
+    pacer.Pace();
 
     int64_t time_micros = NowMicros();
     const sensor::NetworkConnectionInfoMessage* msg;
-    AdvertisedEndpointMap new_cep_state;
-    ConnMap new_conn_state, delta_conn;
+    ConnMap delta_conn;
     WITH_TIMER(CollectorStats::net_fetch_state) {
-      new_conn_state = conn_tracker_->FetchConnState(true, true);
+      conn_tracker_->FetchConnState(&new_conn_state, true, true);
       ConnectionTracker::ComputeDeltaAfterglow(new_conn_state, old_conn_state, delta_conn, time_micros, time_at_last_scrape, afterglow_period_micros_);
 
-      new_cep_state = conn_tracker_->FetchEndpointState(true, true);
+      conn_tracker_->FetchEndpointState(&new_cep_state, true, true);
       ConnectionTracker::ComputeDelta(new_cep_state, &old_cep_state);
     }
 
+    pacer.Pace();
     WITH_TIMER(CollectorStats::net_create_message) {
       // Report the deltas
       msg = CreateInfoMessage(delta_conn, old_cep_state);
       // Add new connections to the old_state and remove inactive connections that are older than the afterglow period.
       ConnectionTracker::UpdateOldState(&old_conn_state, new_conn_state, time_micros, afterglow_period_micros_);
-      old_cep_state = std::move(new_cep_state);
+      old_cep_state.swap(new_cep_state);
       time_at_last_scrape = time_micros;
     }
+    ReportStateMemory(old_conn_state, old_cep_state, new_conn_state, new_cep_state);
 
     if (!msg) {
       continue;
@@ -314,6 +389,16 @@ void NetworkStatusNotifier::RunSingleAfterglow(IDuplexClientWriter<sensor::Netwo
       }
     }
   }
+
+  WriteCheckpoint(old_conn_state, old_cep_state, time_at_last_scrape, true);
+}
+
+void NetworkStatusNotifier::ReportStateMemory(const ConnMap& old_conn_state, const AdvertisedEndpointMap& old_cep_state,
+                                              const ConnMap& new_conn_state, const AdvertisedEndpointMap& new_cep_state) {
+  state_memory_.Set({old_conn_state.size() + old_cep_state.size() + new_conn_state.size() + new_cep_state.size(),
+                     ApproxHashContainerBytes(old_conn_state) + ApproxHashContainerBytes(old_cep_state) +
+                         ApproxHashContainerBytes(new_conn_state) + ApproxHashContainerBytes(new_cep_state)});
+  allocator_memory_.Set({0, ReservedBytes()});
 }
 
 sensor::NetworkConnectionInfoMessage* NetworkStatusNotifier::CreateInfoMessage(const ConnMap& conn_delta, const AdvertisedEndpointMap& endpoint_delta) {
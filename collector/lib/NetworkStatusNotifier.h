@@ -3,10 +3,13 @@
 
 #include <memory>
 
+#include "CPUBudget.h"
 #include "CollectorConfig.h"
 #include "CollectorStats.h"
 #include "ConnTracker.h"
+#include "MemoryAccounting.h"
 #include "NetworkConnectionInfoServiceComm.h"
+#include "NetworkStateCheckpoint.h"
 #include "ProcfsScraper.h"
 #include "ProtoAllocator.h"
 #include "StoppableThread.h"
@@ -20,17 +23,24 @@ class NetworkStatusNotifier : protected ProtoAllocator<sensor::NetworkConnection
                         std::shared_ptr<INetworkConnectionInfoServiceComm> comm,
                         const CollectorConfig& config,
                         std::shared_ptr<CollectorConnectionStats<unsigned int>> connections_total_reporter = 0,
-                        std::shared_ptr<CollectorConnectionStats<float>> connections_rate_reporter = 0)
+                        std::shared_ptr<CollectorConnectionStats<float>> connections_rate_reporter = 0,
+                        const CPUBudget* cpu_budget = nullptr)
       : conn_scraper_(conn_scraper),
         scrape_interval_(config.ScrapeInterval()),
         turn_off_scraping_(config.TurnOffScrape()),
         scrape_listen_endpoints_(config.ScrapeListenEndpoints()),
+        track_listen_endpoints_(config.TrackListenEndpoints()),
         conn_tracker_(std::move(conn_tracker)),
         afterglow_period_micros_(config.AfterglowPeriod()),
         enable_afterglow_(config.EnableAfterglow()),
         comm_(comm),
         connections_total_reporter_(connections_total_reporter),
-        connections_rate_reporter_(connections_rate_reporter) {
+        connections_rate_reporter_(connections_rate_reporter),
+        cpu_budget_(cpu_budget) {
+    if (!config.NetworkCheckpointPath().empty()) {
+      checkpoint_ = std::make_unique<NetworkStateCheckpoint>(config.NetworkCheckpointPath());
+      checkpoint_max_age_micros_ = config.NetworkCheckpointMaxAge();
+    }
   }
 
   void Start();
@@ -51,8 +61,20 @@ class NetworkStatusNotifier : protected ProtoAllocator<sensor::NetworkConnection
   void Run();
   void WaitUntilWriterStarted(IDuplexClientWriter<sensor::NetworkConnectionInfoMessage>* writer, int wait_time);
   bool UpdateAllConnsAndEndpoints();
+  // Returns true if a scrape performed before the stream was established is
+  // recent enough to be used in place of a new one. Only ever returns true once.
+  bool ConsumePrimedScrape();
   void RunSingle(IDuplexClientWriter<sensor::NetworkConnectionInfoMessage>* writer);
   void RunSingleAfterglow(IDuplexClientWriter<sensor::NetworkConnectionInfoMessage>* writer);
+  // Restores the state reported before the last restart, if a usable checkpoint exists. Only done for the first stream
+  // after startup, as the checkpoint is written by the previous collector instance.
+  void RestoreCheckpoint(ConnMap* old_conn_state, AdvertisedEndpointMap* old_cep_state, int64_t* time_at_last_scrape);
+  // Writes the reported state to the checkpoint every kCheckpointScrapes scrapes, or right away if force is set.
+  void WriteCheckpoint(const ConnMap& old_conn_state, const AdvertisedEndpointMap& old_cep_state, int64_t time_at_last_scrape, bool force);
+  // Reports the memory used by the state kept between scrapes, including the containers kept to fetch the next
+  // snapshot in, and by the message allocator.
+  void ReportStateMemory(const ConnMap& old_conn_state, const AdvertisedEndpointMap& old_cep_state,
+                         const ConnMap& new_conn_state, const AdvertisedEndpointMap& new_cep_state);
   void ReceivePublicIPs(const sensor::IPAddressList& public_ips);
   void ReceiveIPNetworks(const sensor::IPNetworkList& networks);
 
@@ -62,7 +84,19 @@ class NetworkStatusNotifier : protected ProtoAllocator<sensor::NetworkConnection
   int scrape_interval_;
   bool turn_off_scraping_;
   bool scrape_listen_endpoints_;
+  // Listen endpoints are maintained from kernel events, and only scraped
+  // every kListenEndpointsReconcileScrapes scrapes to reconcile the state.
+  static constexpr int kListenEndpointsReconcileScrapes = 10;
+  bool track_listen_endpoints_;
+  int scrapes_until_reconcile_ = 0;
   std::shared_ptr<ConnectionTracker> conn_tracker_;
+  int64_t primed_scrape_micros_ = 0;
+
+  static constexpr int kCheckpointScrapes = 4;
+  std::unique_ptr<NetworkStateCheckpoint> checkpoint_;
+  int64_t checkpoint_max_age_micros_ = 0;
+  bool checkpoint_restore_done_ = false;
+  int scrapes_until_checkpoint_ = kCheckpointScrapes;
 
   int64_t afterglow_period_micros_;
   bool enable_afterglow_;
@@ -73,6 +107,14 @@ class NetworkStatusNotifier : protected ProtoAllocator<sensor::NetworkConnection
   std::chrono::steady_clock::time_point connections_last_report_time_;     // time delta between the current reporting and the previous (rate computation)
   std::optional<ConnectionTracker::Stats> connections_rate_counter_last_;  // previous counter values (rate computation)
   void ReportConnectionStats();
+
+  // While collector is throttled, the work of a scrape is spread over the
+  // first half of the scrape interval.
+  const CPUBudget* cpu_budget_;
+  CPUPacer MakePacer() const;
+
+  MemoryGauge state_memory_{"network_notifier_state"};
+  MemoryGauge allocator_memory_{"network_notifier_allocator"};
 };
 
 }  // namespace collector
@@ -10,19 +10,31 @@ namespace collector {
 const std::string Process::NOT_AVAILABLE("N/A");
 
 ProcessStore::ProcessStore(SysdigService* falco_instance) : falco_instance_(falco_instance) {
-  cache_ = std::make_shared<std::unordered_map<uint64_t, std::weak_ptr<Process>>>();
+  cache_ = std::make_shared<Cache>();
+  // Processes are counted along with the cache, although they are owned by their users.
+  memory_registration_ = MemoryAccounting::GetOrCreate().Register("process_store", [cache = cache_] {
+    std::lock_guard<std::mutex> lock(cache->mutex);
+    MemoryUsage usage;
+    usage.entries = cache->processes.size();
+    usage.bytes = ApproxHashContainerBytes(cache->processes) + usage.entries * sizeof(Process);
+    return usage;
+  });
 }
 
 const std::shared_ptr<IProcess> ProcessStore::Fetch(uint64_t pid) {
-  auto cached_process_pair_iter = cache_->find(pid);
+  std::lock_guard<std::mutex> lock(cache_->mutex);
 
-  if (cached_process_pair_iter != cache_->end()) {
-    return cached_process_pair_iter->second.lock();
+  auto cached_process_pair_iter = cache_->processes.find(pid);
+
+  if (cached_process_pair_iter != cache_->processes.end()) {
+    if (auto cached_process = cached_process_pair_iter->second.lock()) {
+      return cached_process;
+    }
   }
 
   std::shared_ptr<Process> cached_process = std::make_shared<Process>(pid, cache_, falco_instance_);
 
-  cache_->emplace(pid, cached_process);
+  cache_->processes[pid] = cached_process;
   return cached_process;
 }
 
@@ -103,7 +115,12 @@ Process::Process(
 
 Process::~Process() {
   if (cache_) {
-    cache_->erase(pid_);
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    auto it = cache_->processes.find(pid_);
+    // The entry may already have been replaced by a new Process for the same pid.
+    if (it != cache_->processes.end() && it->second.expired()) {
+      cache_->processes.erase(it);
+    }
   }
 }
 
@@ -9,6 +9,8 @@
 #include <string>
 #include <unordered_map>
 
+#include "MemoryAccounting.h"
+
 // forward declarations
 class sinsp_threadinfo;
 namespace collector {
@@ -31,11 +33,18 @@ class ProcessStore {
      if it wasn't already known. */
   const std::shared_ptr<IProcess> Fetch(uint64_t pid);
 
-  typedef std::shared_ptr<std::unordered_map<uint64_t, std::weak_ptr<Process>>> MapRef;
+  // Fetch may be called from several threads (the network status notifier and the event loop), and processes remove
+  // themselves from the cache when destroyed, so the cache comes with its own lock.
+  struct Cache {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::weak_ptr<Process>> processes;
+  };
+  typedef std::shared_ptr<Cache> MapRef;
 
  private:
   SysdigService* falco_instance_;
   MapRef cache_;
+  MemoryAccounting::Registration memory_registration_;
 };
 
 class IProcess {
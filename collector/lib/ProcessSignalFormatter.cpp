@@ -35,50 +35,95 @@ static EventMap<ProcessSignalType> process_signals = {
     ProcessSignalType::UNKNOWN_PROCESS_TYPE,
 };
 
-std::string extract_proc_args(sinsp_threadinfo* tinfo) {
-  if (tinfo->m_args.empty()) return "";
-  std::ostringstream args;
+// Joins the arguments of a process into args, reusing its storage.
+void extract_proc_args(sinsp_threadinfo* tinfo, std::string* args) {
+  args->clear();
   for (auto it = tinfo->m_args.begin(); it != tinfo->m_args.end();) {
-    args << *it++;
-    if (it != tinfo->m_args.end()) args << " ";
+    args->append(*it++);
+    if (it != tinfo->m_args.end()) args->push_back(' ');
   }
-  return args.str();
+}
+
+std::string extract_proc_args(sinsp_threadinfo* tinfo) {
+  std::string args;
+  extract_proc_args(tinfo, &args);
+  return args;
+}
+
+// Same as TimeUtil::NanosecondsToTimestamp, but sets an existing timestamp.
+void SetTimestamp(uint64_t nanos, Timestamp* timestamp) {
+  timestamp->set_seconds(nanos / 1000000000);
+  timestamp->set_nanos(nanos % 1000000000);
+}
+
+LineageInfo* AddLineage(std::vector<LineageInfo>* lineage) {
+  return &lineage->emplace_back();
+}
+
+LineageInfo* AddLineage(google::protobuf::RepeatedPtrField<LineageInfo>* lineage) {
+  return lineage->Add();
+}
+
+bool IsAvailable(const std::string* value) {
+  return value && !value->empty() && *value != "<NA>";
+}
+
+// Returns the name and the exec file path of a process, each one falling back
+// on the other one when missing.
+std::pair<const std::string*, const std::string*> ResolveNameAndExePath(const std::string* name, const std::string* exepath) {
+  const std::string* resolved_name = IsAvailable(name) ? name : (IsAvailable(exepath) ? exepath : nullptr);
+  const std::string* resolved_exepath = IsAvailable(exepath) ? exepath : (IsAvailable(name) ? name : nullptr);
+  return {resolved_name, resolved_exepath};
 }
 
 }  // namespace
 
+std::string compute_process_key(std::string_view container_id, std::string_view name, std::string_view args, std::string_view exec_file_path) {
+  args = args.substr(0, kProcessKeyMaxArgsLength);
+
+  std::string key;
+  key.reserve(container_id.size() + name.size() + args.size() + exec_file_path.size() + 3);
+  key.append(container_id).append(" ").append(name).append(" ").append(args).append(" ").append(exec_file_path);
+  return key;
+}
+
+std::string compute_process_key(const storage::ProcessSignal& s) {
+  return compute_process_key(s.container_id(), s.name(), s.args(), s.exec_file_path());
+}
+
 const SignalStreamMessage* ProcessSignalFormatter::ToProtoMessage(sinsp_evt* event) {
   if (process_signals[event->get_type()] == ProcessSignalType::UNKNOWN_PROCESS_TYPE) {
     return nullptr;
   }
 
-  Reset();
-
   if (!ValidateProcessDetails(event)) {
     CLOG(INFO) << "Dropping process event: " << ProcessDetails(event);
     return nullptr;
   }
 
-  ProcessSignal* process_signal = CreateProcessSignal(event);
-  if (!process_signal) return nullptr;
-
-  Signal* signal = Allocate<Signal>();
-  signal->set_allocated_process_signal(process_signal);
+  return ToProtoMessageUnchecked(event);
+}
 
-  SignalStreamMessage* signal_stream_message = AllocateRoot();
-  signal_stream_message->clear_collector_register_request();
-  signal_stream_message->set_allocated_signal(signal);
-  return signal_stream_message;
+const SignalStreamMessage* ProcessSignalFormatter::ToProtoMessageUnchecked(sinsp_evt* event) {
+  FormatProcessSignal(event, process_msg_.mutable_signal()->mutable_process_signal());
+  return &process_msg_;
 }
 
 const SignalStreamMessage* ProcessSignalFormatter::ToProtoMessage(sinsp_threadinfo* tinfo) {
-  Reset();
   if (!ValidateProcessDetails(tinfo)) {
     CLOG(INFO) << "Dropping process event: " << tinfo;
     return nullptr;
   }
 
-  ProcessSignal* process_signal = CreateProcessSignal(tinfo);
+  FormatProcessSignal(tinfo, process_msg_.mutable_signal()->mutable_process_signal());
+  return &process_msg_;
+}
+
+const SignalStreamMessage* ProcessSignalFormatter::ToProtoMessage(const ProcessSnapshot& snapshot) {
+  Reset();
+  allocator_memory_.Set({0, ReservedBytes()});
+
+  ProcessSignal* process_signal = CreateProcessSignal(snapshot);
   if (!process_signal) return nullptr;
 
   Signal* signal = Allocate<Signal>();
@@ -90,94 +135,147 @@ const SignalStreamMessage* ProcessSignalFormatter::ToProtoMessage(sinsp_threadin
   return signal_stream_message;
 }
 
-ProcessSignal* ProcessSignalFormatter::CreateProcessSignal(sinsp_evt* event) {
-  auto signal = Allocate<ProcessSignal>();
+bool ProcessSignalFormatter::GetProcessKey(sinsp_evt* event, std::string* key) {
+  if (process_signals[event->get_type()] == ProcessSignalType::UNKNOWN_PROCESS_TYPE) {
+    return false;
+  }
 
-  // set id
-  signal->set_id(UUIDStr());
+  if (!ValidateProcessDetails(event)) {
+    CLOG(INFO) << "Dropping process event: " << ProcessDetails(event);
+    return false;
+  }
 
-  const std::string* name = event_extractor_.get_comm(event);
-  const std::string* exepath = event_extractor_.get_exepath(event);
+  auto [name, exepath] = ResolveNameAndExePath(event_extractor_.get_comm(event), event_extractor_.get_exepath(event));
+  const std::string* container_id = event_extractor_.get_container_id(event);
+  const char* args = event_extractor_.get_proc_args(event);
+
+  *key = compute_process_key(container_id ? std::string_view(*container_id) : std::string_view(),
+                             name ? std::string_view(*name) : std::string_view(),
+                             args ? std::string_view(args) : std::string_view(),
+                             exepath ? std::string_view(*exepath) : std::string_view());
+  return true;
+}
+
+bool ProcessSignalFormatter::GetProcessSnapshot(sinsp_threadinfo* tinfo, ProcessSnapshot* snapshot) {
+  if (!ValidateProcessDetails(tinfo)) {
+    CLOG(INFO) << "Dropping process event: " << tinfo;
+    return false;
+  }
+
+  const auto& name = tinfo->m_comm;
+  const auto& exepath = tinfo->m_exepath;
 
   // set name (if name is missing or empty, try to use exec_file_path)
-  if (name && !name->empty() && *name != "<NA>") {
-    signal->set_name(*name);
-  } else if (exepath && !exepath->empty() && *exepath != "<NA>") {
-    signal->set_name(*exepath);
+  if (!name.empty() && name != "<NA>") {
+    snapshot->name = name;
+  } else if (!exepath.empty() && exepath != "<NA>") {
+    snapshot->name = exepath;
   }
 
   // set exec_file_path (if exec_file_path is missing or empty, try to use name)
-  if (exepath && !exepath->empty() && *exepath != "<NA>") {
+  if (!exepath.empty() && exepath != "<NA>") {
+    snapshot->exec_file_path = exepath;
+  } else if (!name.empty() && name != "<NA>") {
+    snapshot->exec_file_path = name;
+  }
+
+  snapshot->args = extract_proc_args(tinfo);
+  snapshot->pid = tinfo->m_pid;
+  snapshot->uid = tinfo->m_user.uid;
+  snapshot->gid = tinfo->m_group.gid;
+  snapshot->clone_ts = tinfo->m_clone_ts;
+  snapshot->container_id = tinfo->m_container_id;
+
+  // the lineage walks the thread table, so it must be collected now
+  GetProcessLineage(tinfo, snapshot->lineage);
+
+  return true;
+}
+
+void ProcessSignalFormatter::FormatProcessSignal(sinsp_evt* event, ProcessSignal* signal) {
+  // Every field is either set or cleared, as the signal is reused from one
+  // event to the next. Clearing keeps the storage of the strings.
+
+  // set id
+  signal->set_id(UUIDStr());
+
+  // set name and exec_file_path (if one is missing or empty, try to use the other)
+  auto [name, exepath] = ResolveNameAndExePath(event_extractor_.get_comm(event), event_extractor_.get_exepath(event));
+  if (name) {
+    signal->set_name(*name);
+  } else {
+    signal->clear_name();
+  }
+  if (exepath) {
     signal->set_exec_file_path(*exepath);
-  } else if (name && !name->empty() && *name != "<NA>") {
-    signal->set_exec_file_path(*name);
+  } else {
+    signal->clear_exec_file_path();
   }
 
+  // the message is shared with the thread info path, which sets this
+  signal->set_scraped(false);
+
   // set process arguments
-  if (const char* args = event_extractor_.get_proc_args(event)) signal->set_args(args);
+  if (const char* args = event_extractor_.get_proc_args(event)) {
+    signal->set_args(args);
+  } else {
+    signal->clear_args();
+  }
 
   // set pid
-  if (const int64_t* pid = event_extractor_.get_pid(event)) signal->set_pid(*pid);
+  const int64_t* pid = event_extractor_.get_pid(event);
+  signal->set_pid(pid ? *pid : 0);
 
   // set user and group id credentials
-  if (const uint32_t* uid = event_extractor_.get_uid(event)) signal->set_uid(*uid);
-  if (const uint32_t* gid = event_extractor_.get_gid(event)) signal->set_gid(*gid);
+  const uint32_t* uid = event_extractor_.get_uid(event);
+  signal->set_uid(uid ? *uid : 0);
+  const uint32_t* gid = event_extractor_.get_gid(event);
+  signal->set_gid(gid ? *gid : 0);
 
   // set time
-  auto timestamp = Allocate<Timestamp>();
-  *timestamp = TimeUtil::NanosecondsToTimestamp(event->get_ts());
-  signal->set_allocated_time(timestamp);
+  SetTimestamp(event->get_ts(), signal->mutable_time());
 
   // set container_id
   if (const std::string* container_id = event_extractor_.get_container_id(event)) {
     signal->set_container_id(*container_id);
+  } else {
+    signal->clear_container_id();
   }
 
   // set process lineage
-  std::vector<LineageInfo> lineage;
-  this->GetProcessLineage(event->get_thread_info(), lineage);
-  for (const auto& p : lineage) {
-    auto signal_lineage = signal->add_lineage_info();
-    signal_lineage->set_parent_exec_file_path(p.parent_exec_file_path());
-    signal_lineage->set_parent_uid(p.parent_uid());
-  }
+  GetProcessLineage(event->get_thread_info(), signal->mutable_lineage_info());
 
   CLOG(DEBUG) << "Process (" << signal->container_id() << ": " << signal->pid() << "): "
               << signal->name()
               << " (" << signal->exec_file_path() << ")"
               << " " << signal->args();
-
-  return signal;
 }
 
-ProcessSignal* ProcessSignalFormatter::CreateProcessSignal(sinsp_threadinfo* tinfo) {
-  auto signal = Allocate<ProcessSignal>();
+void ProcessSignalFormatter::FormatProcessSignal(sinsp_threadinfo* tinfo, ProcessSignal* signal) {
+  // Every field is either set or cleared, as the signal is reused from one
+  // process to the next. Clearing keeps the storage of the strings.
 
   // set id
   signal->set_id(UUIDStr());
 
-  const auto& name = tinfo->m_comm;
-  const auto& exepath = tinfo->m_exepath;
-
-  // set name (if name is missing or empty, try to use exec_file_path)
-  if (!name.empty() && name != "<NA>") {
-    signal->set_name(name);
-  } else if (!exepath.empty() && exepath != "<NA>") {
-    signal->set_name(exepath);
+  // set name and exec_file_path (if one is missing or empty, try to use the other)
+  auto [name, exepath] = ResolveNameAndExePath(&tinfo->m_comm, &tinfo->m_exepath);
+  if (name) {
+    signal->set_name(*name);
+  } else {
+    signal->clear_name();
   }
-
-  // set exec_file_path (if exec_file_path is missing or empty, try to use name)
-  if (!exepath.empty() && exepath != "<NA>") {
-    signal->set_exec_file_path(exepath);
-  } else if (!name.empty() && name != "<NA>") {
-    signal->set_exec_file_path(name);
+  if (exepath) {
+    signal->set_exec_file_path(*exepath);
+  } else {
+    signal->clear_exec_file_path();
   }
 
   // set the process as coming from a scrape as opposed to an exec
   signal->set_scraped(true);
 
   // set process arguments
-  signal->set_args(extract_proc_args(tinfo));
+  extract_proc_args(tinfo, signal->mutable_args());
 
   // set pid
   signal->set_pid(tinfo->m_pid);
@@ -187,18 +285,47 @@ ProcessSignal* ProcessSignalFormatter::CreateProcessSignal(sinsp_threadinfo* tin
   signal->set_gid(tinfo->m_group.gid);
 
   // set time
-  auto timestamp = Allocate<Timestamp>();
-  *timestamp = TimeUtil::NanosecondsToTimestamp(tinfo->m_clone_ts);
-  signal->set_allocated_time(timestamp);
+  SetTimestamp(tinfo->m_clone_ts, signal->mutable_time());
 
   // set container_id
   signal->set_container_id(tinfo->m_container_id);
 
   // set process lineage
-  std::vector<LineageInfo> lineage;
-  GetProcessLineage(tinfo, lineage);
+  GetProcessLineage(tinfo, signal->mutable_lineage_info());
+}
+
+ProcessSignal* ProcessSignalFormatter::CreateProcessSignal(const ProcessSnapshot& snapshot) {
+  auto signal = Allocate<ProcessSignal>();
+
+  // set id
+  signal->set_id(UUIDStr());
+
+  signal->set_name(snapshot.name);
+  signal->set_exec_file_path(snapshot.exec_file_path);
+
+  // set the process as coming from a scrape as opposed to an exec
+  signal->set_scraped(true);
+
+  // set process arguments
+  signal->set_args(snapshot.args);
+
+  // set pid
+  signal->set_pid(snapshot.pid);
+
+  // set user and group id credentials
+  signal->set_uid(snapshot.uid);
+  signal->set_gid(snapshot.gid);
+
+  // set time
+  auto timestamp = Allocate<Timestamp>();
+  *timestamp = TimeUtil::NanosecondsToTimestamp(snapshot.clone_ts);
+  signal->set_allocated_time(timestamp);
 
-  for (const auto& p : lineage) {
+  // set container_id
+  signal->set_container_id(snapshot.container_id);
+
+  // set process lineage
+  for (const auto& p : snapshot.lineage) {
     auto signal_lineage = signal->add_lineage_info();
     signal_lineage->set_parent_exec_file_path(p.parent_exec_file_path());
     signal_lineage->set_parent_uid(p.parent_uid());
@@ -247,14 +374,16 @@ bool ProcessSignalFormatter::ValidateProcessDetails(sinsp_evt* event) {
   return ValidateProcessDetails(tinfo);
 }
 
-int ProcessSignalFormatter::GetTotalStringLength(const std::vector<LineageInfo>& lineage) {
+template <typename Lineage>
+int ProcessSignalFormatter::GetTotalStringLength(const Lineage& lineage) {
   int totalStringLength = 0;
-  for (LineageInfo l : lineage) totalStringLength += l.parent_exec_file_path().size();
+  for (const auto& l : lineage) totalStringLength += l.parent_exec_file_path().size();
 
   return totalStringLength;
 }
 
-void ProcessSignalFormatter::CountLineage(const std::vector<LineageInfo>& lineage) {
+template <typename Lineage>
+void ProcessSignalFormatter::CountLineage(const Lineage& lineage) {
   int totalStringLength = GetTotalStringLength(lineage);
   COUNTER_INC(CollectorStats::process_lineage_counts);
   COUNTER_ADD(CollectorStats::process_lineage_total, lineage.size());
@@ -264,6 +393,18 @@ void ProcessSignalFormatter::CountLineage(const std::vector<LineageInfo>& lineag
 
 void ProcessSignalFormatter::GetProcessLineage(sinsp_threadinfo* tinfo,
                                                std::vector<LineageInfo>& lineage) {
+  CollectProcessLineage(tinfo, &lineage);
+}
+
+void ProcessSignalFormatter::GetProcessLineage(sinsp_threadinfo* tinfo,
+                                               google::protobuf::RepeatedPtrField<LineageInfo>* lineage) {
+  // Cleared elements are kept by the repeated field, and reused when added again.
+  lineage->Clear();
+  CollectProcessLineage(tinfo, lineage);
+}
+
+template <typename Lineage>
+void ProcessSignalFormatter::CollectProcessLineage(sinsp_threadinfo* tinfo, Lineage* lineage) {
   if (tinfo == NULL) return;
   sinsp_threadinfo* mt = NULL;
   if (tinfo->is_main_thread()) {
@@ -272,7 +413,7 @@ void ProcessSignalFormatter::GetProcessLineage(sinsp_threadinfo* tinfo,
     mt = tinfo->get_main_thread();
     if (mt == NULL) return;
   }
-  sinsp_threadinfo::visitor_func_t visitor = [this, &lineage](sinsp_threadinfo* pt) {
+  sinsp_threadinfo::visitor_func_t visitor = [lineage](sinsp_threadinfo* pt) {
     if (pt == NULL) return false;
     if (pt->m_pid == 0) return false;
 
@@ -298,20 +439,19 @@ void ProcessSignalFormatter::GetProcessLineage(sinsp_threadinfo* tinfo,
     if (pt->m_vpid == -1) return false;
 
     // Collapse parent child processes that have the same path
-    if (lineage.empty() || (lineage.back().parent_exec_file_path() != pt->m_exepath)) {
-      LineageInfo info;
-      info.set_parent_uid(pt->m_user.uid);
-      info.set_parent_exec_file_path(pt->m_exepath);
-      lineage.push_back(info);
+    if (lineage->empty() || ((*lineage)[lineage->size() - 1].parent_exec_file_path() != pt->m_exepath)) {
+      LineageInfo* info = AddLineage(lineage);
+      info->set_parent_uid(pt->m_user.uid);
+      info->set_parent_exec_file_path(pt->m_exepath);
     }
 
     // Limit max number of ancestors
-    if (lineage.size() >= 10) return false;
+    if (lineage->size() >= 10) return false;
 
     return true;
   };
   mt->traverse_parent_state(visitor);
-  CountLineage(lineage);
+  CountLineage(*lineage);
 }
 
 }  // namespace collector
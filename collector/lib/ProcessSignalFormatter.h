@@ -1,17 +1,26 @@
 #ifndef _PROCESS_SIGNAL_FORMATTER_H_
 #define _PROCESS_SIGNAL_FORMATTER_H_
 
+#include <string_view>
+
 #include "api/v1/signal.pb.h"
 #include "internalapi/sensor/signal_iservice.pb.h"
 #include "storage/process_indicator.pb.h"
 
 #include "CollectorStats.h"
 #include "EventNames.h"
+#include "MemoryAccounting.h"
 #include "ProtoSignalFormatter.h"
 #include "SysdigEventExtractor.h"
 
 namespace collector {
 
+// Computes the key identifying a process for rate limiting. Only the first
+// kProcessKeyMaxArgsLength characters of the arguments are taken into account.
+constexpr size_t kProcessKeyMaxArgsLength = 256;
+std::string compute_process_key(std::string_view container_id, std::string_view name, std::string_view args, std::string_view exec_file_path);
+std::string compute_process_key(const storage::ProcessSignal& s);
+
 class ProcessSignalFormatter : public ProtoSignalFormatter<sensor::SignalStreamMessage> {
  public:
   ProcessSignalFormatter(sinsp* inspector) : event_names_(EventNames::GetInstance()) {
@@ -22,25 +31,60 @@ class ProcessSignalFormatter : public ProtoSignalFormatter<sensor::SignalStreamM
   using ProcessSignal = storage::ProcessSignal;
   using LineageInfo = storage::ProcessSignal_LineageInfo;
 
+  // Copy of the thread-info fields needed to build a process signal. Taking a
+  // snapshot is cheap, and allows the formatting to happen without holding
+  // the inspector lock.
+  struct ProcessSnapshot {
+    std::string name;
+    std::string exec_file_path;
+    std::string args;
+    int64_t pid = 0;
+    uint32_t uid = 0;
+    uint32_t gid = 0;
+    uint64_t clone_ts = 0;
+    std::string container_id;
+    std::vector<LineageInfo> lineage;
+  };
+
+  // Messages built from an event or a thread info are formatted into a
+  // message owned by the formatter, which is reused from one call to the
+  // next, so that no memory is allocated once its strings are large enough.
   const sensor::SignalStreamMessage* ToProtoMessage(sinsp_evt* event) override;
   const sensor::SignalStreamMessage* ToProtoMessage(sinsp_threadinfo* tinfo);
+  const sensor::SignalStreamMessage* ToProtoMessage(const ProcessSnapshot& snapshot);
+
+  // Computes the rate limiting key of the process signal an event would be
+  // formatted into, directly from the event fields, so that rate limited
+  // events can be dropped before paying for the formatting and the lineage.
+  // Returns false if the event would not be formatted.
+  bool GetProcessKey(sinsp_evt* event, std::string* key);
+  // Same as ToProtoMessage, for an event GetProcessKey returned true for,
+  // which is not validated again.
+  const sensor::SignalStreamMessage* ToProtoMessageUnchecked(sinsp_evt* event);
 
+  bool GetProcessSnapshot(sinsp_threadinfo* tinfo, ProcessSnapshot* snapshot);
   void GetProcessLineage(sinsp_threadinfo* tinfo, std::vector<LineageInfo>& lineage);
+  void GetProcessLineage(sinsp_threadinfo* tinfo, google::protobuf::RepeatedPtrField<LineageInfo>* lineage);
 
  private:
-  Signal* CreateSignal(sinsp_evt* event);
-  ProcessSignal* CreateProcessSignal(sinsp_evt* event);
+  void FormatProcessSignal(sinsp_evt* event, ProcessSignal* signal);
+  void FormatProcessSignal(sinsp_threadinfo* tinfo, ProcessSignal* signal);
   bool ValidateProcessDetails(const sinsp_threadinfo* tinfo);
   bool ValidateProcessDetails(sinsp_evt* event);
   std::string ProcessDetails(sinsp_evt* event);
 
-  Signal* CreateSignal(sinsp_threadinfo* tinfo);
-  ProcessSignal* CreateProcessSignal(sinsp_threadinfo* tinfo);
-  int GetTotalStringLength(const std::vector<LineageInfo>& lineage);
-  void CountLineage(const std::vector<LineageInfo>& lineage);
+  ProcessSignal* CreateProcessSignal(const ProcessSnapshot& snapshot);
+  template <typename Lineage>
+  void CollectProcessLineage(sinsp_threadinfo* tinfo, Lineage* lineage);
+  template <typename Lineage>
+  int GetTotalStringLength(const Lineage& lineage);
+  template <typename Lineage>
+  void CountLineage(const Lineage& lineage);
 
   const EventNames& event_names_;
   SysdigEventExtractor event_extractor_;
+  sensor::SignalStreamMessage process_msg_;
+  MemoryGauge allocator_memory_{"process_signal_allocator"};
 };
 
 }  // namespace collector
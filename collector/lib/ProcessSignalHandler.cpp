@@ -1,71 +1,115 @@
 #include "ProcessSignalHandler.h"
 
-#include <sstream>
-
 #include "storage/process_indicator.pb.h"
 
+#include "CollectorStats.h"
 #include "RateLimit.h"
+#include "ThreadPlacement.h"
 
 namespace collector {
 
-std::string compute_process_key(const ::storage::ProcessSignal& s) {
-  std::stringstream ss;
-  ss << s.container_id() << " " << s.name() << " ";
-  if (s.args().length() <= 256) {
-    ss << s.args();
-  } else {
-    ss.write(s.args().c_str(), 256);
-  }
-  ss << " " << s.exec_file_path();
-  return ss.str();
-}
-
 bool ProcessSignalHandler::Start() {
   client_->Start();
+  {
+    std::lock_guard<std::mutex> lock(existing_processes_mutex_);
+    sending_existing_processes_ = true;
+  }
+  existing_processes_thread_.Start([this] { SendExistingProcesses(); });
   return true;
 }
 
 bool ProcessSignalHandler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(existing_processes_mutex_);
+    sending_existing_processes_ = false;
+  }
+  existing_processes_cond_.notify_one();
+  existing_processes_space_cond_.notify_all();
+  if (existing_processes_thread_.running()) {
+    existing_processes_thread_.Stop();
+  }
   client_->Stop();
   rate_limiter_.ResetRateLimitCache();
   return true;
 }
 
 SignalHandler::Result ProcessSignalHandler::HandleSignal(sinsp_evt* evt) {
-  const auto* signal_msg = formatter_.ToProtoMessage(evt);
-  if (!signal_msg) {
+  if (needs_refresh_.exchange(false)) {
+    return NEEDS_REFRESH;
+  }
+
+  // Invalid events are dropped before being charged to the rate limiter.
+  std::string key;
+  if (!formatter_.GetProcessKey(evt, &key)) {
     ++(stats_->nProcessResolutionFailuresByEvt);
     return IGNORED;
   }
 
-  if (!rate_limiter_.Allow(compute_process_key(signal_msg->signal().process_signal()))) {
-    ++(stats_->nProcessRateLimitCount);
+  // Check the rate limit before formatting, which is comparatively expensive
+  // (lineage walk, arguments), so that it is skipped for throttled events.
+  if (!AllowProcess(key)) {
     return IGNORED;
   }
 
-  auto result = client_->PushSignals(*signal_msg);
-  if (result == SignalHandler::PROCESSED) {
-    ++(stats_->nProcessSent);
-  } else if (result == SignalHandler::ERROR) {
-    ++(stats_->nProcessSendFailures);
+  const auto* signal_msg = formatter_.ToProtoMessageUnchecked(evt);
+
+  auto result = PushSignal(*signal_msg);
+  if (result == NEEDS_REFRESH) {
+    // A new snapshot is about to be taken, the pending one is outdated.
+    std::lock_guard<std::mutex> lock(existing_processes_mutex_);
+    existing_processes_.clear();
   }
 
   return result;
 }
 
 SignalHandler::Result ProcessSignalHandler::HandleExistingProcess(sinsp_threadinfo* tinfo) {
-  const auto* signal_msg = formatter_.ToProtoMessage(tinfo);
-  if (!signal_msg) {
+  ProcessSnapshot snapshot;
+  if (!formatter_.GetProcessSnapshot(tinfo, &snapshot)) {
     ++(stats_->nProcessResolutionFailuresByTinfo);
     return IGNORED;
   }
 
-  if (!rate_limiter_.Allow(compute_process_key(signal_msg->signal().process_signal()))) {
+  std::unique_lock<std::mutex> lock(existing_processes_mutex_);
+  if (sending_existing_processes_ && existing_processes_.size() >= kMaxPendingExistingProcesses) {
+    // The event loop waits rather than dropping the process, which would
+    // never be sent otherwise.
+    COUNTER_INC(CollectorStats::process_existing_waits);
+    existing_processes_space_cond_.wait(lock, [this] {
+      return !sending_existing_processes_ || existing_processes_.size() < kMaxPendingExistingProcesses;
+    });
+  }
+
+  existing_processes_.push_back(std::move(snapshot));
+  if (existing_processes_.size() == 1) {
+    existing_processes_cond_.notify_one();
+  }
+
+  return PROCESSED;
+}
+
+bool ProcessSignalHandler::AllowProcess(const std::string& key) {
+  std::lock_guard<std::mutex> lock(send_mutex_);
+
+  if (!rate_limiter_.Allow(key)) {
     ++(stats_->nProcessRateLimitCount);
+    return false;
+  }
+  return true;
+}
+
+SignalHandler::Result ProcessSignalHandler::SendSignal(const sensor::SignalStreamMessage& signal_msg) {
+  if (!AllowProcess(compute_process_key(signal_msg.signal().process_signal()))) {
     return IGNORED;
   }
 
-  auto result = client_->PushSignals(*signal_msg);
+  return PushSignal(signal_msg);
+}
+
+SignalHandler::Result ProcessSignalHandler::PushSignal(const sensor::SignalStreamMessage& signal_msg) {
+  std::lock_guard<std::mutex> lock(send_mutex_);
+
+  auto result = client_->PushSignals(signal_msg);
   if (result == SignalHandler::PROCESSED) {
     ++(stats_->nProcessSent);
   } else if (result == SignalHandler::ERROR) {
@@ -75,6 +119,61 @@ SignalHandler::Result ProcessSignalHandler::HandleExistingProcess(sinsp_threadin
   return result;
 }
 
+void ProcessSignalHandler::SendExistingProcesses() {
+  ThreadPlacement::Apply("proc-existing", ThreadRole::BACKGROUND);
+
+  std::vector<ProcessSnapshot> batch;
+  batch.reserve(kExistingProcessBatchSize);
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(existing_processes_mutex_);
+      existing_processes_cond_.wait(lock, [this] { return !sending_existing_processes_ || !existing_processes_.empty(); });
+      if (!sending_existing_processes_) {
+        break;
+      }
+
+      while (!existing_processes_.empty() && batch.size() < kExistingProcessBatchSize) {
+        batch.push_back(std::move(existing_processes_.front()));
+        existing_processes_.pop_front();
+      }
+    }
+    existing_processes_space_cond_.notify_all();
+
+    if (batch.empty()) {
+      continue;
+    }
+
+    WITH_TIMER(CollectorStats::process_existing_send) {
+      for (const auto& snapshot : batch) {
+        const auto* signal_msg = existing_formatter_.ToProtoMessage(snapshot);
+        if (!signal_msg) {
+          ++(stats_->nProcessResolutionFailuresByTinfo);
+          continue;
+        }
+
+        auto result = SendSignal(*signal_msg);
+        if (result == ERROR || result == NEEDS_REFRESH) {
+          CLOG(WARNING) << "Failed to write existing process signal, dropping the pending ones";
+          {
+            std::lock_guard<std::mutex> lock(existing_processes_mutex_);
+            existing_processes_.clear();
+          }
+          existing_processes_space_cond_.notify_all();
+          // The stream was re-established by this write, so the event loop
+          // will not see the refresh request, forward it.
+          if (result == NEEDS_REFRESH) {
+            needs_refresh_ = true;
+          }
+          break;
+        }
+      }
+    }
+
+    batch.clear();
+  }
+}
+
 std::vector<std::string> ProcessSignalHandler::GetRelevantEvents() {
   return {"execve<"};
 }
@@ -1,7 +1,13 @@
 #ifndef __PROCESS_SIGNAL_HANDLER_H__
 #define __PROCESS_SIGNAL_HANDLER_H__
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+
+#include <gtest/gtest_prod.h>
 
 #include "libsinsp/sinsp.h"
 
@@ -10,6 +16,7 @@
 #include "ProcessSignalFormatter.h"
 #include "RateLimit.h"
 #include "SignalHandler.h"
+#include "StoppableThread.h"
 #include "SysdigService.h"
 
 namespace collector {
@@ -17,20 +24,60 @@ namespace collector {
 class ProcessSignalHandler : public SignalHandler {
  public:
   ProcessSignalHandler(sinsp* inspector, ISignalServiceClient* client, SysdigStats* stats)
-      : client_(client), formatter_(inspector), stats_(stats) {}
+      : client_(client), formatter_(inspector), existing_formatter_(inspector), stats_(stats) {}
 
   bool Start() override;
   bool Stop() override;
   Result HandleSignal(sinsp_evt* evt) override;
+  // Only takes a snapshot of the process, which is then formatted and sent
+  // in batches from a background thread, so that the event loop is not
+  // blocked for the duration of the whole resend.
   Result HandleExistingProcess(sinsp_threadinfo* tinfo) override;
   std::string GetName() override { return "ProcessSignalHandler"; }
   std::vector<std::string> GetRelevantEvents() override;
 
  private:
+  FRIEND_TEST(ProcessSignalHandlerTest, TestExistingProcessesRefresh);
+  FRIEND_TEST(ProcessSignalHandlerTest, TestExistingProcessesBackpressure);
+
+  static constexpr size_t kExistingProcessBatchSize = 256;
+  // Once this many snapshots are waiting to be sent, taking new ones waits for
+  // the backlog to drain, so that a slow stream does not let it grow with the
+  // number of processes.
+  static constexpr size_t kMaxPendingExistingProcesses = 16384;
+
+  using ProcessSnapshot = ProcessSignalFormatter::ProcessSnapshot;
+
+  // Returns false if the process was sent too often recently.
+  bool AllowProcess(const std::string& key);
+  // Sends the signal if the rate limit allows it.
+  Result SendSignal(const sensor::SignalStreamMessage& signal_msg);
+  // Sends the signal, without checking the rate limit.
+  Result PushSignal(const sensor::SignalStreamMessage& signal_msg);
+  void SendExistingProcesses();
+
   ISignalServiceClient* client_;
   ProcessSignalFormatter formatter_;
+  ProcessSignalFormatter existing_formatter_;
   SysdigStats* stats_;
+
+  // Protects the rate limiter and the writes to the client, which are shared
+  // between the event loop and the existing processes thread.
+  std::mutex send_mutex_;
   RateLimitCache rate_limiter_;
+
+  StoppableThread existing_processes_thread_;
+  std::mutex existing_processes_mutex_;
+  std::condition_variable existing_processes_cond_;
+  // Notified when pending snapshots are taken to be sent.
+  std::condition_variable existing_processes_space_cond_;
+  std::deque<ProcessSnapshot> existing_processes_;
+  // Whether the existing processes thread drains the backlog, cleared to stop
+  // it. Until it is started, snapshots are queued without waiting.
+  bool sending_existing_processes_ = false;
+  // Set when the stream was re-established while sending existing processes,
+  // the next event will then request a new snapshot.
+  std::atomic<bool> needs_refresh_{false};
 };
 
 }  // namespace collector
@@ -394,8 +394,10 @@ void ResolveSocketInodes(const SocketsByContainer& sockets_by_container, const C
 // ReadContainerConnections reads all container connection info from the given `/proc`-like directory. All connections
 // from non-container processes are ignored.
 // process_store, when provided, is used to to link the originator process of a ContainerEndpoint.
+// pacer, when provided, is called in between processes.
 bool ReadContainerConnections(const char* proc_path, std::shared_ptr<ProcessStore> process_store,
-                              std::vector<Connection>* connections, std::vector<ContainerEndpoint>* listen_endpoints) {
+                              std::vector<Connection>* connections, std::vector<ContainerEndpoint>* listen_endpoints,
+                              CPUPacer* pacer = nullptr) {
   DirHandle procdir = opendir(proc_path);
   if (!procdir.valid()) {
     COUNTER_INC(CollectorStats::procfs_could_not_open_proc_dir);
@@ -409,6 +411,7 @@ bool ReadContainerConnections(const char* proc_path, std::shared_ptr<ProcessStor
   // Read all the information from proc.
   while (auto curr = procdir.read()) {
     if (!std::isdigit(curr->d_name[0])) continue;  // only look for <pid> entries
+    if (pacer) pacer->Pace();
     long long pid = strtoll(curr->d_name, 0, 10);
 
     FDHandle dirfd = procdir.openat(curr->d_name, O_RDONLY);
@@ -536,7 +539,8 @@ std::optional<std::string_view> ExtractContainerID(std::string_view cgroup_line)
 }
 
 bool ConnScraper::Scrape(std::vector<Connection>* connections, std::vector<ContainerEndpoint>* listen_endpoints) {
-  return ReadContainerConnections(proc_path_.c_str(), process_store_, connections, listen_endpoints);
+  CPUPacer pacer(cpu_budget_, std::chrono::steady_clock::now() + pacing_window_);
+  return ReadContainerConnections(proc_path_.c_str(), process_store_, connections, listen_endpoints, &pacer);
 }
 
 bool ProcessScraper::Scrape(uint64_t pid, ProcessInfo& process_info) {
@@ -1,10 +1,12 @@
 #ifndef COLLECTOR_PROCFSSCRAPER_H
 #define COLLECTOR_PROCFSSCRAPER_H
 
+#include <chrono>
 #include <cstring>
 #include <string>
 #include <vector>
 
+#include "CPUBudget.h"
 #include "NetworkConnection.h"
 
 namespace collector {
@@ -19,9 +21,14 @@ class IConnScraper {
 // ConnScraper is a class that allows scraping a `/proc`-like directory structure for active network connections.
 class ConnScraper : public IConnScraper {
  public:
-  explicit ConnScraper(std::string proc_path, std::shared_ptr<ProcessStore> process_store = 0)
+  // While collector is throttled according to cpu_budget, scrapes are spread
+  // over pacing_window.
+  explicit ConnScraper(std::string proc_path, std::shared_ptr<ProcessStore> process_store = 0,
+                       const CPUBudget* cpu_budget = nullptr, std::chrono::milliseconds pacing_window = {})
       : proc_path_(std::move(proc_path)),
-        process_store_(process_store) {}
+        process_store_(process_store),
+        cpu_budget_(cpu_budget),
+        pacing_window_(pacing_window) {}
 
   // Scrape returns a snapshot of all active network connections in the given vector.
   bool Scrape(std::vector<Connection>* connections, std::vector<ContainerEndpoint>* listen_endpoints);
@@ -29,6 +36,8 @@ class ConnScraper : public IConnScraper {
  private:
   std::string proc_path_;
   std::shared_ptr<ProcessStore> process_store_;
+  const CPUBudget* cpu_budget_;
+  std::chrono::milliseconds pacing_window_;
 };
 
 class ProcessScraper {
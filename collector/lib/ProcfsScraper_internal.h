@@ -2,6 +2,7 @@
 #define COLLECTOR_PROCFSSCRAPER_INTERNAL_H
 
 #include <optional>
+#include <string>
 #include <string_view>
 
 namespace collector {
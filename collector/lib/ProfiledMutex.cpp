@@ -0,0 +1,49 @@
+#include "ProfiledMutex.h"
+
+namespace collector {
+
+std::atomic<bool> ProfiledMutex::profiling_enabled_(false);
+
+void ProfiledMutex::lock() {
+  if (mutex_.try_lock()) {
+    if (IsProfilingEnabled()) {
+      CollectorStats::GetOrCreate().LockAcquired(type_);
+      locked_at_ = Clock::now();
+    }
+    return;
+  }
+
+  if (!IsProfilingEnabled()) {
+    mutex_.lock();
+    return;
+  }
+
+  auto start = Clock::now();
+  mutex_.lock();
+  locked_at_ = Clock::now();
+
+  auto& stats = CollectorStats::GetOrCreate();
+  stats.LockAcquired(type_);
+  stats.LockContended(type_, Micros(locked_at_ - start));
+}
+
+bool ProfiledMutex::try_lock() {
+  if (!mutex_.try_lock()) {
+    return false;
+  }
+  if (IsProfilingEnabled()) {
+    CollectorStats::GetOrCreate().LockAcquired(type_);
+    locked_at_ = Clock::now();
+  }
+  return true;
+}
+
+void ProfiledMutex::unlock() {
+  if (locked_at_ != Clock::time_point()) {
+    CollectorStats::GetOrCreate().LockReleased(type_, Micros(Clock::now() - locked_at_));
+    locked_at_ = Clock::time_point();
+  }
+  mutex_.unlock();
+}
+
+}  // namespace collector
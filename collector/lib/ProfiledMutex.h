@@ -0,0 +1,52 @@
+#ifndef COLLECTOR_PROFILEDMUTEX_H
+#define COLLECTOR_PROFILEDMUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "CollectorStats.h"
+
+namespace collector {
+
+// ProfiledMutex is a std::mutex recording its contention in CollectorStats,
+// under the lock type it is created with, while lock profiling is enabled:
+// the number of acquisitions, and histograms of the time spent waiting for
+// the lock when it was contended, and of the time it was held.
+//
+// Uncontended acquisitions go through try_lock, and only cost clock reads for
+// the hold time when profiling is enabled. It can be used with WITH_LOCK and
+// the standard lock types, but not with std::condition_variable.
+class ProfiledMutex {
+ public:
+  explicit ProfiledMutex(CollectorStats::LockType type) : type_(type) {}
+
+  ProfiledMutex(const ProfiledMutex&) = delete;
+  ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+  void lock();
+  bool try_lock();
+  void unlock();
+
+  static void EnableProfiling(bool enable) { profiling_enabled_.store(enable, std::memory_order_relaxed); }
+  static bool IsProfilingEnabled() { return profiling_enabled_.load(std::memory_order_relaxed); }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static int64_t Micros(Clock::duration duration) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+  }
+
+  static std::atomic<bool> profiling_enabled_;
+
+  std::mutex mutex_;
+  CollectorStats::LockType type_;
+  // Time the lock was acquired at, only accessed while holding it. Unset if
+  // profiling was disabled then.
+  Clock::time_point locked_at_;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_PROFILEDMUTEX_H
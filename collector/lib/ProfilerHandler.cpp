@@ -7,7 +7,9 @@
 #include <json/json.h>
 #include <sys/stat.h>
 
+#include "CollectorStats.h"
 #include "Logging.h"
+#include "ProfiledMutex.h"
 #include "Profiler.h"
 #include "Utility.h"
 
@@ -17,6 +19,8 @@ const std::string ProfilerHandler::kCPUProfileFilename = "/module/cpu_profile";
 const std::string ProfilerHandler::kBaseRoute = "/profile";
 const std::string ProfilerHandler::kCPURoute = kBaseRoute + "/cpu";
 const std::string ProfilerHandler::kHeapRoute = kBaseRoute + "/heap";
+const std::string ProfilerHandler::kLocksRoute = kBaseRoute + "/locks";
+const std::string ProfilerHandler::kWindowsRoute = kCPURoute + "/windows";
 
 bool ProfilerHandler::ServerError(struct mg_connection* conn, const char* err) {
   return mg_send_http_error(conn, 500, err) >= 0;
@@ -51,13 +55,89 @@ bool ProfilerHandler::SendHeapProfile(struct mg_connection* conn) {
   return true;
 }
 
+bool ProfilerHandler::SendLockProfile(struct mg_connection* conn) {
+  auto& stats = CollectorStats::GetOrCreate();
+
+  // Histograms list the number of durations lower than each bound, in
+  // microseconds, the last bound being unlimited.
+  auto histogram = [](auto get_bucket) {
+    Json::Value buckets(Json::arrayValue);
+    for (int b = 0; b < CollectorStats::kLockHistogramBuckets; b++) {
+      Json::Value bucket(Json::objectValue);
+      if (b < CollectorStats::kLockHistogramBuckets - 1) {
+        bucket["lt_us"] = Json::Int64(int64_t{1} << b);
+      }
+      bucket["count"] = Json::Int64(get_bucket(b));
+      buckets.append(bucket);
+    }
+    return buckets;
+  };
+
+  Json::Value resp(Json::objectValue);
+  resp["enabled"] = ProfiledMutex::IsProfilingEnabled();
+  Json::Value& locks = resp["locks"] = Json::Value(Json::objectValue);
+  for (int i = 0; i < CollectorStats::lock_type_max; i++) {
+    Json::Value lock(Json::objectValue);
+    lock["acquisitions"] = Json::Int64(stats.GetLockAcquisitions(i));
+    lock["contended"] = Json::Int64(stats.GetLockContentions(i));
+    lock["wait_us_total"] = Json::Int64(stats.GetLockWaitMicros(i));
+    lock["hold_us_total"] = Json::Int64(stats.GetLockHoldMicros(i));
+    lock["wait_us"] = histogram([&](int b) { return stats.GetLockWaitBucket(i, b); });
+    lock["hold_us"] = histogram([&](int b) { return stats.GetLockHoldBucket(i, b); });
+    locks[CollectorStats::lock_type_to_name[i]] = lock;
+  }
+
+  std::string json_body = resp.toStyledString();
+  if (mg_send_http_ok(conn, "application/json", json_body.length()) < 0) {
+    return false;
+  }
+  return mg_write(conn, json_body.c_str(), json_body.length()) >= 0;
+}
+
+bool ProfilerHandler::SendWindowList(struct mg_connection* conn) {
+  Json::Value resp(Json::arrayValue);
+  if (continuous_profiler_ != nullptr) {
+    for (const auto& info : continuous_profiler_->ListWindows()) {
+      Json::Value window(Json::objectValue);
+      window["id"] = Json::UInt64(info.id);
+      window["start_ms"] = Json::Int64(std::chrono::duration_cast<std::chrono::milliseconds>(info.start.time_since_epoch()).count());
+      window["duration_ms"] = Json::Int64(info.duration.count());
+      window["size"] = Json::UInt64(info.size);
+      resp.append(window);
+    }
+  }
+  std::string json_body = resp.toStyledString();
+  if (mg_send_http_ok(conn, "application/json", json_body.length()) < 0) {
+    return false;
+  }
+  return mg_write(conn, json_body.c_str(), json_body.length()) >= 0;
+}
+
+bool ProfilerHandler::SendWindow(struct mg_connection* conn, const std::string& id) {
+  uint64_t window_id;
+  try {
+    window_id = std::stoull(id);
+  } catch (...) {
+    return ClientError(conn, "invalid window id");
+  }
+  std::string profile;
+  if (continuous_profiler_ == nullptr || !continuous_profiler_->GetWindow(window_id, &profile)) {
+    return mg_send_http_error(conn, 404, "window not found") >= 0;
+  }
+  if (mg_send_http_ok(conn, "application/octet-stream", profile.length()) < 0) {
+    return false;
+  }
+  return mg_write(conn, profile.data(), profile.length()) >= 0;
+}
+
 bool ProfilerHandler::SendStatus(struct mg_connection* conn) {
   Json::Value resp(Json::objectValue);
   WITH_LOCK(mutex_) {
     resp["supports_cpu"] = Profiler::IsCPUProfilerSupported();
     resp["supports_heap"] = Profiler::IsHeapProfilerSupported();
-    resp["cpu"] = Profiler::IsCPUProfilerEnabled() ? "on" : (cpu_profile_length_ > 0 ? "off" : "empty");
+    resp["cpu"] = cpu_profiling_ ? "on" : (cpu_profile_length_ > 0 ? "off" : "empty");
     resp["heap"] = Profiler::IsHeapProfilerEnabled() ? "on" : (heap_profile_length_ > 0 ? "off" : "empty");
+    resp["continuous_cpu"] = continuous_profiler_ != nullptr && continuous_profiler_->IsEnabled();
   }
   std::string json_body = resp.toStyledString();
   if (mg_send_http_ok(conn, "application/json", json_body.length()) < 0) {
@@ -69,15 +149,26 @@ bool ProfilerHandler::SendStatus(struct mg_connection* conn) {
 bool ProfilerHandler::HandleCPURoute(struct mg_connection* conn, const std::string& post_data) {
   WITH_LOCK(mutex_) {
     if (post_data == "on") {
-      if (!Profiler::IsCPUProfilerEnabled()) {
+      if (!cpu_profiling_) {
+        if (continuous_profiler_ != nullptr) {
+          continuous_profiler_->Suspend();
+        }
         if (!Profiler::StartCPUProfiler(kCPUProfileFilename)) {
+          if (continuous_profiler_ != nullptr) {
+            continuous_profiler_->Resume();
+          }
           return ServerError(conn, "failed starting cpu profiler");
         }
+        cpu_profiling_ = true;
         CLOG(INFO) << "Started CPU profiler";
       }
     } else if (post_data == "off") {
-      if (Profiler::IsCPUProfilerEnabled()) {
+      if (cpu_profiling_) {
         Profiler::StopCPUProfiler();
+        cpu_profiling_ = false;
+        if (continuous_profiler_ != nullptr) {
+          continuous_profiler_->Resume();
+        }
         struct stat sdata;
         if (stat(kCPUProfileFilename.c_str(), &sdata) == 0) {
           cpu_profile_length_ = sdata.st_size;
@@ -130,16 +221,37 @@ bool ProfilerHandler::HandleHeapRoute(struct mg_connection* conn, const std::str
   return mg_send_http_ok(conn, "text/plain", 0) >= 0;
 }
 
-bool ProfilerHandler::handlePost(CivetServer* server, struct mg_connection* conn) {
-  if (!Profiler::IsCPUProfilerSupported()) {
-    return ServerError(conn, "not supported");
+bool ProfilerHandler::HandleLocksRoute(struct mg_connection* conn, const std::string& post_data) {
+  if (post_data == "on") {
+    if (!ProfiledMutex::IsProfilingEnabled()) {
+      ProfiledMutex::EnableProfiling(true);
+      CLOG(INFO) << "Started lock profiler";
+    }
+  } else if (post_data == "off") {
+    if (ProfiledMutex::IsProfilingEnabled()) {
+      ProfiledMutex::EnableProfiling(false);
+      CLOG(INFO) << "Stopped lock profiler";
+    }
+  } else {
+    return ClientError(conn, "invalid post data");
   }
+  return mg_send_http_ok(conn, "text/plain", 0) >= 0;
+}
+
+bool ProfilerHandler::handlePost(CivetServer* server, struct mg_connection* conn) {
   const mg_request_info* req_info = mg_get_request_info(conn);
   if (req_info == nullptr) {
     return ServerError(conn, "unable to read request");
   }
   std::string uri(req_info->local_uri);
   std::string post_data(server->getPostData(conn));
+  // Lock profiling does not depend on gperftools.
+  if (uri == kLocksRoute) {
+    return HandleLocksRoute(conn, post_data);
+  }
+  if (!Profiler::IsCPUProfilerSupported()) {
+    return ServerError(conn, "not supported");
+  }
   if (uri == kCPURoute) {
     return HandleCPURoute(conn, post_data);
   } else if (uri == kHeapRoute) {
@@ -160,6 +272,12 @@ bool ProfilerHandler::handleGet(CivetServer* server, struct mg_connection* conn)
     return SendHeapProfile((conn));
   } else if (uri == kCPURoute) {
     return SendCPUProfile(conn);
+  } else if (uri == kLocksRoute) {
+    return SendLockProfile(conn);
+  } else if (uri == kWindowsRoute) {
+    return SendWindowList(conn);
+  } else if (uri.compare(0, kWindowsRoute.size() + 1, kWindowsRoute + "/") == 0) {
+    return SendWindow(conn, uri.substr(kWindowsRoute.size() + 1));
   }
   return ClientError(conn, "unknown route");
 }
@@ -5,6 +5,7 @@
 #include <mutex>
 
 #include "CivetServer.h"
+#include "ContinuousProfiler.h"
 #include "Profiler.h"
 
 namespace collector {
@@ -20,12 +21,25 @@ namespace collector {
 //   - get latest cpu profile
 // GET /profile/heap
 //   - get latest heap profile
+// GET /profile/cpu/windows
+//   - list the cpu profile windows recorded by continuous profiling, as JSON
+// GET /profile/cpu/windows/<id>
+//   - get the cpu profile of a window
+// POST /profile/locks
+//   - accepts post data of on|off to enable or disable lock contention profiling
+// GET /profile/locks
+//   - get the lock contention profile, as JSON
 class ProfilerHandler : public CivetHandler {
  public:
   static const std::string kCPUProfileFilename;
   static const std::string kBaseRoute;
   static const std::string kCPURoute;
   static const std::string kHeapRoute;
+  static const std::string kLocksRoute;
+  static const std::string kWindowsRoute;
+
+  // Manually starting the CPU profiler suspends continuous profiling, if any.
+  explicit ProfilerHandler(ContinuousProfiler* continuous_profiler = nullptr) : continuous_profiler_(continuous_profiler) {}
 
   bool handleGet(CivetServer* server, struct mg_connection* conn);
   bool handlePost(CivetServer* server, struct mg_connection* conn);
@@ -36,12 +50,20 @@ class ProfilerHandler : public CivetHandler {
   bool SendStatus(struct mg_connection* conn);
   bool SendHeapProfile(struct mg_connection* conn);
   bool SendCPUProfile(struct mg_connection* conn);
+  bool SendLockProfile(struct mg_connection* conn);
+  bool SendWindowList(struct mg_connection* conn);
+  bool SendWindow(struct mg_connection* conn, const std::string& id);
   bool HandleCPURoute(struct mg_connection* conn, const std::string& post_data);
   bool HandleHeapRoute(struct mg_connection* conn, const std::string& post_data);
+  bool HandleLocksRoute(struct mg_connection* conn, const std::string& post_data);
   MallocUniquePtr heap_profile_;
   size_t heap_profile_length_;
   size_t cpu_profile_length_;
+  // Whether the CPU profiler was started manually, rather than for a
+  // continuous profiling window.
+  bool cpu_profiling_ = false;
   std::mutex mutex_;
+  ContinuousProfiler* continuous_profiler_;
 };
 }  // namespace collector
 
@@ -56,6 +56,9 @@ class ArenaProtoAllocator {
     return google::protobuf::Arena::CreateMessage<Message>(&arena_);
   }
 
+  // Size of the pre-allocated pool, which the arena grows beyond only until the next Reset.
+  size_t ReservedBytes() const { return pool_size_; }
+
  private:
   std::unique_ptr<char[]> pool_;
   size_t pool_size_;
@@ -81,6 +84,9 @@ class HeapProtoAllocator {
     return &message_;
   }
 
+  // Messages are allocated on the heap, and freed along with the root message.
+  size_t ReservedBytes() const { return 0; }
+
  private:
   Message message_;
 };
@@ -63,8 +63,14 @@ bool RateLimitCache::Allow(std::string key) {
     CLOG(INFO) << "Flushing rate limiting cache";
     cache_.clear();
     COUNTER_INC(CollectorStats::rate_limit_flushing_counts);
+    key_bytes_ = 0;
+    memory_.Set({0, ApproxHashContainerBytes(cache_)});
     return true;
   }
+  if (pair.second) {
+    key_bytes_ += key.size();
+    memory_.Set({cache_.size(), ApproxHashContainerBytes(cache_) + key_bytes_});
+  }
   return limiter_->Allow(&pair.first->second);
 }
 
@@ -3,6 +3,7 @@
 
 #include <unordered_map>
 
+#include "MemoryAccounting.h"
 #include "Utility.h"
 
 namespace collector {
@@ -39,6 +40,9 @@ class RateLimitCache {
   size_t capacity_;
   std::unique_ptr<Limiter> limiter_;
   std::unordered_map<std::string, TokenBucket> cache_;
+  // Keys are mostly longer than the inline string buffer, and allocated separately.
+  size_t key_bytes_ = 0;
+  MemoryGauge memory_{"rate_limit_cache"};
 };
 }  // namespace collector
 
@@ -0,0 +1,291 @@
+#include "Scheduler.h"
+
+#include <cmath>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "CollectorStats.h"
+#include "Logging.h"
+#include "Profiler.h"
+#include "ThreadPlacement.h"
+#include "Utility.h"
+
+namespace collector {
+
+constexpr std::chrono::milliseconds Scheduler::kTick;
+constexpr std::chrono::milliseconds Scheduler::kDeferralStep;
+constexpr std::chrono::milliseconds Scheduler::kMaxDeferral;
+
+Scheduler::Scheduler(size_t num_workers) : wheel_(ToTicks(Clock::now())) {
+  for (size_t i = 0; i < num_workers; i++) {
+    workers_.push_back(std::make_unique<StoppableThread>());
+  }
+}
+
+Scheduler::~Scheduler() {
+  Stop();
+}
+
+bool Scheduler::Start() {
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ < 0) {
+    CLOG(ERROR) << "Could not create the scheduler timer: " << StrError();
+    return false;
+  }
+  event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd_ < 0) {
+    CLOG(ERROR) << "Could not create the scheduler event: " << StrError();
+    close(timer_fd_);
+    timer_fd_ = -1;
+    return false;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = false;
+  }
+
+  if (!dispatcher_.Start([this] { Dispatch(); })) {
+    return false;
+  }
+  for (auto& worker : workers_) {
+    worker->Start([this] { Work(); });
+  }
+
+  // Tasks may have been scheduled before the dispatcher started.
+  Wake();
+  return true;
+}
+
+void Scheduler::Stop() {
+  if (!dispatcher_.running()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_cond_.notify_all();
+
+  dispatcher_.Stop();
+  for (auto& worker : workers_) {
+    if (worker->running()) {
+      worker->Stop();
+    }
+  }
+
+  close(timer_fd_);
+  close(event_fd_);
+  timer_fd_ = event_fd_ = -1;
+}
+
+Scheduler::TaskId Scheduler::SchedulePeriodic(std::string name, std::chrono::milliseconds period, std::function<void()> fn,
+                                              bool deferrable) {
+  if (period < kTick) {
+    period = kTick;
+  }
+
+  // Start offsets follow the golden ratio sequence, which spreads any number
+  // of tasks evenly over the period.
+  double phase;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    phase = std::fmod(num_periodic_++ * 0.6180339887498949, 1.0);
+  }
+  auto offset = std::chrono::duration_cast<Clock::duration>(period * phase);
+
+  return Schedule(std::move(name), Clock::now() + offset, period, std::move(fn), deferrable);
+}
+
+Scheduler::TaskId Scheduler::ScheduleOnce(std::string name, std::chrono::milliseconds delay, std::function<void()> fn) {
+  return Schedule(std::move(name), Clock::now() + delay, std::chrono::milliseconds(0), std::move(fn), false);
+}
+
+Scheduler::TaskId Scheduler::Schedule(std::string name, Clock::time_point deadline, std::chrono::milliseconds period, std::function<void()> fn,
+                                      bool deferrable) {
+  TaskId id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = next_id_++;
+
+    Task& task = tasks_[id];
+    task.name = std::move(name);
+    task.fn = std::move(fn);
+    task.period = period;
+    task.deadline = deadline;
+    task.deferrable = deferrable;
+
+    wheel_.Add(id, ToTicks(deadline));
+  }
+  Wake();
+  return id;
+}
+
+bool Scheduler::Cancel(TaskId id) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = tasks_.find(id);
+  if (it == tasks_.end()) {
+    return false;
+  }
+
+  // The timer of the task stays in the wheel, and is ignored once expired.
+  // Other tasks may be added while waiting, and the task may be removed by a
+  // concurrent call, hence the lookups.
+  it->second.cancelled = true;
+  done_cond_.wait(lock, [this, id] {
+    auto it = tasks_.find(id);
+    return it == tasks_.end() || !it->second.running;
+  });
+  return tasks_.erase(id) > 0;
+}
+
+void Scheduler::Wake() {
+  uint64_t value = 1;
+  if (event_fd_ >= 0 && write(event_fd_, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+    CLOG(ERROR) << "Could not wake up the scheduler: " << StrError();
+  }
+}
+
+void Scheduler::Dispatch() {
+  Profiler::RegisterCPUThread();
+  ThreadPlacement::Apply("sched-dispatch", ThreadRole::BACKGROUND);
+
+  struct pollfd fds[] = {
+      {timer_fd_, POLLIN, 0},
+      {event_fd_, POLLIN, 0},
+      {dispatcher_.stop_fd(), POLLIN, 0},
+  };
+
+  std::vector<uint64_t> expired;
+  while (!dispatcher_.should_stop()) {
+    if (poll(fds, sizeof(fds) / sizeof(fds[0]), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      CLOG(ERROR) << "Scheduler failed to wait for timers: " << StrError();
+      break;
+    }
+
+    // Both descriptors are non-blocking, and only need to be reset.
+    uint64_t value;
+    (void)!read(timer_fd_, &value, sizeof(value));
+    (void)!read(event_fd_, &value, sizeof(value));
+
+    size_t num_ready = 0;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      expired.clear();
+      wheel_.Advance(ToTicks(Clock::now()), &expired);
+      for (TaskId id : expired) {
+        auto it = tasks_.find(id);
+        if (it == tasks_.end() || it->second.cancelled) {
+          continue;
+        }
+        ready_.push_back(id);
+        num_ready++;
+      }
+
+      struct itimerspec spec = {};
+      int64_t next = wheel_.NextExpiry();
+      if (next >= 0) {
+        auto since_epoch = FromTicks(next).time_since_epoch();
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+        spec.it_value.tv_sec = secs.count();
+        spec.it_value.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch - secs).count();
+      }
+      if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+        CLOG(ERROR) << "Could not arm the scheduler timer: " << StrError();
+      }
+    }
+
+    if (workers_.empty()) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!ready_.empty() && !dispatcher_.should_stop()) {
+        RunNext(lock);
+      }
+    } else if (num_ready == 1) {
+      ready_cond_.notify_one();
+    } else if (num_ready > 1) {
+      ready_cond_.notify_all();
+    }
+  }
+}
+
+void Scheduler::Work() {
+  Profiler::RegisterCPUThread();
+  ThreadPlacement::Apply("sched-worker", ThreadRole::BACKGROUND);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    ready_cond_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+    if (stopping_) {
+      break;
+    }
+
+    RunNext(lock);
+  }
+}
+
+void Scheduler::RunNext(std::unique_lock<std::mutex>& lock) {
+  TaskId id = ready_.front();
+  ready_.pop_front();
+  auto it = tasks_.find(id);
+  if (it == tasks_.end() || it->second.cancelled) {
+    return;
+  }
+
+  // Tasks are only removed once they are not running, so the reference
+  // remains valid while the lock is released.
+  Task& task = it->second;
+
+  if (task.deferrable && should_defer_ && should_defer_()) {
+    auto now = Clock::now();
+    if (now - task.deadline < kMaxDeferral) {
+      wheel_.Add(id, ToTicks(now + kDeferralStep));
+      Wake();
+      COUNTER_INC(CollectorStats::scheduler_deferred_runs);
+      return;
+    }
+  }
+
+  task.running = true;
+  lock.unlock();
+
+  auto lateness = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - task.deadline);
+  CollectorStats::GetOrCreate().EndTimerAt(CollectorStats::scheduler_task_lateness, std::max<int64_t>(lateness.count(), 0));
+  CLOG_THROTTLED_IF(lateness > std::chrono::seconds(1), WARNING, std::chrono::minutes(1))
+      << "Task " << task.name << " started " << lateness.count() / 1000 << " ms late";
+
+  task.fn();
+
+  lock.lock();
+  task.running = false;
+  if (!task.cancelled) {
+    if (task.period.count() > 0) {
+      auto now = Clock::now();
+      auto missed = (now - task.deadline) / task.period;
+      task.deadline += task.period * (missed + 1);
+      wheel_.Add(id, ToTicks(task.deadline));
+      Wake();
+    } else {
+      tasks_.erase(id);
+    }
+  }
+  done_cond_.notify_all();
+}
+
+int64_t Scheduler::ToTicks(Clock::time_point time_point) {
+  // Rounded up, so that tasks never run before their deadline.
+  auto since_epoch = time_point.time_since_epoch();
+  return (since_epoch + kTick - Clock::duration(1)) / kTick;
+}
+
+Scheduler::Clock::time_point Scheduler::FromTicks(int64_t ticks) {
+  return Clock::time_point(std::chrono::duration_cast<Clock::duration>(ticks * kTick));
+}
+
+}  // namespace collector
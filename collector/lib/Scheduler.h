@@ -0,0 +1,108 @@
+#ifndef COLLECTOR_SCHEDULER_H
+#define COLLECTOR_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "StoppableThread.h"
+#include "TimerWheel.h"
+
+namespace collector {
+
+// Scheduler runs periodic and delayed background tasks on a single thread,
+// instead of each task having a thread sleeping in between runs. Tasks run on
+// the dispatcher thread itself, unless worker threads are requested, which is
+// only worth it when tasks are long enough to delay each other.
+//
+// Deadlines are kept in a timer wheel, and a dispatcher thread sleeps on a
+// timerfd armed for the next deadline, or an eventfd signaled when tasks are
+// added. Periodic tasks are started at different offsets within their period,
+// so that tasks with the same period do not run at the same time. How late
+// tasks start is recorded in the scheduler_task_lateness timer.
+//
+// Tasks may be marked deferrable, in which case their runs are postponed,
+// within a bound, while the deferral predicate holds (e.g., while collector is
+// throttled).
+class Scheduler {
+ public:
+  using TaskId = uint64_t;
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr std::chrono::milliseconds kTick{10};
+  static constexpr std::chrono::milliseconds kDeferralStep{1000};
+  static constexpr std::chrono::milliseconds kMaxDeferral{10000};
+
+  explicit Scheduler(size_t num_workers = 0);
+  ~Scheduler();
+
+  bool Start();
+  void Stop();
+
+  // Sets the predicate deciding whether deferrable tasks are postponed. Must
+  // be called before Start.
+  void SetDeferral(std::function<bool()> should_defer) { should_defer_ = std::move(should_defer); }
+
+  // Runs fn every period. Runs of a given task never overlap, and runs which
+  // were missed because the previous one took too long are skipped.
+  TaskId SchedulePeriodic(std::string name, std::chrono::milliseconds period, std::function<void()> fn,
+                          bool deferrable = false);
+  // Runs fn once, after delay.
+  TaskId ScheduleOnce(std::string name, std::chrono::milliseconds delay, std::function<void()> fn);
+
+  // Cancels a task, waiting for it to complete if it is running. Returns false
+  // if the task is unknown, e.g. it already ran once or was cancelled.
+  bool Cancel(TaskId id);
+
+  size_t NumWorkers() const { return workers_.size(); }
+
+ private:
+  struct Task {
+    std::string name;
+    std::function<void()> fn;
+    std::chrono::milliseconds period;  // zero for tasks running once
+    Clock::time_point deadline;
+    bool deferrable = false;
+    bool running = false;
+    bool cancelled = false;
+  };
+
+  TaskId Schedule(std::string name, Clock::time_point deadline, std::chrono::milliseconds period, std::function<void()> fn,
+                  bool deferrable);
+
+  void Dispatch();
+  void Work();
+  // Runs the next ready task. Must be called with the lock held, which is
+  // released while the task runs.
+  void RunNext(std::unique_lock<std::mutex>& lock);
+  void Wake();
+
+  static int64_t ToTicks(Clock::time_point time_point);
+  static Clock::time_point FromTicks(int64_t ticks);
+
+  int timer_fd_ = -1;
+  int event_fd_ = -1;
+  StoppableThread dispatcher_;
+  std::vector<std::unique_ptr<StoppableThread>> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable ready_cond_;
+  std::condition_variable done_cond_;
+  std::function<bool()> should_defer_;
+  TimerWheel wheel_;
+  std::unordered_map<TaskId, Task> tasks_;
+  std::deque<TaskId> ready_;
+  TaskId next_id_ = 1;
+  uint64_t num_periodic_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_SCHEDULER_H
@@ -5,6 +5,7 @@
 #include "GRPCUtil.h"
 #include "Logging.h"
 #include "ProtoUtil.h"
+#include "ThreadPlacement.h"
 #include "Utility.h"
 
 namespace collector {
@@ -43,6 +44,7 @@ bool SignalServiceClient::EstablishGRPCStreamSingle() {
 }
 
 void SignalServiceClient::EstablishGRPCStream() {
+  ThreadPlacement::Apply("signal-client", ThreadRole::BACKGROUND);
   while (EstablishGRPCStreamSingle())
     ;
   CLOG(INFO) << "Signal service client terminating.";
@@ -61,6 +63,9 @@ void SignalServiceClient::Stop() {
 
 SignalHandler::Result SignalServiceClient::PushSignals(const SignalStreamMessage& msg) {
   if (!stream_active_.load(std::memory_order_acquire)) {
+    if (buffer_startup_signals_) {
+      return BufferStartupSignal(msg);
+    }
     CLOG_THROTTLED(ERROR, std::chrono::seconds(10))
         << "GRPC stream is not established";
     return SignalHandler::ERROR;
@@ -68,25 +73,65 @@ SignalHandler::Result SignalServiceClient::PushSignals(const SignalStreamMessage
 
   if (first_write_) {
     first_write_ = false;
+    if (!FlushStartupSignals()) {
+      return SignalHandler::ERROR;
+    }
     return SignalHandler::NEEDS_REFRESH;
   }
 
-  if (!writer_->Write(msg)) {
-    auto status = writer_->FinishNow();
-    if (!status.ok()) {
-      CLOG(ERROR) << "GRPC writes failed: " << status.error_message();
-    }
-    writer_.reset();
-
-    stream_active_.store(false, std::memory_order_release);
-    CLOG(ERROR) << "GRPC stream interrupted";
-    stream_interrupted_.notify_one();
+  if (!WriteSignal(msg)) {
     return SignalHandler::ERROR;
   }
 
   return SignalHandler::PROCESSED;
 }
 
+SignalHandler::Result SignalServiceClient::BufferStartupSignal(const SignalStreamMessage& msg) {
+  if (startup_signals_.size() >= kMaxStartupSignals) {
+    CLOG_THROTTLED(WARNING, std::chrono::seconds(10))
+        << "GRPC stream is not established yet and the startup buffer is full, dropping signal";
+    return SignalHandler::ERROR;
+  }
+
+  startup_signals_.push_back(msg);
+  return SignalHandler::IGNORED;
+}
+
+bool SignalServiceClient::FlushStartupSignals() {
+  buffer_startup_signals_ = false;
+
+  if (!startup_signals_.empty()) {
+    CLOG(INFO) << "Sending " << startup_signals_.size() << " signals observed before the GRPC stream was established";
+  }
+
+  while (!startup_signals_.empty()) {
+    if (!WriteSignal(startup_signals_.front())) {
+      startup_signals_.clear();
+      return false;
+    }
+    startup_signals_.pop_front();
+  }
+
+  return true;
+}
+
+bool SignalServiceClient::WriteSignal(const SignalStreamMessage& msg) {
+  if (writer_->Write(msg)) {
+    return true;
+  }
+
+  auto status = writer_->FinishNow();
+  if (!status.ok()) {
+    CLOG(ERROR) << "GRPC writes failed: " << status.error_message();
+  }
+  writer_.reset();
+
+  stream_active_.store(false, std::memory_order_release);
+  CLOG(ERROR) << "GRPC stream interrupted";
+  stream_interrupted_.notify_one();
+  return false;
+}
+
 SignalHandler::Result StdoutSignalServiceClient::PushSignals(const SignalStreamMessage& msg) {
   std::string output;
   google::protobuf::util::MessageToJsonString(msg, &output, google::protobuf::util::JsonPrintOptions{});
@@ -4,6 +4,7 @@
 // SIGNAL_SERVICE_CLIENT.h
 // This class defines our GRPC client abstraction
 
+#include <deque>
 #include <mutex>
 
 #include <grpc/grpc.h>
@@ -35,6 +36,9 @@ class SignalServiceClient : public ISignalServiceClient {
   using SignalService = sensor::SignalService;
   using SignalStreamMessage = sensor::SignalStreamMessage;
 
+  // Maximum number of signals kept while waiting for the first stream to be established.
+  static constexpr size_t kMaxStartupSignals = 1024;
+
   explicit SignalServiceClient(std::shared_ptr<grpc::Channel> channel)
       : channel_(std::move(channel)), stream_active_(false) {}
 
@@ -46,6 +50,9 @@ class SignalServiceClient : public ISignalServiceClient {
  private:
   void EstablishGRPCStream();
   bool EstablishGRPCStreamSingle();
+  SignalHandler::Result BufferStartupSignal(const SignalStreamMessage& msg);
+  bool FlushStartupSignals();
+  bool WriteSignal(const SignalStreamMessage& msg);
 
   std::shared_ptr<grpc::Channel> channel_;
 
@@ -58,6 +65,11 @@ class SignalServiceClient : public ISignalServiceClient {
   std::unique_ptr<IDuplexClientWriter<SignalStreamMessage>> writer_;
 
   bool first_write_;
+
+  // Signals pushed before the stream was established for the first time. Only
+  // accessed from the thread calling PushSignals.
+  bool buffer_startup_signals_ = true;
+  std::deque<SignalStreamMessage> startup_signals_;
 };
 
 class StdoutSignalServiceClient : public ISignalServiceClient {
@@ -32,7 +32,7 @@ constexpr char SysdigService::kModuleName[];
 constexpr char SysdigService::kProbePath[];
 constexpr char SysdigService::kProbeName[];
 
-void SysdigService::Init(const CollectorConfig& config, std::shared_ptr<ConnectionTracker> conn_tracker) {
+void SysdigService::Init(const CollectorConfig& config, std::shared_ptr<ConnectionTracker> conn_tracker, std::shared_ptr<ProcessStore> process_store) {
   // The self-check handlers should only operate during start up,
   // so they are added to the handler list first, so they have access
   // to self-check events before the network and process handlers have
@@ -44,6 +44,8 @@ void SysdigService::Init(const CollectorConfig& config, std::shared_ptr<Connecti
     auto network_signal_handler_ = MakeUnique<NetworkSignalHandler>(inspector_.get(), conn_tracker, &userspace_stats_);
 
     network_signal_handler_->SetCollectConnectionStatus(config.CollectConnectionStatus());
+    network_signal_handler_->SetNumWorkers(config.GetNetworkEventWorkers());
+    network_signal_handler_->SetTrackListenEndpoints(config.TrackListenEndpoints(), std::move(process_store));
 
     AddSignalHandler(std::move(network_signal_handler_));
   }
@@ -79,6 +81,10 @@ bool SysdigService::InitKernel(const CollectorConfig& config, const DriverCandid
     inspector_->set_import_users(config.ImportUsers());
     inspector_->set_thread_timeout_s(30);
     inspector_->set_thread_purge_interval_s(60);
+    // The containers without threads are removed by this sweep, which is
+    // what closes their connections (see NetworkSignalHandler).
+    inspector_->set_auto_containers_purging(true);
+    inspector_->set_auto_containers_purging_interval_s(60);
     inspector_->m_thread_manager->set_max_thread_table_size(config.GetSinspThreadCacheSize());
 
     // Connection status tracking is used in NetworkSignalHandler,
@@ -114,7 +120,6 @@ bool SysdigService::InitKernel(const CollectorConfig& config, const DriverCandid
 }
 
 sinsp_evt* SysdigService::GetNext() {
-  std::lock_guard<std::mutex> lock(libsinsp_mutex_);
   sinsp_evt* event = nullptr;
 
   auto parse_start = NowMicros();
@@ -186,8 +191,6 @@ bool SysdigService::FilterEvent(const sinsp_threadinfo* tinfo) {
 }
 
 void SysdigService::Start() {
-  std::lock_guard<std::mutex> libsinsp_lock(libsinsp_mutex_);
-
   if (!inspector_) {
     throw CollectorException("Invalid state: SysdigService was not initialized");
   }
@@ -199,6 +202,7 @@ void SysdigService::Start() {
   }
 
   inspector_->start_capture();
+  STARTUP_PHASE_BEGIN(CollectorStats::first_event);
 
   // trigger the self check process only once capture has started,
   // to verify the driver is working correctly. SelfCheckHandlers will
@@ -206,8 +210,8 @@ void SysdigService::Start() {
   std::thread self_checks_thread(self_checks::start_self_check_process);
   self_checks_thread.detach();
 
-  std::lock_guard<std::mutex> running_lock(running_mutex_);
   running_ = true;
+  PublishStats(NowMicros());
 }
 
 void LogUnreasonableEventTime(int64_t time_micros, sinsp_evt* evt) {
@@ -236,9 +240,19 @@ void SysdigService::Run(const std::atomic<ControlValue>& control) {
   while (control.load(std::memory_order_relaxed) == ControlValue::RUN) {
     ServePendingProcessRequests();
 
+    int64_t now_micros = NowMicros();
+    if (now_micros >= next_stats_publish_micros_) {
+      PublishStats(now_micros);
+    }
+
     sinsp_evt* evt = GetNext();
     if (!evt) continue;
 
+    if (!first_event_seen_) {
+      STARTUP_PHASE_END(CollectorStats::first_event);
+      first_event_seen_ = true;
+    }
+
     auto process_start = NowMicros();
     for (auto it = signal_handlers_.begin(); it != signal_handlers_.end(); it++) {
       auto& signal_handler = *it;
@@ -266,7 +280,7 @@ void SysdigService::Run(const std::atomic<ControlValue>& control) {
 }
 
 bool SysdigService::SendExistingProcesses(SignalHandler* handler) {
-  std::lock_guard<std::mutex> lock(libsinsp_mutex_);
+  SCOPED_TIMER(CollectorStats::process_existing_snapshot);
 
   if (!inspector_) {
     throw CollectorException("Invalid state: SysdigService was not initialized");
@@ -292,8 +306,6 @@ bool SysdigService::SendExistingProcesses(SignalHandler* handler) {
 }
 
 void SysdigService::CleanUp() {
-  std::lock_guard<std::mutex> libsinsp_lock(libsinsp_mutex_);
-  std::lock_guard<std::mutex> running_lock(running_mutex_);
   running_ = false;
   inspector_->close();
   inspector_.reset();
@@ -307,7 +319,7 @@ void SysdigService::CleanUp() {
   signal_handlers_.clear();
 
   // Cancel all pending process requests
-  std::lock_guard<std::mutex> lock(process_requests_mutex_);
+  std::lock_guard<ProfiledMutex> lock(process_requests_mutex_);
 
   while (!pending_process_requests_.empty()) {
     auto& request = pending_process_requests_.front();
@@ -319,20 +331,35 @@ void SysdigService::CleanUp() {
   }
 }
 
-bool SysdigService::GetStats(SysdigStats* stats) const {
-  std::lock_guard<std::mutex> libsinsp_lock(libsinsp_mutex_);
-  std::lock_guard<std::mutex> running_lock(running_mutex_);
-  if (!running_ || !inspector_) return false;
+void SysdigService::PublishStats(int64_t now_micros) {
+  SysdigStats stats = userspace_stats_;
 
   scap_stats kernel_stats;
   inspector_->get_capture_stats(&kernel_stats);
-  *stats = userspace_stats_;
-  stats->nEvents = kernel_stats.n_evts;
-  stats->nDrops = kernel_stats.n_drops;
-  stats->nPreemptions = kernel_stats.n_preemptions;
-  stats->nThreadCacheSize = inspector_->m_thread_manager->get_thread_count();
+  stats.nEvents = kernel_stats.n_evts;
+  stats.nDrops = kernel_stats.n_drops;
+  stats.nPreemptions = kernel_stats.n_preemptions;
+  stats.nThreadCacheSize = inspector_->m_thread_manager->get_thread_count();
+  thread_table_size_ = stats.nThreadCacheSize;
+
+  // If a reader is still copying the snapshot to be overwritten, retry on
+  // the next event.
+  if (published_stats_.Publish(stats)) {
+    next_stats_publish_micros_ = now_micros + kStatsPublishIntervalMicros;
+  }
+}
 
-  return true;
+bool SysdigService::GetStats(SysdigStats* stats) const {
+  if (!running_) return false;
+
+  return published_stats_.Read(stats);
+}
+
+MemoryUsage SysdigService::GetThreadTableMemoryUsage() const {
+  MemoryUsage usage;
+  usage.entries = thread_table_size_;
+  usage.bytes = usage.entries * sizeof(sinsp_threadinfo);
+  return usage;
 }
 
 void SysdigService::AddSignalHandler(std::unique_ptr<SignalHandler> signal_handler) {
@@ -354,13 +381,13 @@ void SysdigService::AddSignalHandler(std::unique_ptr<SignalHandler> signal_handl
 }
 
 void SysdigService::GetProcessInformation(uint64_t pid, ProcessInfoCallbackRef callback) {
-  std::lock_guard<std::mutex> lock(process_requests_mutex_);
+  std::lock_guard<ProfiledMutex> lock(process_requests_mutex_);
 
   pending_process_requests_.emplace_back(pid, callback);
 }
 
 void SysdigService::ServePendingProcessRequests() {
-  std::lock_guard<std::mutex> lock(process_requests_mutex_);
+  std::lock_guard<ProfiledMutex> lock(process_requests_mutex_);
 
   while (!pending_process_requests_.empty()) {
     auto& request = pending_process_requests_.front();
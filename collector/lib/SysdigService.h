@@ -12,7 +12,11 @@
 #include "libsinsp/sinsp.h"
 
 #include "Control.h"
+#include "DoubleBuffer.h"
 #include "DriverCandidates.h"
+#include "MemoryAccounting.h"
+#include "Process.h"
+#include "ProfiledMutex.h"
 #include "SignalHandler.h"
 #include "SignalServiceClient.h"
 #include "Sysdig.h"
@@ -31,7 +35,12 @@ class SysdigService : public Sysdig {
 
   SysdigService() = default;
 
-  void Init(const CollectorConfig& config, std::shared_ptr<ConnectionTracker> conn_tracker) override;
+  void Init(const CollectorConfig& config, std::shared_ptr<ConnectionTracker> conn_tracker) override {
+    Init(config, std::move(conn_tracker), nullptr);
+  }
+  // process_store, when provided, is used to link the originator process of
+  // listen endpoints reported by kernel events.
+  void Init(const CollectorConfig& config, std::shared_ptr<ConnectionTracker> conn_tracker, std::shared_ptr<ProcessStore> process_store);
   void Start() override;
   void Run(const std::atomic<ControlValue>& control) override;
   void CleanUp() override;
@@ -67,7 +76,14 @@ class SysdigService : public Sysdig {
 
   void AddSignalHandler(std::unique_ptr<SignalHandler> signal_handler);
 
-  mutable std::mutex libsinsp_mutex_;
+  // Publishes the statistics, including those read from the inspector, every
+  // kStatsPublishIntervalMicros.
+  static constexpr int64_t kStatsPublishIntervalMicros = 1000000;
+  void PublishStats(int64_t now_micros);
+
+  // The inspector is only used by the thread running the event loop. Other
+  // threads get the statistics from the last published snapshot, and process
+  // information through requests served by the event loop.
   std::unique_ptr<sinsp> inspector_;
   std::unique_ptr<sinsp_evt_formatter> default_formatter_;
   std::unique_ptr<ISignalServiceClient> signal_client_;
@@ -75,13 +91,23 @@ class SysdigService : public Sysdig {
   SysdigStats userspace_stats_;
   std::bitset<PPM_EVENT_MAX> global_event_filter_;
 
-  mutable std::mutex running_mutex_;
-  bool running_ = false;
+  std::atomic<bool> running_ = false;
+  bool first_event_seen_ = false;
+
+  DoubleBuffer<SysdigStats> published_stats_;
+  int64_t next_stats_publish_micros_ = 0;
+  std::atomic<uint64_t> thread_table_size_ = 0;
 
   void ServePendingProcessRequests();
-  mutable std::mutex process_requests_mutex_;
+  mutable ProfiledMutex process_requests_mutex_{CollectorStats::lock_sysdig_process_requests};
   // [ ( pid, callback ), ( pid, callback ), ... ]
   std::list<std::pair<uint64_t, ProcessInfoCallbackRef>> pending_process_requests_;
+
+  // Approximate memory used by the thread table, which holds up to the configured thread cache size entries, as of the
+  // last published statistics.
+  MemoryUsage GetThreadTableMemoryUsage() const;
+  MemoryAccounting::Registration thread_table_memory_ = MemoryAccounting::GetOrCreate().Register(
+      "sinsp_thread_table", [this] { return GetThreadTableMemoryUsage(); });
 };
 
 }  // namespace collector
@@ -0,0 +1,219 @@
+#include "ThreadPlacement.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "FileSystem.h"
+#include "Logging.h"
+#include "Utility.h"
+
+namespace collector {
+
+namespace {
+
+struct Placement {
+  // Affinity of the process when configured, restored for the threads which
+  // are not pinned, as they may be started from a pinned one.
+  bool has_process_cpus = false;
+  cpu_set_t process_cpus;
+  bool pin_event_loop = false;
+  cpu_set_t event_loop_cpus;
+  bool pin_network = false;
+  cpu_set_t network_cpus;
+  int background_nice = 0;
+  int background_policy = SCHED_OTHER;
+};
+
+// Written once by Configure, before the threads reading it are started.
+Placement g_placement;
+
+bool ParseCPURange(std::string_view range, cpu_set_t* cpus) {
+  unsigned long first, last;
+  std::string str(range);
+  char* end;
+
+  first = last = std::strtoul(str.c_str(), &end, 10);
+  if (end == str.c_str()) {
+    return false;
+  }
+  if (*end == '-') {
+    const char* start = end + 1;
+    last = std::strtoul(start, &end, 10);
+    if (end == start) {
+      return false;
+    }
+  }
+  if (*end != '\0' || first > last || last >= CPU_SETSIZE) {
+    return false;
+  }
+
+  for (unsigned long cpu = first; cpu <= last; cpu++) {
+    CPU_SET(cpu, cpus);
+  }
+  return true;
+}
+
+bool ParseCPUListOrLog(const std::string& list, const char* role, cpu_set_t* cpus) {
+  if (!ThreadPlacement::ParseCPUList(list, cpus)) {
+    CLOG(ERROR) << "Invalid CPU list for " << role << " threads: '" << list << "'";
+    return false;
+  }
+  CLOG(INFO) << "Pinning " << role << " threads to CPUs " << list;
+  return true;
+}
+
+}  // namespace
+
+bool ThreadPlacement::ParseCPUList(std::string_view list, cpu_set_t* cpus, const std::string& sysfs_node_dir) {
+  CPU_ZERO(cpus);
+
+  while (!list.empty()) {
+    auto comma = list.find(',');
+    std::string_view item = list.substr(0, comma);
+    list.remove_prefix(comma == std::string_view::npos ? list.size() : comma + 1);
+
+    if (item.substr(0, 4) == "node") {
+      std::string node(item.substr(4));
+      if (node.empty() || node.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+      }
+
+      std::ifstream file(sysfs_node_dir + "/node" + node + "/cpulist");
+      std::string node_cpus;
+      if (!file || !std::getline(file, node_cpus)) {
+        return false;
+      }
+
+      cpu_set_t node_set;
+      if (!ParseCPUList(node_cpus, &node_set, sysfs_node_dir)) {
+        return false;
+      }
+      CPU_OR(cpus, cpus, &node_set);
+    } else if (!ParseCPURange(item, cpus)) {
+      return false;
+    }
+  }
+
+  return CPU_COUNT(cpus) > 0;
+}
+
+void ThreadPlacement::Configure(const ThreadPlacementConfig& config) {
+  Placement placement;
+
+  if (sched_getaffinity(0, sizeof(placement.process_cpus), &placement.process_cpus) == 0) {
+    placement.has_process_cpus = true;
+  } else {
+    CLOG(WARNING) << "Failed to get the CPU affinity of the process: " << StrError();
+  }
+
+  if (!config.event_loop_cpus.empty()) {
+    placement.pin_event_loop = ParseCPUListOrLog(config.event_loop_cpus, "event loop", &placement.event_loop_cpus);
+  }
+  if (!config.network_cpus.empty()) {
+    placement.pin_network = ParseCPUListOrLog(config.network_cpus, "network", &placement.network_cpus);
+  }
+
+  placement.background_nice = config.background_nice;
+  if (config.background_policy == "batch") {
+    placement.background_policy = SCHED_BATCH;
+  } else if (config.background_policy == "idle") {
+    placement.background_policy = SCHED_IDLE;
+  } else if (!config.background_policy.empty() && config.background_policy != "other") {
+    CLOG(ERROR) << "Invalid scheduling policy for background threads: '" << config.background_policy << "'";
+  }
+
+  g_placement = placement;
+}
+
+void ThreadPlacement::Apply(const char* name, ThreadRole role) {
+  if (name && prctl(PR_SET_NAME, name, 0, 0, 0) != 0) {
+    CLOG(WARNING) << "Failed to set the name of thread " << name << ": " << StrError();
+  }
+
+  const cpu_set_t* process_cpus = g_placement.has_process_cpus ? &g_placement.process_cpus : nullptr;
+  const cpu_set_t* cpus = nullptr;
+  switch (role) {
+    case ThreadRole::EVENT_LOOP:
+      cpus = g_placement.pin_event_loop ? &g_placement.event_loop_cpus : nullptr;
+      break;
+    case ThreadRole::NETWORK:
+      cpus = g_placement.pin_network ? &g_placement.network_cpus : process_cpus;
+      break;
+    case ThreadRole::BACKGROUND: {
+      cpus = process_cpus;
+      // Both apply to the calling thread only.
+      if (g_placement.background_policy != SCHED_OTHER) {
+        struct sched_param param = {};
+        if (sched_setscheduler(0, g_placement.background_policy, &param) != 0) {
+          CLOG(WARNING) << "Failed to set the scheduling policy of thread " << (name ? name : "") << ": " << StrError();
+        }
+      }
+      if (g_placement.background_nice != 0 &&
+          setpriority(PRIO_PROCESS, syscall(SYS_gettid), g_placement.background_nice) != 0) {
+        CLOG(WARNING) << "Failed to set the nice value of thread " << (name ? name : "") << ": " << StrError();
+      }
+      break;
+    }
+  }
+
+  if (cpus && sched_setaffinity(0, sizeof(*cpus), cpus) != 0) {
+    CLOG(WARNING) << "Failed to set the CPU affinity of thread " << (name ? name : "") << ": " << StrError();
+  }
+}
+
+bool ReadThreadCPUUsage(std::vector<ThreadCPUUsage>* usage, const std::string& task_dir) {
+  DirHandle dir = opendir(task_dir.c_str());
+  if (!dir.valid()) {
+    return false;
+  }
+
+  static const double ticks_per_second = sysconf(_SC_CLK_TCK);
+
+  usage->clear();
+  while (struct dirent* entry = dir.read()) {
+    if (entry->d_name[0] < '0' || entry->d_name[0] > '9') {
+      continue;
+    }
+
+    std::ifstream file(task_dir + "/" + entry->d_name + "/stat");
+    std::string stat;
+    if (!file || !std::getline(file, stat)) {
+      // The thread exited.
+      continue;
+    }
+
+    // The name is enclosed in parentheses, and may contain any character.
+    auto open = stat.find('(');
+    auto close = stat.rfind(')');
+    if (open == std::string::npos || close == std::string::npos || close < open) {
+      continue;
+    }
+
+    // utime and stime are the 14th and 15th fields, the name being the 2nd.
+    std::istringstream fields(stat.substr(close + 1));
+    std::string skipped;
+    for (int i = 3; i < 14; i++) {
+      fields >> skipped;
+    }
+    unsigned long utime, stime;
+    if (!(fields >> utime >> stime)) {
+      continue;
+    }
+
+    usage->push_back({static_cast<pid_t>(std::atoi(entry->d_name)),
+                      stat.substr(open + 1, close - open - 1),
+                      utime / ticks_per_second,
+                      stime / ticks_per_second});
+  }
+
+  return true;
+}
+
+}  // namespace collector
@@ -0,0 +1,61 @@
+#ifndef COLLECTOR_THREADPLACEMENT_H
+#define COLLECTOR_THREADPLACEMENT_H
+
+#include <sched.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace collector {
+
+// Role of a collector thread, which determines where and how it is scheduled.
+enum class ThreadRole {
+  EVENT_LOOP,  // the sinsp consumer
+  NETWORK,     // the network status notifier and connection tracker workers
+  BACKGROUND,  // everything else: exporting stats, sending processes, etc.
+};
+
+struct ThreadPlacementConfig {
+  // CPU lists the threads of a role are pinned to, in the cpuset list format
+  // (e.g., "0-3,8"), where "nodeN" stands for the CPUs of NUMA node N. Empty
+  // means the threads are not pinned.
+  std::string event_loop_cpus;
+  std::string network_cpus;
+
+  // Nice value, and scheduling policy ("batch" or "idle"), of background
+  // threads. Empty means the default policy.
+  int background_nice = 0;
+  std::string background_policy;
+};
+
+class ThreadPlacement {
+ public:
+  // Sets the placement of the threads applying it afterwards. Expected to be
+  // called once at startup, before any thread is started, as the affinity of
+  // the calling thread is restored for the threads which are not pinned.
+  static void Configure(const ThreadPlacementConfig& config);
+
+  // Names the calling thread, if name is not null, and applies the placement
+  // configured for its role. Names are truncated to 15 characters.
+  static void Apply(const char* name, ThreadRole role);
+
+  // Parses a CPU list, with NUMA nodes resolved from sysfs_node_dir.
+  static bool ParseCPUList(std::string_view list, cpu_set_t* cpus,
+                           const std::string& sysfs_node_dir = "/sys/devices/system/node");
+};
+
+struct ThreadCPUUsage {
+  pid_t tid;
+  std::string name;
+  double user_seconds;
+  double system_seconds;
+};
+
+// Reads the CPU time used by each thread of the process.
+bool ReadThreadCPUUsage(std::vector<ThreadCPUUsage>* usage, const std::string& task_dir = "/proc/self/task");
+
+}  // namespace collector
+
+#endif  // COLLECTOR_THREADPLACEMENT_H
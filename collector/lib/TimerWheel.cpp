@@ -0,0 +1,104 @@
+#include "TimerWheel.h"
+
+namespace collector {
+
+void TimerWheel::Add(uint64_t id, int64_t deadline) {
+  Insert({id, deadline});
+  size_++;
+}
+
+void TimerWheel::Insert(const Timer& timer) {
+  int64_t delta = timer.deadline - current_;
+  if (delta <= 0) {
+    due_.push_back(timer);
+    return;
+  }
+
+  int level = 0;
+  while (level < kLevels - 1 && delta >= (int64_t(1) << (kSlotBits * (level + 1)))) {
+    level++;
+  }
+
+  // Timers beyond the range of the wheel are parked in the slot of the last
+  // level furthest away, and reinserted when that slot is cascaded.
+  int64_t slot_tick = timer.deadline;
+  if (delta >= (int64_t(1) << (kSlotBits * kLevels))) {
+    slot_tick = current_ + (int64_t(kSlots - 1) << (kSlotBits * level));
+  }
+
+  levels_[level][(slot_tick >> (kSlotBits * level)) & (kSlots - 1)].push_back(timer);
+}
+
+void TimerWheel::Cascade(int level) {
+  Slot slot;
+  slot.swap(levels_[level][(current_ >> (kSlotBits * level)) & (kSlots - 1)]);
+  for (const auto& timer : slot) {
+    Insert(timer);
+  }
+}
+
+void TimerWheel::Advance(int64_t now, std::vector<uint64_t>* expired) {
+  for (;;) {
+    for (const auto& timer : due_) {
+      expired->push_back(timer.id);
+    }
+    size_ -= due_.size();
+    due_.clear();
+
+    if (current_ >= now) {
+      break;
+    }
+
+    // Skip the ticks with nothing to expire nor cascade.
+    int64_t next = NextExpiry();
+    if (next < 0 || next > now) {
+      current_ = now;
+      break;
+    }
+    current_ = next;
+
+    // Higher levels first, so that timers cascading down into the current
+    // slot of a lower level are cascaded again.
+    int wrapped = 0;
+    while (wrapped < kLevels - 1 && (current_ & ((int64_t(1) << (kSlotBits * (wrapped + 1))) - 1)) == 0) {
+      wrapped++;
+    }
+    for (int level = wrapped; level > 0; level--) {
+      Cascade(level);
+    }
+
+    Slot& slot = levels_[0][current_ & (kSlots - 1)];
+    due_.insert(due_.end(), slot.begin(), slot.end());
+    slot.clear();
+  }
+}
+
+int64_t TimerWheel::NextExpiry() const {
+  if (size_ == 0) {
+    return -1;
+  }
+  if (!due_.empty()) {
+    return current_;
+  }
+
+  // The first occupied slot of each level is where it has to be looked at
+  // next. Slots of a level which come after a wrap may start later than those
+  // of the next level, hence the minimum across levels.
+  int64_t next = -1;
+  for (int level = 0; level < kLevels; level++) {
+    int shift = kSlotBits * level;
+    int64_t index = current_ >> shift;
+    for (int64_t i = 1; i <= kSlots; i++) {
+      if (!levels_[level][(index + i) & (kSlots - 1)].empty()) {
+        int64_t tick = (index + i) << shift;
+        if (next < 0 || tick < next) {
+          next = tick;
+        }
+        break;
+      }
+    }
+  }
+  return next;
+}
+
+}  // namespace collector
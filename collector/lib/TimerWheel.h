@@ -0,0 +1,60 @@
+#ifndef COLLECTOR_TIMERWHEEL_H
+#define COLLECTOR_TIMERWHEEL_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace collector {
+
+// Hierarchical timer wheel, keeping timers with a deadline expressed in ticks.
+// Each level has 64 slots, each slot of level L spanning 64^L ticks. Timers are
+// stored in the lowest level able to hold them, and moved down to lower levels
+// as the wheel turns, making adding and expiring timers O(1).
+//
+// Timers cannot be removed, owners are expected to ignore timers which are no
+// longer relevant when they expire. This class is not thread-safe.
+class TimerWheel {
+ public:
+  static constexpr int kSlotBits = 6;
+  static constexpr int kSlots = 1 << kSlotBits;
+  static constexpr int kLevels = 4;
+
+  explicit TimerWheel(int64_t now) : current_(now) {}
+
+  // Adds a timer expiring at the given tick. Timers with a deadline in the past
+  // expire on the next call to Advance.
+  void Add(uint64_t id, int64_t deadline);
+
+  // Turns the wheel up to the given tick, and appends the IDs of the timers
+  // which expired to expired.
+  void Advance(int64_t now, std::vector<uint64_t>* expired);
+
+  // Returns the tick at which the wheel has to be advanced next, which is not
+  // later than the deadline of the first timer to expire, or -1 if there are
+  // no timers.
+  int64_t NextExpiry() const;
+
+  int64_t current() const { return current_; }
+  size_t size() const { return size_; }
+
+ private:
+  struct Timer {
+    uint64_t id;
+    int64_t deadline;
+  };
+
+  using Slot = std::vector<Timer>;
+
+  void Insert(const Timer& timer);
+  void Cascade(int level);
+
+  int64_t current_;
+  size_t size_ = 0;
+  std::vector<Timer> due_;
+  std::array<std::array<Slot, kSlots>, kLevels> levels_;
+};
+
+}  // namespace collector
+
+#endif  // COLLECTOR_TIMERWHEEL_H
@@ -0,0 +1,89 @@
+#ifndef COLLECTOR_TEST_ALLOCATIONCOUNTER_H
+#define COLLECTOR_TEST_ALLOCATIONCOUNTER_H
+
+// Counts the heap allocations made by a test binary, to check the allocation
+// budget of hot paths. It replaces the global operator new and delete, so it
+// must be included by a single source file, i.e., a single test.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace collector {
+namespace test {
+
+inline std::atomic<bool> count_allocations(false);
+inline std::atomic<size_t> num_allocations(0);
+
+inline void* CountedAlloc(size_t size) {
+  if (count_allocations.load(std::memory_order_relaxed)) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  return std::malloc(size ? size : 1);
+}
+
+// Returns the number of allocations made by fn, on any thread.
+template <typename Fn>
+size_t CountAllocations(Fn&& fn) {
+  num_allocations = 0;
+  count_allocations = true;
+  fn();
+  count_allocations = false;
+  return num_allocations;
+}
+
+}  // namespace test
+}  // namespace collector
+
+void* operator new(size_t size) {
+  void* ptr = collector::test::CountedAlloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  void* ptr = collector::test::CountedAlloc(size);
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return collector::test::CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return collector::test::CountedAlloc(size);
+}
+
+// GCC warns about free being called on memory from operator new, once both
+// are inlined, but the replacement operator new allocates with malloc.
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC diagnostic pop
+#endif
+
+#endif  // COLLECTOR_TEST_ALLOCATIONCOUNTER_H
@@ -0,0 +1,144 @@
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "CPUBudget.h"
+#include "CollectorStats.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+// Creates a fake proc root whose self/cgroup file has the given contents.
+std::string MakeProcRoot(const std::string& name, const std::string& cgroup) {
+  std::string root = testing::TempDir() + name;
+  mkdir(root.c_str(), 0755);
+  mkdir((root + "/self").c_str(), 0755);
+  std::ofstream(root + "/self/cgroup") << cgroup;
+  return root;
+}
+
+std::string MakeDir(const std::string& path) {
+  mkdir(path.c_str(), 0755);
+  return path;
+}
+
+TEST(CPUBudgetTest, TestReadV2) {
+  std::string proc_root = MakeProcRoot("cpu_budget_v2_proc", "0::/pod/collector\n");
+  std::string cgroup_root = MakeDir(testing::TempDir() + "cpu_budget_v2_cgroup");
+  MakeDir(cgroup_root + "/pod");
+  std::string dir = MakeDir(cgroup_root + "/pod/collector");
+  std::ofstream(dir + "/cpu.stat") << "usage_usec 1000\nnr_periods 50\nnr_throttled 7\nthrottled_usec 12345\n";
+  std::ofstream(dir + "/cpu.max") << "50000 100000\n";
+
+  CgroupCPUReader reader(proc_root, cgroup_root);
+  EXPECT_EQ(reader.cgroup_dir(), dir);
+  EXPECT_TRUE(reader.IsV2());
+
+  CgroupCPUStat stat;
+  ASSERT_TRUE(reader.Read(&stat));
+  EXPECT_EQ(stat.nr_periods, 50);
+  EXPECT_EQ(stat.nr_throttled, 7);
+  EXPECT_EQ(stat.throttled_usec, 12345);
+  EXPECT_EQ(stat.quota_usec, 50000);
+  EXPECT_EQ(stat.period_usec, 100000);
+
+  std::ofstream(dir + "/cpu.max") << "max 20000\n";
+  ASSERT_TRUE(reader.Read(&stat));
+  EXPECT_EQ(stat.quota_usec, -1);
+  EXPECT_EQ(stat.period_usec, 20000);
+}
+
+TEST(CPUBudgetTest, TestReadV1Namespaced) {
+  // Within a cgroup namespace, the path does not exist under the mount point.
+  std::string proc_root = MakeProcRoot("cpu_budget_v1_proc", "12:memory:/kubepods/pod\n4:cpu,cpuacct:/kubepods/pod\n");
+  std::string cgroup_root = MakeDir(testing::TempDir() + "cpu_budget_v1_cgroup");
+  std::string dir = MakeDir(cgroup_root + "/cpu,cpuacct");
+  std::ofstream(dir + "/cpu.stat") << "nr_periods 10\nnr_throttled 3\nthrottled_time 5000000\n";
+  std::ofstream(dir + "/cpu.cfs_quota_us") << "-1\n";
+  std::ofstream(dir + "/cpu.cfs_period_us") << "100000\n";
+
+  CgroupCPUReader reader(proc_root, cgroup_root);
+  EXPECT_EQ(reader.cgroup_dir(), dir);
+  EXPECT_FALSE(reader.IsV2());
+
+  CgroupCPUStat stat;
+  ASSERT_TRUE(reader.Read(&stat));
+  EXPECT_EQ(stat.nr_periods, 10);
+  EXPECT_EQ(stat.nr_throttled, 3);
+  EXPECT_EQ(stat.throttled_usec, 5000);
+  EXPECT_EQ(stat.quota_usec, -1);
+}
+
+TEST(CPUBudgetTest, TestReadMissing) {
+  CgroupCPUReader reader(testing::TempDir() + "cpu_budget_nonexistent", "/nonexistent");
+  EXPECT_TRUE(reader.cgroup_dir().empty());
+
+  CgroupCPUStat stat;
+  EXPECT_FALSE(reader.Read(&stat));
+}
+
+TEST(CPUBudgetTest, TestThrottled) {
+  CPUBudget budget;
+  CgroupCPUStat stat;
+  stat.nr_throttled = 10;
+  stat.period_usec = 50000;
+
+  // The first sample only sets the baseline.
+  budget.Update(stat);
+  EXPECT_FALSE(budget.Throttled());
+  EXPECT_EQ(budget.Period(), std::chrono::microseconds(50000));
+
+  stat.nr_throttled = 11;
+  budget.Update(stat);
+  EXPECT_TRUE(budget.Throttled());
+
+  for (int i = 0; i < CPUBudget::kHoldSamples - 1; i++) {
+    budget.Update(stat);
+    EXPECT_TRUE(budget.Throttled());
+  }
+  budget.Update(stat);
+  EXPECT_FALSE(budget.Throttled());
+}
+
+TEST(CPUBudgetTest, TestPacer) {
+  CPUBudget budget;
+  CgroupCPUStat stat;
+  stat.period_usec = 10000;
+  budget.Update(stat);
+
+  // Not throttled, never pauses.
+  auto start = std::chrono::steady_clock::now();
+  CPUPacer idle(&budget, start + std::chrono::seconds(10));
+  std::this_thread::sleep_for(CPUPacer::kSlice);
+  idle.Pace();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+
+  stat.nr_throttled = 1;
+  budget.Update(stat);
+  ASSERT_TRUE(budget.Throttled());
+
+  start = std::chrono::steady_clock::now();
+  CPUPacer pacer(&budget, start + std::chrono::seconds(10));
+  std::this_thread::sleep_for(CPUPacer::kSlice);
+  pacer.Pace();
+  EXPECT_GE(std::chrono::steady_clock::now() - start, CPUPacer::kSlice + std::chrono::milliseconds(10));
+  EXPECT_GE(CollectorStats::GetOrCreate().GetCounter(CollectorStats::cpu_budget_paced_usec), 10000);
+
+  // Past the deadline, work is no longer paced.
+  CPUPacer late(&budget, std::chrono::steady_clock::now());
+  std::this_thread::sleep_for(CPUPacer::kSlice);
+  int64_t paced = CollectorStats::GetOrCreate().GetCounter(CollectorStats::cpu_budget_paced_usec);
+  late.Pace();
+  EXPECT_EQ(CollectorStats::GetOrCreate().GetCounter(CollectorStats::cpu_budget_paced_usec), paced);
+
+  CollectorStats::Reset();
+}
+
+}  // namespace
+
+}  // namespace collector
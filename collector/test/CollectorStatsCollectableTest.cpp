@@ -0,0 +1,146 @@
+#include <chrono>
+#include <iostream>
+
+#include "CollectorStats.h"
+#include "CollectorStatsCollectable.h"
+#include "Sysdig.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using EventType = CollectorStatsCollectable::EventType;
+
+const prometheus::MetricFamily* FindFamily(const std::vector<prometheus::MetricFamily>& families, const std::string& name) {
+  for (const auto& family : families) {
+    if (family.name == name) {
+      return &family;
+    }
+  }
+  return nullptr;
+}
+
+std::string Label(const prometheus::ClientMetric& metric, const std::string& name) {
+  for (const auto& label : metric.label) {
+    if (label.name == name) {
+      return label.value;
+    }
+  }
+  return "";
+}
+
+TEST(CollectorStatsCollectableTest, TestSparseEvents) {
+  SysdigStats stats;
+  CollectorStatsCollectable collectable(
+      [&stats](SysdigStats* out) {
+        *out = stats;
+        return true;
+      },
+      {{10, "open", ">"}, {11, "open", "<"}, {20, "read", ">"}});
+
+  // No event type seen so far.
+  auto families = collectable.Collect();
+  EXPECT_EQ(FindFamily(families, "rox_collector_events_typed"), nullptr);
+
+  stats.nUserspaceEvents[11] = 4;
+  stats.nFilteredEvents[11] = 2;
+  stats.event_parse_micros[11] = 40;
+  stats.event_process_micros[11] = 10;
+  stats.nUserspaceEvents[30] = 100;  // not configured
+  families = collectable.Collect();
+
+  auto* counts = FindFamily(families, "rox_collector_events_typed");
+  ASSERT_NE(counts, nullptr);
+  ASSERT_EQ(counts->metric.size(), 1);
+  EXPECT_EQ(Label(counts->metric[0], "event_type"), "open");
+  EXPECT_EQ(Label(counts->metric[0], "event_dir"), "<");
+  EXPECT_EQ(counts->metric[0].gauge.value, 4);
+
+  auto* times_avg = FindFamily(families, "rox_collector_event_times_us_avg");
+  ASSERT_NE(times_avg, nullptr);
+  ASSERT_EQ(times_avg->metric.size(), 2);
+  EXPECT_EQ(Label(times_avg->metric[0], "step"), "parse");
+  EXPECT_EQ(times_avg->metric[0].gauge.value, 10);
+  EXPECT_EQ(Label(times_avg->metric[1], "step"), "process");
+  EXPECT_EQ(times_avg->metric[1].gauge.value, 5);
+
+  // Event types are kept in order, and remain exported once seen.
+  stats.nUserspaceEvents[10] = 1;
+  stats.nUserspaceEvents[11] = 0;
+  families = collectable.Collect();
+  counts = FindFamily(families, "rox_collector_events_typed");
+  ASSERT_NE(counts, nullptr);
+  ASSERT_EQ(counts->metric.size(), 2);
+  EXPECT_EQ(Label(counts->metric[0], "event_dir"), ">");
+  EXPECT_EQ(Label(counts->metric[1], "event_dir"), "<");
+  EXPECT_EQ(counts->metric[1].gauge.value, 0);
+  EXPECT_EQ(FindFamily(families, "rox_collector_event_times_us_total")->metric.size(), 4);
+}
+
+TEST(CollectorStatsCollectableTest, TestStatsUnavailable) {
+  CollectorStatsCollectable collectable([](SysdigStats*) { return false; }, {{10, "open", ">"}});
+  auto families = collectable.Collect();
+  EXPECT_EQ(FindFamily(families, "rox_collector_events_typed"), nullptr);
+}
+
+TEST(CollectorStatsCollectableTest, TestSparseTimers) {
+  CollectorStats::Reset();
+  CollectorStatsCollectable collectable(nullptr, {});
+
+  EXPECT_EQ(FindFamily(collectable.Collect(), "rox_collector_timers"), nullptr);
+
+  CollectorStats::GetOrCreate().EndTimerAt(CollectorStats::net_scrape_read, 100);
+  CollectorStats::GetOrCreate().EndTimerAt(CollectorStats::net_scrape_read, 300);
+  auto families = collectable.Collect();
+  auto* timers = FindFamily(families, "rox_collector_timers");
+  ASSERT_NE(timers, nullptr);
+  ASSERT_EQ(timers->metric.size(), 3);
+  EXPECT_EQ(Label(timers->metric[0], "type"), "net_scrape_read_events");
+  EXPECT_EQ(timers->metric[0].gauge.value, 2);
+  EXPECT_EQ(Label(timers->metric[1], "type"), "net_scrape_read_times_us_total");
+  EXPECT_EQ(timers->metric[1].gauge.value, 400);
+  EXPECT_EQ(Label(timers->metric[2], "type"), "net_scrape_read_times_us_avg");
+  EXPECT_EQ(timers->metric[2].gauge.value, 200);
+
+  CollectorStats::Reset();
+}
+
+TEST(CollectorStatsCollectableTest, TestCollectBenchmark) {
+  std::vector<EventType> event_types;
+  for (int i = 0; i < PPM_EVENT_MAX; i++) {
+    event_types.push_back({i, "event" + std::to_string(i / 2), i % 2 ? "<" : ">"});
+  }
+
+  for (int active : {10, static_cast<int>(PPM_EVENT_MAX)}) {
+    SysdigStats stats;
+    for (int i = 0; i < active; i++) {
+      stats.nUserspaceEvents[i] = i + 1;
+      stats.event_parse_micros[i] = 10 * (i + 1);
+    }
+    CollectorStatsCollectable collectable(
+        [&stats](SysdigStats* out) {
+          *out = stats;
+          return true;
+        },
+        event_types);
+
+    int num_collects = 1000;
+    size_t num_series = 0;
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_collects; i++) {
+      for (const auto& family : collectable.Collect()) {
+        num_series += family.metric.size();
+      }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::micro> dur = t2 - t1;
+    std::cout << "active event types= " << active << ", series= " << num_series / num_collects << std::endl;
+    std::cout << "Time taken by Collect= " << dur.count() / num_collects << " us\n";
+  }
+}
+
+}  // namespace
+
+}  // namespace collector
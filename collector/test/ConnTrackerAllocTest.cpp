@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "ConnTracker.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using test::CountAllocations;
+
+// Connections of a node running many containers, each with a server
+// accepting connections from many clients, as seen on the event path.
+std::vector<Connection> MakeConnections(int num_containers, int conns_per_container) {
+  std::vector<Connection> conns;
+  conns.reserve(num_containers * conns_per_container);
+  for (int c = 0; c < num_containers; c++) {
+    char container[13];
+    snprintf(container, sizeof(container), "%012lx", 0xc0ffee000L + c);
+    Endpoint server(Address(10, 0, c / 256, c % 256), 8080);
+    for (int i = 0; i < conns_per_container; i++) {
+      Endpoint client(Address(10, 1 + i / 65536, (i / 256) % 256, i % 256), 30000 + i % 30000);
+      conns.emplace_back(container, server, client, L4Proto::TCP, true);
+    }
+  }
+  return conns;
+}
+
+TEST(ConnTrackerAllocTest, ConnectionFromEventFields) {
+  // NetworkSignalHandler::GetConnection builds the connection from the
+  // container id and the endpoints of the event. Container ids are short
+  // enough to be stored inline.
+  const std::string container_id = "a1b2c3d4e5f6";
+  Endpoint local(Address(10, 0, 0, 1), 8080);
+  Endpoint remote(Address(10, 1, 2, 3), 34567);
+
+  std::vector<Connection> conns;
+  conns.reserve(100);
+  size_t allocations = CountAllocations([&] {
+    for (int i = 0; i < 100; i++) {
+      conns.emplace_back(container_id, local, remote, L4Proto::TCP, true);
+    }
+  });
+  EXPECT_EQ(allocations, 0);
+}
+
+TEST(ConnTrackerAllocTest, UpdateConnectionSteadyState) {
+  auto conns = MakeConnections(100, 100);
+  ConnectionTracker tracker;
+  for (const auto& conn : conns) {
+    tracker.AddConnection(conn, 1000);
+  }
+
+  // Updates of known connections, which is what most events are, do not
+  // allocate.
+  size_t allocations = CountAllocations([&] {
+    int64_t timestamp = 2000;
+    for (const auto& conn : conns) {
+      tracker.RemoveConnection(conn, timestamp++);
+      tracker.AddConnection(conn, timestamp++);
+    }
+  });
+  EXPECT_EQ(allocations, 0);
+}
+
+TEST(ConnTrackerAllocTest, UpdateConnectionNewConnections) {
+  auto conns = MakeConnections(100, 100);
+  ConnectionTracker tracker;
+
+  // A new connection allocates its node in the state map and in the index of
+  // its container, along with the amortized rehashing of both.
+  constexpr size_t kAllocationBudget = 3;
+  size_t allocations = CountAllocations([&] {
+    for (const auto& conn : conns) {
+      tracker.AddConnection(conn, 1000);
+    }
+  });
+  EXPECT_LE(allocations, conns.size() * kAllocationBudget);
+}
+
+TEST(ConnTrackerAllocTest, FetchConnStateReusesSnapshot) {
+  auto conns = MakeConnections(100, 1000);
+  ConnectionTracker tracker;
+  for (const auto& conn : conns) {
+    tracker.AddConnection(conn, 1000);
+  }
+
+  // The network status notifier keeps the previous snapshot until the next
+  // one is fetched. Fetching in a new container allocates a node per
+  // connection, and frees those of the previous snapshot, while refilling the
+  // container of the previous snapshot only allocates its bucket array.
+  constexpr int kIntervals = 10;
+  for (bool normalize : {false, true}) {
+    ConnMap old_state;
+    // The fastest interval is reported, as the others are noisy.
+    std::chrono::duration<double, std::milli> new_dur = std::chrono::hours(1);
+    size_t new_allocations = CountAllocations([&] {
+      for (int i = 0; i < kIntervals; i++) {
+        auto t1 = std::chrono::steady_clock::now();
+        old_state = tracker.FetchConnState(normalize, true);
+        new_dur = std::min<std::chrono::duration<double, std::milli>>(new_dur, std::chrono::steady_clock::now() - t1);
+      }
+    });
+
+    // Both containers are filled once before, as in the first two intervals.
+    ConnMap reused_old_state, reused_new_state;
+    tracker.FetchConnState(&reused_old_state, normalize, true);
+    tracker.FetchConnState(&reused_new_state, normalize, true);
+    std::chrono::duration<double, std::milli> reused_dur = std::chrono::hours(1);
+    size_t reused_allocations = CountAllocations([&] {
+      for (int i = 0; i < kIntervals; i++) {
+        auto t1 = std::chrono::steady_clock::now();
+        tracker.FetchConnState(&reused_new_state, normalize, true);
+        reused_old_state.swap(reused_new_state);
+        reused_dur = std::min<std::chrono::duration<double, std::milli>>(reused_dur, std::chrono::steady_clock::now() - t1);
+      }
+    });
+
+    EXPECT_EQ(reused_old_state, old_state);
+    EXPECT_GE(new_allocations, kIntervals * old_state.size());
+    EXPECT_LE(reused_allocations, kIntervals);
+
+    std::cout << "normalize=" << normalize << " size=" << old_state.size() << std::endl;
+    std::cout << "New container: " << new_allocations / kIntervals << " allocations, "
+              << new_dur.count() << " ms per interval" << std::endl;
+    std::cout << "Reused container: " << reused_allocations / kIntervals << " allocations, "
+              << reused_dur.count() << " ms per interval" << std::endl;
+  }
+}
+
+TEST(ConnTrackerAllocTest, FetchConnStateShrinkAndGrow) {
+  auto conns = MakeConnections(10, 100);
+  ConnectionTracker tracker;
+  for (const auto& conn : conns) {
+    tracker.AddConnection(conn, 1000);
+  }
+
+  ConnMap state;
+  tracker.FetchConnState(&state);
+  EXPECT_EQ(state.size(), conns.size());
+
+  // Fewer entries than the previous snapshot.
+  for (size_t i = 0; i < conns.size() / 2; i++) {
+    tracker.RemoveConnection(conns[i], 2000);
+  }
+  tracker.FetchConnState(&state);
+  tracker.FetchConnState(&state);
+  EXPECT_EQ(state.size(), conns.size() / 2);
+  for (size_t i = 0; i < conns.size(); i++) {
+    EXPECT_EQ(state.count(conns[i]), i < conns.size() / 2 ? 0 : 1);
+  }
+
+  // More entries than the previous snapshot.
+  for (const auto& conn : conns) {
+    tracker.AddConnection(conn, 3000);
+  }
+  tracker.FetchConnState(&state);
+  EXPECT_EQ(state.size(), conns.size());
+  EXPECT_EQ(state, tracker.FetchConnState());
+}
+
+}  // namespace
+
+}  // namespace collector
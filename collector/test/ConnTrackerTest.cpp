@@ -154,6 +154,117 @@ TEST(ConnTrackerTest, TestUpdateIgnoredL4ProtoPortPairs) {
                          std::make_pair(conn_fe_normalized, ConnStatus(time_micros, true))));
 }
 
+TEST(ConnTrackerTest, TestNormalizeOnIngest) {
+  Endpoint server(Address(192, 168, 0, 1), 80);
+  Endpoint dns(Address(8, 8, 8, 8), 53);
+  std::vector<Connection> conns;
+  for (uint16_t port = 40000; port < 40100; port++) {
+    Endpoint client(Address(10, 1, 0, 1), port);
+    conns.emplace_back("xyz", server, client, L4Proto::TCP, true);
+    conns.emplace_back("xzy", client, server, L4Proto::TCP, false);
+    // The role of UDP connections is inferred from the ports.
+    conns.emplace_back("xyz", client, dns, L4Proto::UDP, true);
+  }
+
+  int64_t time_micros = 1000;
+  ConnectionTracker raw_tracker;
+  ConnectionTracker tracker;
+  tracker.SetNormalizeOnIngest(true);
+  raw_tracker.Update(conns, {}, time_micros);
+  tracker.Update(conns, {}, time_micros);
+
+  // The connections of each flow are stored as a single entry.
+  Connection server_flow("xyz", Endpoint(IPNet(Address()), 80), Endpoint(IPNet(Address(10, 1, 0, 1)), 0), L4Proto::TCP, true);
+  Connection client_flow("xzy", Endpoint(), server, L4Proto::TCP, false);
+  Connection udp_flow("xyz", Endpoint(), dns, L4Proto::UDP, false);
+  EXPECT_EQ(raw_tracker.GetConnectionsMemoryUsage().entries, conns.size());
+  EXPECT_EQ(tracker.GetConnectionsMemoryUsage().entries, 3);
+  EXPECT_THAT(tracker.FetchConnState(false, false), UnorderedElementsAre(
+                                                        std::make_pair(server_flow, ConnStatus(time_micros, true)),
+                                                        std::make_pair(client_flow, ConnStatus(time_micros, true)),
+                                                        std::make_pair(udp_flow, ConnStatus(time_micros, true))));
+
+  // The addresses are normalized when fetched, according to the current configuration.
+  EXPECT_EQ(tracker.FetchConnState(true, false), raw_tracker.FetchConnState(true, false));
+  raw_tracker.UpdateKnownPublicIPs({Address(8, 8, 8, 8)});
+  tracker.UpdateKnownPublicIPs({Address(8, 8, 8, 8)});
+  raw_tracker.EnableExternalIPs(true);
+  tracker.EnableExternalIPs(true);
+  EXPECT_EQ(tracker.FetchConnState(true, false), raw_tracker.FetchConnState(true, false));
+
+  // A flow stays active while any of its connections is open.
+  tracker.RemoveConnection(conns[0], 2000);
+  raw_tracker.RemoveConnection(conns[0], 2000);
+  auto state = tracker.FetchConnState(true, true);
+  EXPECT_EQ(state.size(), 3);
+  for (const auto& entry : state) {
+    EXPECT_TRUE(entry.second.IsActive()) << entry.first;
+  }
+  EXPECT_EQ(state, raw_tracker.FetchConnState(true, true));
+}
+
+TEST(ConnTrackerTest, TestNormalizeOnIngestFlowStatus) {
+  Endpoint server(Address(192, 168, 0, 1), 80);
+  Connection conn1("xyz", server, Endpoint(Address(10, 1, 0, 1), 40000), L4Proto::TCP, true);
+  Connection conn2("xyz", server, Endpoint(Address(10, 1, 0, 1), 40001), L4Proto::TCP, true);
+  Connection flow("xyz", Endpoint(IPNet(Address()), 80), Endpoint(IPNet(Address(10, 1, 0, 1)), 0), L4Proto::TCP, true);
+
+  ConnectionTracker tracker;
+  tracker.SetNormalizeOnIngest(true);
+
+  // Same as the statuses merged when normalizing on fetch.
+  tracker.AddConnection(conn1, 1000);
+  tracker.AddConnection(conn2, 2000);
+  tracker.RemoveConnection(conn1, 3000);
+  EXPECT_THAT(tracker.FetchConnState(false, false), UnorderedElementsAre(std::make_pair(flow, ConnStatus(2000, true))));
+
+  tracker.RemoveConnection(conn2, 4000);
+  EXPECT_THAT(tracker.FetchConnState(false, false), UnorderedElementsAre(std::make_pair(flow, ConnStatus(4000, false))));
+
+  // A scrape resets the open connections of the flows.
+  tracker.Update({conn1, conn2}, {}, 5000);
+  tracker.RemoveConnection(conn2, 6000);
+  EXPECT_THAT(tracker.FetchConnState(false, false), UnorderedElementsAre(std::make_pair(flow, ConnStatus(5000, true))));
+  tracker.Update({}, {}, 7000);
+  tracker.AddConnection(conn1, 8000);
+  tracker.RemoveConnection(conn1, 9000);
+  EXPECT_THAT(tracker.FetchConnState(false, true), UnorderedElementsAre(std::make_pair(flow, ConnStatus(9000, false))));
+  EXPECT_EQ(tracker.GetConnectionsMemoryUsage().entries, 0u);
+}
+
+TEST(ConnTrackerTest, TestNormalizeOnIngestFiltersPorts) {
+  Endpoint server(Address(192, 168, 0, 1), 80);
+  Endpoint client(Address(10, 1, 0, 1), 40000);
+  Endpoint other_client(Address(10, 1, 0, 1), 40001);
+  Endpoint ignored_client(Address(10, 1, 0, 2), 40000);
+  std::vector<Connection> conns = {
+      Connection("xyz", server, client, L4Proto::TCP, true),
+      Connection("xyz", server, other_client, L4Proto::TCP, true),
+      Connection("xyz", server, ignored_client, L4Proto::TCP, true),
+  };
+
+  int64_t time_micros = 1000;
+  ConnectionTracker raw_tracker;
+  ConnectionTracker tracker;
+  tracker.SetNormalizeOnIngest(true);
+  raw_tracker.UpdateIgnoredL4ProtoPortPairs({{L4Proto::TCP, 40000}});
+  tracker.UpdateIgnoredL4ProtoPortPairs({{L4Proto::TCP, 40000}});
+  raw_tracker.Update(conns, {}, time_micros);
+  tracker.Update(conns, {}, time_micros);
+
+  // The client port is dropped when stored, so the ignored one is filtered before.
+  Connection server_flow("xyz", Endpoint(IPNet(Address()), 80), Endpoint(IPNet(Address(10, 1, 0, 1)), 0), L4Proto::TCP, true);
+  EXPECT_THAT(tracker.FetchConnState(false, false), UnorderedElementsAre(std::make_pair(server_flow, ConnStatus(time_micros, true))));
+  EXPECT_EQ(tracker.FetchConnState(true, false), raw_tracker.FetchConnState(true, false));
+
+  // Changing the mode drops the connections stored in the previous one.
+  tracker.SetNormalizeOnIngest(false);
+  EXPECT_EQ(tracker.GetConnectionsMemoryUsage().entries, 0u);
+  EXPECT_EQ(tracker.GetContainerEntryCount("xyz"), 0u);
+  tracker.Update(conns, {}, time_micros);
+  EXPECT_EQ(tracker.FetchConnState(false, false), raw_tracker.FetchConnState(false, false));
+}
+
 TEST(ConnTrackerTest, TestUpdateIgnoredNetworks) {
   Endpoint a(Address(192, 168, 1, 10), 9999);
   Endpoint b(Address(169, 254, 0, 1), 80);
@@ -1621,6 +1732,131 @@ TEST(ConnTrackerTest, TestConnectionStats) {
   EXPECT_EQ(stats.outbound.public_, 4);
 }
 
+/* Listen endpoints maintained from events: a removal matches the endpoint regardless of the
+   originator process, and connection-only scrapes leave the endpoints untouched. */
+TEST(ConnTrackerTest, TestUpdateEndpoint) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(192, 168, 0, 1), 443);
+  Endpoint c(Address(192, 168, 0, 1), 12345);
+  Connection conn("container", c, a, L4Proto::TCP, false);
+  ConnectionTracker tracker;
+  std::shared_ptr<IProcess> process1 = std::make_shared<FakeProcess>(2, "container", "comm", "exe", "exe_path", "args");
+  std::shared_ptr<IProcess> process2 = std::make_shared<FakeProcess>(3, "container", "comm", "exe", "exe_path", "args");
+
+  ContainerEndpoint ce1("container", a, L4Proto::TCP, process1);
+  ContainerEndpoint ce2("container", b, L4Proto::TCP, process1);
+
+  tracker.UpdateEndpoint(ce1, 1000, true);
+  tracker.UpdateEndpoint(ce2, 1000, true);
+  tracker.Update({conn}, 2000);
+
+  auto state = tracker.FetchEndpointState(false, false);
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(ce1, ConnStatus(1000, true)), std::make_pair(ce2, ConnStatus(1000, true))));
+
+  // closed by another process
+  tracker.UpdateEndpoint(ContainerEndpoint("container", a, L4Proto::TCP, process2), 3000, false);
+
+  state = tracker.FetchEndpointState(false, false);
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(ce1, ConnStatus(3000, false)), std::make_pair(ce2, ConnStatus(1000, true))));
+
+  // an endpoint reported by an event more recent than the scrape is kept active
+  tracker.UpdateEndpoint(ce1, 5000, true);
+  tracker.Update({conn}, {}, 4000);
+
+  state = tracker.FetchEndpointState(false, false);
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(ce1, ConnStatus(5000, true)), std::make_pair(ce2, ConnStatus(1000, false))));
+}
+
+TEST(ConnTrackerTest, TestCloseContainer) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(192, 168, 1, 10), 9999);
+  Endpoint c(Address(192, 168, 1, 11), 9999);
+
+  Connection conn1("xyz", a, b, L4Proto::TCP, true);
+  Connection conn2("xyz", a, c, L4Proto::TCP, true);
+  Connection conn3("abc", b, a, L4Proto::TCP, false);
+  ContainerEndpoint ep1("xyz", a, L4Proto::TCP, nullptr);
+
+  ConnectionTracker tracker;
+  tracker.Update({conn1, conn2, conn3}, {ep1}, 1000);
+
+  EXPECT_EQ(tracker.GetContainerEntryCount("xyz"), 3);
+  EXPECT_EQ(tracker.GetContainerEntryCount("abc"), 1);
+  EXPECT_EQ(tracker.GetContainerEntryCount("none"), 0);
+
+  tracker.CloseContainer("xyz", 2000);
+
+  auto conn_state = tracker.FetchConnState(false, false);
+  EXPECT_THAT(conn_state, UnorderedElementsAre(std::make_pair(conn1, ConnStatus(2000, false)),
+                                               std::make_pair(conn2, ConnStatus(2000, false)),
+                                               std::make_pair(conn3, ConnStatus(1000, true))));
+  auto endpoint_state = tracker.FetchEndpointState(false, false);
+  EXPECT_THAT(endpoint_state, UnorderedElementsAre(std::make_pair(ep1, ConnStatus(2000, false))));
+
+  // the sweep of inactive entries keeps the index up to date
+  tracker.FetchConnState(false, true);
+  tracker.FetchEndpointState(false, true);
+
+  EXPECT_EQ(tracker.GetContainerEntryCount("xyz"), 0);
+  EXPECT_EQ(tracker.GetContainerEntryCount("abc"), 1);
+}
+
+TEST(ConnTrackerTest, TestCloseContainerAfterPartialSweep) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(192, 168, 1, 10), 9999);
+  Endpoint c(Address(192, 168, 1, 11), 9999);
+
+  Connection conn1("xyz", a, b, L4Proto::TCP, true);
+  Connection conn2("xyz", a, c, L4Proto::TCP, true);
+
+  ConnectionTracker tracker;
+  tracker.AddConnection(conn1, 1000);
+  tracker.AddConnection(conn2, 1000);
+  tracker.RemoveConnection(conn1, 2000);
+
+  // only the inactive entry leaves the index
+  tracker.FetchConnState(false, true);
+  EXPECT_EQ(tracker.GetContainerEntryCount("xyz"), 1);
+
+  tracker.CloseContainer("xyz", 3000);
+  auto state = tracker.FetchConnState(false, true);
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(conn2, ConnStatus(3000, false))));
+  EXPECT_EQ(tracker.GetContainerEntryCount("xyz"), 0);
+
+  // a new entry of the container is indexed again
+  tracker.AddConnection(conn1, 4000);
+  EXPECT_EQ(tracker.GetContainerEntryCount("xyz"), 1);
+}
+
+TEST(ConnTrackerTest, TestMaxEntriesPerContainer) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(192, 168, 1, 10), 9999);
+  Endpoint c(Address(192, 168, 1, 11), 9999);
+
+  Connection conn1("xyz", a, b, L4Proto::TCP, true);
+  Connection conn2("xyz", a, c, L4Proto::TCP, true);
+  Connection conn3("abc", b, a, L4Proto::TCP, false);
+
+  ConnectionTracker tracker;
+  tracker.SetMaxEntriesPerContainer(1);
+
+  tracker.AddConnection(conn1, 1000);
+  tracker.AddConnection(conn2, 1000);  // over the limit, dropped
+  tracker.AddConnection(conn3, 1000);
+  tracker.RemoveConnection(conn1, 2000);  // already known, updated
+
+  auto state = tracker.FetchConnState();
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(conn1, ConnStatus(2000, false)),
+                                          std::make_pair(conn3, ConnStatus(1000, true))));
+
+  // conn1 was cleared, making room for conn2
+  tracker.AddConnection(conn2, 3000);
+
+  state = tracker.FetchConnState();
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(conn2, ConnStatus(3000, true)),
+                                          std::make_pair(conn3, ConnStatus(1000, true))));
+}
+
 }  // namespace
 
 }  // namespace collector
@@ -0,0 +1,162 @@
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "CollectorStats.h"
+#include "ConnTracker.h"
+#include "ConnTrackerWorkers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using ::testing::UnorderedElementsAre;
+
+std::vector<Connection> CreateConnections(int num_connections) {
+  std::vector<Connection> connections;
+  connections.reserve(num_connections);
+
+  Endpoint server(Address(192, 168, 0, 1), 443);
+  for (int i = 0; i < num_connections; i++) {
+    Endpoint client(Address(10, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff), 40000 + (i % 20000));
+    connections.emplace_back(std::to_string(i % 100), client, server, L4Proto::TCP, false);
+  }
+
+  return connections;
+}
+
+TEST(ConnTrackerWorkersTest, TestUpdatesAppliedInOrder) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(192, 168, 1, 10), 9999);
+
+  Connection conn1("xyz", a, b, L4Proto::TCP, false);
+  Connection conn2("xyz", b, a, L4Proto::TCP, true);
+
+  auto tracker = std::make_shared<ConnectionTracker>();
+  ConnectionTrackerWorkers workers(tracker, 2);
+  workers.Start();
+
+  workers.UpdateConnection(conn1, 1000, true);
+  workers.UpdateConnection(conn2, 1000, true);
+  workers.UpdateConnection(conn1, 2000, false);
+
+  // Stopping applies all the pending updates.
+  workers.Stop();
+
+  auto state = tracker->FetchConnState();
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(conn1, ConnStatus(2000, false)),
+                                          std::make_pair(conn2, ConnStatus(1000, true))));
+}
+
+TEST(ConnTrackerWorkersTest, TestFullQueueAppliedInline) {
+  CollectorStats::Reset();
+  auto connections = CreateConnections(10);
+
+  auto tracker = std::make_shared<ConnectionTracker>();
+  ConnectionTrackerWorkers workers(tracker, 1, 4);
+
+  // Not started yet, so nothing is consumed from the queue.
+  int64_t ts = 1000;
+  for (const auto& conn : connections) {
+    workers.UpdateConnection(conn, ts++, true);
+  }
+  EXPECT_EQ(CollectorStats::GetOrCreate().GetCounter(CollectorStats::net_conn_worker_inline), 6);
+  EXPECT_EQ(tracker->FetchConnState(false, false).size(), 6u);
+
+  // A close overtaking the queued open of the same connection is not undone
+  // by it.
+  workers.UpdateConnection(connections[0], ts++, false);
+  EXPECT_EQ(CollectorStats::GetOrCreate().GetCounter(CollectorStats::net_conn_worker_inline), 7);
+
+  workers.Start();
+  workers.Stop();
+
+  auto state = tracker->FetchConnState();
+  EXPECT_EQ(state.size(), connections.size());
+  for (const auto& conn : connections) {
+    EXPECT_EQ(state.count(conn), 1u);
+  }
+  EXPECT_FALSE(state[connections[0]].IsActive());
+  EXPECT_TRUE(state[connections[1]].IsActive());
+  CollectorStats::Reset();
+}
+
+TEST(ConnTrackerWorkersTest, TestUpdateConnections) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(192, 168, 1, 10), 9999);
+
+  Connection conn1("xyz", a, b, L4Proto::TCP, false);
+  Connection conn2("xyz", b, a, L4Proto::TCP, true);
+
+  ConnectionTracker tracker;
+  tracker.UpdateConnections({
+      {conn1, ConnStatus(2000, true)},
+      {conn2, ConnStatus(1000, true)},
+      {conn1, ConnStatus(1000, false)},  // older, ignored
+  });
+
+  auto state = tracker.FetchConnState();
+  EXPECT_THAT(state, UnorderedElementsAre(std::make_pair(conn1, ConnStatus(2000, true)),
+                                          std::make_pair(conn2, ConnStatus(1000, true))));
+}
+
+// Measures the time spent by the event loop to hand over connection updates,
+// while the tracker state is concurrently fetched, as done by the network
+// status notifier.
+TEST(ConnTrackerWorkersTest, TestUpdateConnectionBenchmark) {
+  size_t num_connections = 100000;
+  auto connections = CreateConnections(num_connections);
+
+  for (size_t num_workers : {0u, 1u, 2u, 4u, 8u}) {
+    CollectorStats::Reset();
+    auto tracker = std::make_shared<ConnectionTracker>();
+    std::unique_ptr<ConnectionTrackerWorkers> workers;
+    if (num_workers > 0) {
+      workers = std::make_unique<ConnectionTrackerWorkers>(tracker, num_workers);
+      workers->Start();
+    }
+
+    std::atomic<bool> done(false);
+    std::thread fetcher([&] {
+      while (!done) {
+        tracker->FetchConnState(true, false);
+      }
+    });
+
+    auto t1 = std::chrono::steady_clock::now();
+    int64_t ts = 1000;
+    for (const auto& conn : connections) {
+      if (workers) {
+        workers->UpdateConnection(conn, ts++, true);
+      } else {
+        tracker->UpdateConnection(conn, ts++, true);
+      }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+
+    if (workers) workers->Stop();
+    auto t3 = std::chrono::steady_clock::now();
+
+    done = true;
+    fetcher.join();
+
+    // Every update is applied, some of them by the event loop when the queue
+    // of their worker is full.
+    size_t inline_updates = CollectorStats::GetOrCreate().GetCounter(CollectorStats::net_conn_worker_inline);
+    EXPECT_EQ(tracker->FetchConnState().size(), num_connections);
+
+    std::chrono::duration<double, std::milli> dispatch = t2 - t1;
+    std::chrono::duration<double, std::milli> total = t3 - t1;
+    std::cout << "workers= " << num_workers
+              << " event loop time= " << dispatch.count() << " ms"
+              << " total time= " << total.count() << " ms"
+              << " inline= " << inline_updates << "\n";
+  }
+}
+
+}  // namespace
+
+}  // namespace collector
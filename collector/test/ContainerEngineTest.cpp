@@ -0,0 +1,55 @@
+// clang-format off
+#include <Utility.h>
+#include "libsinsp/sinsp.h"
+// clang-format on
+
+#include "ContainerEngine.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+TEST(ContainerEngineTest, TestResolveRegistersContainer) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  ContainerEngine engine(inspector->m_container_manager);
+
+  sinsp_threadinfo tinfo(inspector.get());
+  tinfo.m_tid = 100;
+  tinfo.m_pid = 100;
+  tinfo.set_cgroups({{"pids", "/docker/951e643e3c241b225b6284ef2b79a37c13fc64cbf65b5d46bda95fcb98fe63a4"}});
+
+  EXPECT_TRUE(engine.resolve(&tinfo, false));
+  EXPECT_EQ(tinfo.m_container_id, "951e643e3c24");
+
+  auto container = inspector->m_container_manager.get_container("951e643e3c24");
+  ASSERT_NE(container, nullptr);
+  EXPECT_EQ(container->m_id, "951e643e3c24");
+
+  // The container is only registered the first time it is seen.
+  sinsp_threadinfo other(inspector.get());
+  other.m_tid = 101;
+  other.m_pid = 101;
+  other.set_cgroups({{"pids", "/docker/951e643e3c241b225b6284ef2b79a37c13fc64cbf65b5d46bda95fcb98fe63a4"}});
+  EXPECT_TRUE(engine.resolve(&other, false));
+  EXPECT_EQ(inspector->m_container_manager.get_container("951e643e3c24"), container);
+}
+
+TEST(ContainerEngineTest, TestResolveHost) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  ContainerEngine engine(inspector->m_container_manager);
+
+  sinsp_threadinfo tinfo(inspector.get());
+  tinfo.m_tid = 100;
+  tinfo.m_pid = 100;
+  tinfo.set_cgroups({{"pids", "/system.slice/sshd.service"}});
+
+  EXPECT_FALSE(engine.resolve(&tinfo, false));
+  EXPECT_TRUE(tinfo.m_container_id.empty());
+  EXPECT_EQ(inspector->m_container_manager.get_containers()->size(), 0u);
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -0,0 +1,121 @@
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "ContinuousProfiler.h"
+#include "Scheduler.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+// Fakes the CPU profiler, writing the number of the profile to the file on
+// stop.
+class FakeCPUProfiler {
+ public:
+  bool Start(const std::string& path) {
+    if (running_) {
+      return false;
+    }
+    running_ = true;
+    path_ = path;
+    return true;
+  }
+
+  void Stop() {
+    running_ = false;
+    std::ofstream(path_) << "profile " << ++num_profiles_;
+  }
+
+  bool running() const { return running_; }
+
+ private:
+  bool running_ = false;
+  std::string path_;
+  int num_profiles_ = 0;
+};
+
+class ContinuousProfilerTest : public testing::Test {
+ protected:
+  std::unique_ptr<ContinuousProfiler> MakeProfiler(const ContinuousProfilerConfig& config) {
+    return std::make_unique<ContinuousProfiler>(
+        config, testing::TempDir() + "cpu_profile_window",
+        [this](const std::string& path) { return fake_.Start(path); },
+        [this]() { fake_.Stop(); });
+  }
+
+  FakeCPUProfiler fake_;
+};
+
+TEST_F(ContinuousProfilerTest, TestRing) {
+  ContinuousProfilerConfig config;
+  config.interval = std::chrono::seconds(60);
+  config.max_windows = 3;
+  auto profiler = MakeProfiler(config);
+
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(profiler->StartWindow());
+    EXPECT_FALSE(profiler->StartWindow());
+    profiler->EndWindow();
+  }
+
+  auto windows = profiler->ListWindows();
+  ASSERT_EQ(windows.size(), 3);
+  EXPECT_EQ(windows[0].id, 3);
+  EXPECT_EQ(windows[2].id, 5);
+
+  std::string profile;
+  EXPECT_FALSE(profiler->GetWindow(2, &profile));
+  ASSERT_TRUE(profiler->GetWindow(5, &profile));
+  EXPECT_EQ(profile, "profile 5");
+  EXPECT_EQ(windows[2].size, profile.size());
+}
+
+TEST_F(ContinuousProfilerTest, TestSuspend) {
+  ContinuousProfilerConfig config;
+  config.interval = std::chrono::seconds(60);
+  auto profiler = MakeProfiler(config);
+
+  // The current window is kept when suspending.
+  ASSERT_TRUE(profiler->StartWindow());
+  profiler->Suspend();
+  EXPECT_FALSE(fake_.running());
+  EXPECT_EQ(profiler->ListWindows().size(), 1);
+
+  EXPECT_FALSE(profiler->StartWindow());
+  profiler->Resume();
+  EXPECT_TRUE(profiler->StartWindow());
+  profiler->EndWindow();
+  EXPECT_EQ(profiler->ListWindows().size(), 2);
+}
+
+TEST_F(ContinuousProfilerTest, TestSchedule) {
+  ContinuousProfilerConfig config;
+  EXPECT_FALSE(MakeProfiler(config)->Schedule(nullptr));
+
+  config.interval = std::chrono::seconds(1);
+  config.window = std::chrono::milliseconds(50);
+  auto profiler = MakeProfiler(config);
+
+  Scheduler scheduler(1);
+  ASSERT_TRUE(scheduler.Start());
+  ASSERT_TRUE(profiler->Schedule(&scheduler));
+
+  // Periodic tasks start at an offset within their period.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+  while (profiler->ListWindows().empty() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  scheduler.Stop();
+
+  auto windows = profiler->ListWindows();
+  ASSERT_FALSE(windows.empty());
+  EXPECT_GE(windows[0].duration, std::chrono::milliseconds(50));
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "DDSketch.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+double ExactQuantile(std::vector<double> values, double q) {
+  std::sort(values.begin(), values.end());
+  return values[static_cast<size_t>(q * (values.size() - 1))];
+}
+
+TEST(DDSketchTest, TestEmpty) {
+  DDSketch sketch(0.01);
+  EXPECT_EQ(sketch.count(), 0);
+  EXPECT_EQ(sketch.Quantile(0.5), 0);
+}
+
+TEST(DDSketchTest, TestRelativeAccuracy) {
+  double accuracy = 0.01;
+  DDSketch sketch(accuracy);
+  std::vector<double> values;
+
+  std::mt19937 rng(42);
+  std::lognormal_distribution<double> distribution(5, 2);
+  for (int i = 0; i < 100000; i++) {
+    double value = distribution(rng);
+    values.push_back(value);
+    sketch.Add(value);
+  }
+
+  EXPECT_EQ(sketch.count(), values.size());
+  for (double q : {0.0, 0.1, 0.5, 0.9, 0.95, 0.99, 1.0}) {
+    double exact = ExactQuantile(values, q);
+    EXPECT_NEAR(sketch.Quantile(q), exact, exact * accuracy) << "q=" << q;
+  }
+}
+
+TEST(DDSketchTest, TestZeros) {
+  DDSketch sketch(0.01);
+  for (int i = 0; i < 60; i++) {
+    sketch.Add(0);
+  }
+  for (int i = 0; i < 40; i++) {
+    sketch.Add(100);
+  }
+  sketch.Add(-1);
+
+  EXPECT_EQ(sketch.zero_count(), 61);
+  EXPECT_EQ(sketch.Quantile(0.5), 0);
+  EXPECT_NEAR(sketch.Quantile(0.9), 100, 1);
+  EXPECT_DOUBLE_EQ(sketch.sum(), 4000);
+}
+
+TEST(DDSketchTest, TestMerge) {
+  DDSketch low(0.02), high(0.02), all(0.02);
+  for (int i = 1; i <= 1000; i++) {
+    (i <= 500 ? low : high).Add(i);
+    all.Add(i);
+  }
+
+  low.Merge(high);
+  EXPECT_EQ(low.count(), all.count());
+  EXPECT_DOUBLE_EQ(low.sum(), all.sum());
+  for (double q : {0.1, 0.5, 0.9}) {
+    EXPECT_DOUBLE_EQ(low.Quantile(q), all.Quantile(q));
+  }
+
+  std::vector<std::pair<int, uint64_t>> low_bins, all_bins;
+  low.ForEachBin([&](int index, uint64_t count) { low_bins.emplace_back(index, count); });
+  all.ForEachBin([&](int index, uint64_t count) { all_bins.emplace_back(index, count); });
+  EXPECT_EQ(low_bins, all_bins);
+}
+
+TEST(DDSketchTest, TestMaxBins) {
+  DDSketch sketch(0.01, 64);
+  double max = 0;
+  for (double value = 1e-3; value < 1e9; value *= 1.5) {
+    sketch.Add(value);
+    max = value;
+  }
+
+  int num_bins = 0;
+  sketch.ForEachBin([&](int, uint64_t) { num_bins++; });
+  EXPECT_LE(num_bins, 64);
+
+  // The highest quantiles are unaffected by collapsing.
+  EXPECT_NEAR(sketch.Quantile(1.0), max, max * 0.01);
+}
+
+TEST(DDSketchTest, TestFixedRange) {
+  // The range of the exported connection stats sketches.
+  DDSketch low(0.05, 0.01, 1e6), high(0.05, 0.01, 1e6);
+  EXPECT_EQ(low.Index(0.01), -46);
+  EXPECT_EQ(low.Index(1e6), 139);
+
+  for (double value = 1e-6; value < 1; value *= 1.5) {
+    low.Add(value);
+  }
+  for (double value = 1; value < 1e9; value *= 1.5) {
+    high.Add(value);
+  }
+
+  // Out of range values are counted in the first or last bin, whatever the
+  // other values, so the bins are the same in both sketches.
+  std::vector<std::pair<int, uint64_t>> low_bins, high_bins;
+  low.ForEachBin([&](int index, uint64_t count) { low_bins.emplace_back(index, count); });
+  high.ForEachBin([&](int index, uint64_t count) { high_bins.emplace_back(index, count); });
+  ASSERT_FALSE(low_bins.empty());
+  ASSERT_FALSE(high_bins.empty());
+  EXPECT_EQ(low_bins.front().first, -46);
+  EXPECT_GT(low_bins.front().second, 1);
+  EXPECT_EQ(high_bins.back().first, 139);
+  EXPECT_GT(high_bins.back().second, 1);
+
+  uint64_t count = low.count() + high.count();
+  low.Merge(high);
+  EXPECT_EQ(low.count(), count);
+  int num_bins = 0;
+  low.ForEachBin([&](int index, uint64_t) {
+    EXPECT_GE(index, -46);
+    EXPECT_LE(index, 139);
+    num_bins++;
+  });
+  EXPECT_LE(num_bins, 186);
+  EXPECT_DOUBLE_EQ(low.Quantile(0), low.Value(-46));
+  EXPECT_DOUBLE_EQ(low.Quantile(1), low.Value(139));
+}
+
+TEST(DDSketchTest, TestSlidingWindow) {
+  auto start = SlidingDDSketch::Clock::now();
+  SlidingDDSketch sketch(0.01, std::chrono::seconds(60), 6);
+
+  sketch.Add(10, start);
+  sketch.Add(1000, start + std::chrono::seconds(30));
+  EXPECT_EQ(sketch.Snapshot(start + std::chrono::seconds(30)).count(), 2);
+
+  // The first value expires along with its slice.
+  DDSketch snapshot = sketch.Snapshot(start + std::chrono::seconds(65));
+  EXPECT_EQ(snapshot.count(), 1);
+  EXPECT_NEAR(snapshot.Quantile(0.5), 1000, 10);
+
+  EXPECT_EQ(sketch.Snapshot(start + std::chrono::minutes(10)).count(), 0);
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -0,0 +1,85 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "DoubleBuffer.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+// All fields are equal in a consistent snapshot.
+struct Snapshot {
+  uint64_t values[64] = {};
+
+  void Fill(uint64_t value) {
+    for (auto& v : values) {
+      v = value;
+    }
+  }
+
+  bool IsConsistent() const {
+    for (auto v : values) {
+      if (v != values[0]) return false;
+    }
+    return true;
+  }
+};
+
+TEST(DoubleBufferTest, TestPublishRead) {
+  DoubleBuffer<Snapshot> buffer;
+  Snapshot snapshot;
+  EXPECT_FALSE(buffer.Read(&snapshot));
+
+  for (uint64_t i = 1; i <= 3; i++) {
+    Snapshot published;
+    published.Fill(i);
+    EXPECT_TRUE(buffer.Publish(published));
+
+    EXPECT_TRUE(buffer.Read(&snapshot));
+    EXPECT_EQ(snapshot.values[0], i);
+    EXPECT_TRUE(snapshot.IsConsistent());
+  }
+}
+
+TEST(DoubleBufferTest, TestConcurrentReaders) {
+  DoubleBuffer<Snapshot> buffer;
+  std::atomic<bool> done(false);
+  std::atomic<int> inconsistent(0);
+  std::atomic<int> out_of_order(0);
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&]() {
+      Snapshot snapshot;
+      uint64_t last = 0;
+      while (!done.load()) {
+        if (!buffer.Read(&snapshot)) continue;
+        if (!snapshot.IsConsistent()) inconsistent++;
+        if (snapshot.values[0] < last) out_of_order++;
+        last = snapshot.values[0];
+      }
+    });
+  }
+
+  int published = 0;
+  Snapshot snapshot;
+  for (uint64_t i = 1; i <= 100000; i++) {
+    snapshot.Fill(i);
+    if (buffer.Publish(snapshot)) published++;
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_GT(published, 0);
+  EXPECT_EQ(inconsistent, 0);
+  EXPECT_EQ(out_of_order, 0);
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -0,0 +1,40 @@
+#ifndef COLLECTOR_TEST_EXECVEEVENT_H
+#define COLLECTOR_TEST_EXECVEEVENT_H
+
+// Builds the execve exit event of a thread without going through a driver.
+// Only the header of the event is set: the fields of a process signal are all
+// read from the thread info of the event.
+
+#include "libsinsp/sinsp.h"
+
+namespace collector {
+namespace test {
+
+class ExecveEvent {
+ public:
+  ExecveEvent(sinsp* inspector, sinsp_threadinfo* tinfo, uint64_t ts = 1000) {
+    header_.ts = ts;
+    header_.tid = tinfo->m_tid;
+    header_.len = sizeof(header_);
+    header_.type = PPME_SYSCALL_EXECVE_19_X;
+    header_.nparams = 0;
+
+    evt_.set_inspector(inspector);
+    evt_.set_scap_evt(&header_);
+    evt_.set_tinfo(tinfo);
+  }
+
+  ExecveEvent(const ExecveEvent&) = delete;
+  ExecveEvent& operator=(const ExecveEvent&) = delete;
+
+  sinsp_evt* get() { return &evt_; }
+
+ private:
+  scap_evt header_ = {};
+  sinsp_evt evt_;
+};
+
+}  // namespace test
+}  // namespace collector
+
+#endif  // COLLECTOR_TEST_EXECVEEVENT_H
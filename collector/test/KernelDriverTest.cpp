@@ -0,0 +1,170 @@
+// clang-format off
+#include <Utility.h>
+#include "libsinsp/sinsp.h"
+// clang-format on
+
+#include <arpa/inet.h>
+
+#include "CollectorConfig.h"
+#include "ConnTracker.h"
+#include "EventNames.h"
+#include "ExecveEvent.h"
+#include "KernelDriver.h"
+#include "NetworkSignalHandler.h"
+#include "ProcessSignalHandler.h"
+#include "SignalServiceClient.h"
+#include "SyscallEvent.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using ::testing::_;
+using ::testing::Return;
+using ::testing::UnorderedElementsAre;
+
+class MockSignalServiceClient : public ISignalServiceClient {
+ public:
+  MOCK_METHOD0(Start, void());
+  MOCK_METHOD0(Stop, void());
+  MOCK_METHOD1(PushSignals, SignalHandler::Result(const SignalStreamMessage& msg));
+};
+
+class MockCollectorConfig : public CollectorConfig {
+ public:
+  MockCollectorConfig() : CollectorConfig() {
+    for (const auto& syscall : kSyscalls) {
+      syscalls_.push_back(syscall);
+    }
+  }
+
+  void SetCaptureSchedSwitch(bool capture) {
+    capture_sched_switch_ = capture;
+  }
+
+  void SetTrackListenEndpoints(bool track) {
+    track_listen_endpoints_ = track;
+  }
+};
+
+TEST(KernelDriverTest, TestSchedSwitchCapturedByDefault) {
+  MockCollectorConfig config;
+  KernelDriverCOREEBPF driver;
+
+  auto ppm_sc = driver.GetSyscallList(config);
+  EXPECT_EQ(ppm_sc.count(PPM_SC_SCHED_SWITCH), 1);
+  EXPECT_EQ(ppm_sc.count(PPM_SC_SCHED_PROCESS_EXIT), 1);
+}
+
+TEST(KernelDriverTest, TestWithoutSchedSwitch) {
+  MockCollectorConfig config;
+  KernelDriverCOREEBPF driver;
+  auto with_sched_switch = driver.GetSyscallList(config);
+
+  config.SetCaptureSchedSwitch(false);
+  auto ppm_sc = driver.GetSyscallList(config);
+  EXPECT_EQ(ppm_sc.count(PPM_SC_SCHED_SWITCH), 0);
+
+  // The thread table is kept up to date by the thread lifecycle events.
+  for (auto sc : {PPM_SC_SCHED_PROCESS_EXIT, PPM_SC_CLONE, PPM_SC_FORK, PPM_SC_VFORK, PPM_SC_EXECVE}) {
+    EXPECT_EQ(ppm_sc.count(sc), 1) << sc;
+  }
+
+  with_sched_switch.erase(PPM_SC_SCHED_SWITCH);
+  EXPECT_EQ(ppm_sc, with_sched_switch);
+}
+
+// Returns whether all the events a handler relies on are captured with the
+// given probe set.
+bool CapturesRelevantEvents(SignalHandler* handler, const std::unordered_set<ppm_sc_code>& ppm_sc) {
+  const EventNames& event_names = EventNames::GetInstance();
+  for (const auto& event_name : handler->GetRelevantEvents()) {
+    for (ppm_event_code event_id : event_names.GetEventIDs(event_name)) {
+      uint16_t syscall_id = event_names.GetEventSyscallID(event_id);
+      // procexit is the only tracepoint the handlers rely on.
+      auto sc = syscall_id ? (ppm_sc_code)g_syscall_table[syscall_id].ppm_sc : PPM_SC_SCHED_PROCESS_EXIT;
+      if (!ppm_sc.count(sc)) {
+        ADD_FAILURE() << event_name << " is not captured";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+TEST(KernelDriverTest, TestHandlersWithoutSchedSwitch) {
+  MockCollectorConfig config;
+  config.SetCaptureSchedSwitch(false);
+  KernelDriverCOREEBPF driver;
+  auto ppm_sc = driver.GetSyscallList(config);
+
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  SysdigStats stats;
+  MockSignalServiceClient client;
+  ProcessSignalHandler process_handler(inspector.get(), &client, &stats);
+  auto conn_tracker = std::make_shared<ConnectionTracker>();
+  NetworkSignalHandler network_handler(inspector.get(), conn_tracker, &stats);
+
+  EXPECT_TRUE(CapturesRelevantEvents(&process_handler, ppm_sc));
+  EXPECT_TRUE(CapturesRelevantEvents(&network_handler, ppm_sc));
+
+  // A thread never scheduled in while capturing, only known from /proc.
+  auto* tinfo = new sinsp_threadinfo(inspector.get());
+  tinfo->m_pid = 100;
+  tinfo->m_tid = 100;
+  tinfo->m_ptid = -1;
+  tinfo->m_vpid = 1;
+  tinfo->m_container_id = "abc";
+  tinfo->m_comm = "client";
+  tinfo->m_exepath = "/bin/client";
+  inspector->add_thread(tinfo);
+
+  test::ExecveEvent execve_evt(inspector.get(), tinfo);
+  EXPECT_CALL(client, PushSignals(_)).WillOnce(Return(SignalHandler::PROCESSED));
+  EXPECT_EQ(process_handler.HandleSignal(execve_evt.get()), SignalHandler::PROCESSED);
+  EXPECT_EQ(stats.nProcessSent, 1u);
+
+  sinsp_fdinfo fdinfo;
+  fdinfo.m_type = SCAP_FD_IPV4_SOCK;
+  fdinfo.set_role_client();
+  auto& fields = fdinfo.m_sockinfo.m_ipv4info.m_fields;
+  fields.m_sip = htonl(0x0a000001);
+  fields.m_sport = 40000;
+  fields.m_dip = htonl(0x0a000002);
+  fields.m_dport = 80;
+  fields.m_l4proto = SCAP_L4_TCP;
+
+  test::SyscallEvent connect_evt(inspector.get(), tinfo, PPME_SOCKET_CONNECT_X, 0, &fdinfo, 2000000);
+  EXPECT_EQ(network_handler.HandleSignal(connect_evt.get()), SignalHandler::PROCESSED);
+
+  Connection conn("abc", Endpoint(Address(10, 0, 0, 1), 40000), Endpoint(Address(10, 0, 0, 2), 80), L4Proto::TCP, false);
+  EXPECT_THAT(conn_tracker->FetchConnState(false, false), UnorderedElementsAre(std::make_pair(conn, ConnStatus(2000, true))));
+
+  EXPECT_CALL(client, Stop());
+  process_handler.Stop();
+}
+
+TEST(KernelDriverTest, TestListenOnlyWhenTracked) {
+  MockCollectorConfig config;
+  KernelDriverCOREEBPF driver;
+
+  auto ppm_sc = driver.GetSyscallList(config);
+  EXPECT_EQ(ppm_sc.count(PPM_SC_LISTEN), 0);
+  EXPECT_EQ(ppm_sc.count(PPM_SC_BIND), 0);
+
+  // bind is what gives sinsp the address of the socket.
+  config.SetTrackListenEndpoints(true);
+  auto with_listen = driver.GetSyscallList(config);
+  EXPECT_EQ(with_listen.count(PPM_SC_LISTEN), 1);
+  EXPECT_EQ(with_listen.count(PPM_SC_BIND), 1);
+
+  with_listen.erase(PPM_SC_LISTEN);
+  with_listen.erase(PPM_SC_BIND);
+  EXPECT_EQ(ppm_sc, with_listen);
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Logging.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using ::testing::HasSubstr;
+
+size_t CountOccurrences(const std::string& str, const std::string& substr) {
+  size_t count = 0;
+  for (size_t pos = str.find(substr); pos != std::string::npos; pos = str.find(substr, pos + substr.size())) {
+    count++;
+  }
+  return count;
+}
+
+TEST(LoggingTest, TestThrottle) {
+  logging::LogThrottle throttle;
+  EXPECT_TRUE(throttle.Allow(std::chrono::hours(1)));
+  EXPECT_FALSE(throttle.Allow(std::chrono::hours(1)));
+
+  logging::LogThrottle unthrottled;
+  EXPECT_TRUE(unthrottled.Allow(std::chrono::seconds(0)));
+  EXPECT_TRUE(unthrottled.Allow(std::chrono::seconds(0)));
+}
+
+TEST(LoggingTest, TestThrottledSkipsFormatting) {
+  int formatted = 0;
+  auto format = [&formatted]() { return ++formatted; };
+
+  testing::internal::CaptureStderr();
+  for (int i = 0; i < 10; i++) {
+    CLOG_THROTTLED(INFO, std::chrono::hours(1)) << "throttled " << format();
+  }
+  std::string output = testing::internal::GetCapturedStderr();
+
+  EXPECT_EQ(formatted, 1);
+  EXPECT_THAT(output, HasSubstr("[Throttled] throttled 1"));
+}
+
+TEST(LoggingTest, TestAsync) {
+  auto before = logging::GetAsyncLogStats();
+
+  testing::internal::CaptureStderr();
+  ASSERT_TRUE(logging::StartAsyncLogging());
+  EXPECT_FALSE(logging::StartAsyncLogging());
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([t]() {
+      for (int i = 0; i < 100; i++) {
+        CLOG(INFO) << "async message " << t;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  logging::StopAsyncLogging();
+  std::string output = testing::internal::GetCapturedStderr();
+
+  auto after = logging::GetAsyncLogStats();
+  EXPECT_EQ(after.records - before.records, 400);
+  EXPECT_EQ(after.drops, before.drops);
+  for (int t = 0; t < 4; t++) {
+    EXPECT_EQ(CountOccurrences(output, "async message " + std::to_string(t) + "\n"), 100);
+  }
+}
+
+TEST(LoggingTest, TestAsyncStopWhileLogging) {
+  auto before = logging::GetAsyncLogStats();
+
+  testing::internal::CaptureStderr();
+  ASSERT_TRUE(logging::StartAsyncLogging(1 << 16));
+
+  // Records logged while the logger stops are either queued and flushed by
+  // Stop, or written synchronously, none is lost.
+  std::atomic<bool> started(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&started]() {
+      for (int i = 0; i < 2000; i++) {
+        CLOG(INFO) << "stopping message";
+        started = true;
+      }
+    });
+  }
+  while (!started) {
+    std::this_thread::yield();
+  }
+  logging::StopAsyncLogging();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::string output = testing::internal::GetCapturedStderr();
+
+  auto after = logging::GetAsyncLogStats();
+  EXPECT_EQ(after.drops, before.drops);
+  EXPECT_EQ(CountOccurrences(output, "stopping message\n"), 8000);
+}
+
+TEST(LoggingTest, TestAsyncDrops) {
+  auto before = logging::GetAsyncLogStats();
+
+  testing::internal::CaptureStderr();
+  // The writer does not flush before being stopped, hence the ring fills up.
+  ASSERT_TRUE(logging::StartAsyncLogging(4, std::chrono::hours(1)));
+
+  std::thread thread([]() {
+    for (int i = 0; i < 10; i++) {
+      CLOG(INFO) << "message " << i;
+    }
+  });
+  thread.join();
+
+  logging::StopAsyncLogging();
+  std::string output = testing::internal::GetCapturedStderr();
+
+  auto after = logging::GetAsyncLogStats();
+  EXPECT_EQ(after.records - before.records, 4);
+  EXPECT_EQ(after.drops - before.drops, 6);
+  EXPECT_THAT(output, HasSubstr("message 3\n"));
+  EXPECT_THAT(output, Not(HasSubstr("message 4\n")));
+  EXPECT_THAT(output, HasSubstr("Dropped 6 log messages"));
+
+  // Once stopped, messages are written synchronously.
+  testing::internal::CaptureStderr();
+  CLOG(INFO) << "sync message";
+  EXPECT_THAT(testing::internal::GetCapturedStderr(), HasSubstr("sync message\n"));
+}
+
+}  // namespace
+
+}  // namespace collector
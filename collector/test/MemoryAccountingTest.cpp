@@ -0,0 +1,94 @@
+#include <string>
+#include <unordered_map>
+
+#include "ConnTracker.h"
+#include "MemoryAccounting.h"
+#include "RateLimit.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+MemoryUsage GetUsage(const std::string& subsystem) {
+  auto usage = MemoryAccounting::GetOrCreate().Collect();
+  auto it = usage.find(subsystem);
+  return it == usage.end() ? MemoryUsage() : it->second;
+}
+
+TEST(MemoryAccountingTest, TestRegistration) {
+  {
+    auto first = MemoryAccounting::GetOrCreate().Register("test_subsystem", [] { return MemoryUsage{1, 100}; });
+    auto second = MemoryAccounting::GetOrCreate().Register("test_subsystem", [] { return MemoryUsage{2, 200}; });
+
+    MemoryUsage usage = GetUsage("test_subsystem");
+    EXPECT_EQ(usage.entries, 3);
+    EXPECT_EQ(usage.bytes, 300);
+
+    MemoryAccounting::Registration moved = std::move(second);
+    EXPECT_EQ(GetUsage("test_subsystem").bytes, 300);
+  }
+
+  EXPECT_EQ(MemoryAccounting::GetOrCreate().Collect().count("test_subsystem"), 0);
+}
+
+TEST(MemoryAccountingTest, TestGauge) {
+  {
+    MemoryGauge gauge("test_gauge");
+    EXPECT_EQ(GetUsage("test_gauge").bytes, 0);
+
+    gauge.Set({10, 1000});
+    EXPECT_EQ(GetUsage("test_gauge").entries, 10);
+    EXPECT_EQ(GetUsage("test_gauge").bytes, 1000);
+  }
+
+  EXPECT_EQ(MemoryAccounting::GetOrCreate().Collect().count("test_gauge"), 0);
+}
+
+TEST(MemoryAccountingTest, TestApproxHashContainerBytes) {
+  std::unordered_map<int, int> map;
+  size_t empty_bytes = ApproxHashContainerBytes(map);
+
+  for (int i = 0; i < 1000; i++) {
+    map[i] = i;
+  }
+  EXPECT_GE(ApproxHashContainerBytes(map), empty_bytes + 1000 * sizeof(std::pair<const int, int>));
+}
+
+TEST(MemoryAccountingTest, TestConnectionTracker) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(192, 168, 1, 10), 9999);
+
+  ConnectionTracker tracker;
+  tracker.AddConnection(Connection("xyz", a, b, L4Proto::TCP, true), 1000);
+  tracker.AddConnection(Connection("xyz", b, a, L4Proto::TCP, false), 1000);
+
+  MemoryUsage usage = GetUsage("conn_tracker_connections");
+  EXPECT_EQ(usage.entries, 2);
+  EXPECT_GT(usage.bytes, 0);
+  EXPECT_EQ(GetUsage("conn_tracker_endpoints").entries, 0);
+}
+
+TEST(MemoryAccountingTest, TestRateLimitCache) {
+  RateLimitCache cache(2, 2, 5);
+  cache.Allow("a-key-longer-than-the-inline-string-buffer");
+  cache.Allow("another-key-longer-than-the-inline-buffer");
+
+  MemoryUsage usage = GetUsage("rate_limit_cache");
+  EXPECT_EQ(usage.entries, 2);
+  EXPECT_GT(usage.bytes, 80);
+
+  // Flushed when over capacity.
+  cache.Allow("c");
+  EXPECT_EQ(GetUsage("rate_limit_cache").entries, 0);
+}
+
+TEST(MemoryAccountingTest, TestReadResidentBytes) {
+  EXPECT_GT(ReadResidentBytes(), 0);
+  EXPECT_EQ(ReadResidentBytes("/nonexistent"), 0);
+}
+
+}  // namespace
+
+}  // namespace collector
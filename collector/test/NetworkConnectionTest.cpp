@@ -1,4 +1,8 @@
+#include <chrono>
+#include <iostream>
+#include <random>
 #include <utility>
+#include <vector>
 
 #include "NetworkConnection.h"
 #include "Utility.h"
@@ -67,6 +71,96 @@ TEST(TestAddress, TestMaskAndIsPublic) {
   EXPECT_FALSE(mask.Contains(Address(172, 32, 0, 0)));
 }
 
+// The address classification used by the releases before the prefix tables.
+bool IsPublicLinear(const Address& address) {
+  for (const auto& net : PrivateNetworks(address.family())) {
+    if (net.Contains(address)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Random addresses, about half of them in private networks, and half of them
+// IPv6 (of which half are IPv4-mapped).
+std::vector<Address> RandomAddresses(size_t count) {
+  std::mt19937_64 gen(42);
+  std::vector<Address> addresses;
+  addresses.reserve(count);
+  const auto& private_nets = PrivateIPv4Networks();
+  for (size_t i = 0; i < count; i++) {
+    uint64_t bits = gen();
+    Address ipv4(htonl(static_cast<uint32_t>(bits)));
+    if (bits & (1ULL << 32)) {
+      const auto& net = private_nets[(bits >> 40) % private_nets.size()];
+      uint64_t host_mask = (1ULL << (32 - net.bits())) - 1;
+      ipv4 = Address(htonl(static_cast<uint32_t>((ntohll(net.address().array()[0]) >> 32) | (bits & host_mask))));
+    }
+
+    switch ((bits >> 33) & 0x3) {
+      case 0:
+        addresses.push_back(Address(htonll((bits & (1ULL << 35)) ? 0xfd00000000000000ULL | (bits >> 8) : bits), gen()));
+        break;
+      case 1:
+        addresses.push_back(ipv4.ToV6());
+        break;
+      default:
+        addresses.push_back(ipv4);
+    }
+  }
+  return addresses;
+}
+
+TEST(TestAddress, TestIsPublicMatchesPrivateNetworks) {
+  for (const auto& address : RandomAddresses(100000)) {
+    EXPECT_EQ(address.IsPublic(), IsPublicLinear(address)) << address;
+  }
+
+  // Network boundaries.
+  for (const auto& net : PrivateIPv4Networks()) {
+    Address first = net.address();
+    uint32_t host_mask = (1U << (32 - net.bits())) - 1;
+    Address last(htonl(static_cast<uint32_t>(ntohll(first.array()[0]) >> 32) | host_mask));
+    EXPECT_FALSE(first.IsPublic()) << net;
+    EXPECT_FALSE(last.IsPublic()) << net;
+    EXPECT_FALSE(first.ToV6().IsPublic()) << net;
+    EXPECT_FALSE(last.ToV6().IsPublic()) << net;
+  }
+  EXPECT_FALSE(Address(htonll(0xfd00000000000000ULL), 0ULL).IsPublic());
+  EXPECT_FALSE(Address(htonll(0xfdffffffffffffffULL), ~0ULL).IsPublic());
+  EXPECT_TRUE(Address(9, 255, 255, 255).IsPublic());
+  EXPECT_TRUE(Address(11, 0, 0, 0).IsPublic());
+  EXPECT_TRUE(Address(100, 63, 255, 255).IsPublic());
+  EXPECT_TRUE(Address(100, 128, 0, 0).IsPublic());
+  EXPECT_TRUE(Address(172, 32, 0, 0).IsPublic());
+  EXPECT_TRUE(Address(192, 169, 0, 0).IsPublic());
+  EXPECT_TRUE(Address(htonll(0xfc00000000000000ULL), 1ULL).IsPublic());
+  EXPECT_TRUE(Address(htonll(0xfe00000000000000ULL), 1ULL).IsPublic());
+  EXPECT_TRUE(Address().IsPublic());
+}
+
+TEST(TestAddress, BenchmarkIsPublic) {
+  auto addresses = RandomAddresses(1000000);
+
+  auto t1 = std::chrono::steady_clock::now();
+  size_t linear_public = 0;
+  for (const auto& address : addresses) {
+    linear_public += IsPublicLinear(address);
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  size_t table_public = 0;
+  for (const auto& address : addresses) {
+    table_public += address.IsPublic();
+  }
+  auto t3 = std::chrono::steady_clock::now();
+
+  EXPECT_EQ(linear_public, table_public);
+  std::chrono::duration<double, std::nano> linear_dur = t2 - t1;
+  std::chrono::duration<double, std::nano> table_dur = t3 - t2;
+  std::cout << "Linear lookup: " << linear_dur.count() / addresses.size() << " ns/address" << std::endl;
+  std::cout << "Prefix tables: " << table_dur.count() / addresses.size() << " ns/address" << std::endl;
+}
+
 TEST(TestAddress, TestLoopback) {
   Address a(127, 0, 10, 1);
   EXPECT_TRUE(a.IsLocal());
@@ -162,6 +256,91 @@ TEST(TestIPNet, Parse) {
   EXPECT_FALSE(ip_net);
 }
 
+TEST(TestCompactConnection, RoundTrip) {
+  Endpoint a(Address(192, 168, 0, 1), 80);
+  Endpoint b(Address(htonll(0x20010db800000000ULL), htonll(1ULL)), 443);
+  Endpoint c(IPNet(Address(10, 1, 2, 3), 8), 0);
+  Endpoint d(IPNet(Address(192, 168, 0, 1), 0, true), 8080);
+
+  std::vector<Connection> conns = {
+      Connection("xyz", a, b, L4Proto::TCP, false),
+      Connection("xyz", a, c, L4Proto::UDP, true),
+      Connection("abc", d, Endpoint(), L4Proto::ICMP, true),
+      Connection(),
+  };
+
+  for (const auto& conn : conns) {
+    CompactConnection compact(conn);
+    EXPECT_EQ(compact.container(), conn.container());
+    EXPECT_EQ(compact.ToConnection(), conn);
+    EXPECT_EQ(compact.ToConnection().Hash(), conn.Hash());
+  }
+
+  // Networks are stored by their network address.
+  Connection conn1("xyz", a, Endpoint(IPNet(Address(10, 1, 2, 3), 8), 0), L4Proto::TCP, false);
+  Connection conn2("xyz", a, Endpoint(IPNet(Address(10, 0, 0, 0), 8), 0), L4Proto::TCP, false);
+  ASSERT_EQ(conn1, conn2);
+  EXPECT_EQ(CompactConnection(conn1), CompactConnection(conn2));
+  EXPECT_EQ(CompactConnection(conn1).Hash(), CompactConnection(conn2).Hash());
+
+  EXPECT_NE(CompactConnection(conns[0]), CompactConnection(conns[1]));
+  EXPECT_LT(sizeof(CompactConnection), sizeof(Connection) / 2);
+}
+
+TEST(TestCompactConnection, EqualityMatchesConnection) {
+  std::vector<Endpoint> endpoints = {
+      Endpoint(),
+      Endpoint(IPNet(Address(), 0, true), 0),
+      Endpoint(IPNet(Address(0, 0, 0, 0), 0), 0),
+      Endpoint(IPNet(Address(Address::Family::IPV6), 0), 0),
+      Endpoint(IPNet(Address(10, 1, 2, 3), 8), 0),
+      Endpoint(IPNet(Address(10, 0, 0, 0), 8), 0),
+      Endpoint(Address(10, 0, 0, 0), 0),
+      Endpoint(Address(10, 0, 0, 0), 80),
+      Endpoint(Address(htonll(0x0a00000000000000ULL), 0), 0),
+      Endpoint(IPNet(Address(htonll(0x0a00000000000000ULL), 0), 8), 0),
+  };
+
+  std::vector<Connection> conns;
+  Endpoint local(Address(192, 168, 0, 1), 8080);
+  for (const auto& endpoint : endpoints) {
+    conns.emplace_back("xyz", local, endpoint, L4Proto::TCP, false);
+    conns.emplace_back("xyz", endpoint, local, L4Proto::TCP, true);
+  }
+
+  for (const auto& conn1 : conns) {
+    for (const auto& conn2 : conns) {
+      CompactConnection compact1(conn1), compact2(conn2);
+      // Keys are the same entry of a ConnMap if they are equal and have the same hash. An address and a network can
+      // compare equal, but never hash the same, so they are distinct entries in both forms.
+      if (conn1 == conn2 && conn1.Hash() == conn2.Hash()) {
+        EXPECT_EQ(compact1, compact2) << conn1 << " " << conn2;
+        EXPECT_EQ(compact1.Hash(), compact2.Hash()) << conn1 << " " << conn2;
+      }
+      if (compact1 == compact2) {
+        EXPECT_EQ(conn1, conn2) << conn1 << " " << conn2;
+      }
+    }
+  }
+
+  // Networks of different families with the same prefix are the same key.
+  ASSERT_EQ(conns[4], conns[6]);
+  EXPECT_EQ(CompactConnection(conns[4]), CompactConnection(conns[6]));
+}
+
+TEST(TestCompactConnection, Accessors) {
+  Endpoint local(Address(192, 168, 0, 1), 8080);
+  Endpoint remote(IPNet(Address(10, 1, 2, 3), 8), 53);
+  Connection conn("xyz", local, remote, L4Proto::UDP, true);
+  CompactConnection compact(conn);
+
+  EXPECT_EQ(compact.l4proto(), L4Proto::UDP);
+  EXPECT_TRUE(compact.is_server());
+  EXPECT_EQ(compact.local_port(), 8080);
+  EXPECT_EQ(compact.remote_port(), 53);
+  EXPECT_EQ(compact.remote_address(), compact.ToConnection().remote().address());
+}
+
 }  // namespace
 
 }  // namespace collector
@@ -0,0 +1,141 @@
+// clang-format off
+#include <Utility.h>
+#include "libsinsp/sinsp.h"
+// clang-format on
+
+#include <arpa/inet.h>
+
+#include "ConnTracker.h"
+#include "NetworkSignalHandler.h"
+#include "SyscallEvent.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+using test::SyscallEvent;
+
+sinsp_threadinfo* AddProcess(sinsp* inspector) {
+  auto* tinfo = new sinsp_threadinfo(inspector);
+  tinfo->m_pid = 100;
+  tinfo->m_tid = 100;
+  tinfo->m_ptid = -1;
+  tinfo->m_vpid = 1;
+  tinfo->m_container_id = "abc";
+  tinfo->m_comm = "server";
+  tinfo->m_exepath = "/bin/server";
+  inspector->add_thread(tinfo);
+  return tinfo;
+}
+
+TEST(NetworkSignalHandlerTest, TestListenEndpointLifecycle) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  auto conn_tracker = std::make_shared<ConnectionTracker>();
+  SysdigStats stats;
+  NetworkSignalHandler handler(inspector.get(), conn_tracker, &stats);
+  handler.SetTrackListenEndpoints(true, nullptr);
+
+  auto* tinfo = AddProcess(inspector.get());
+
+  // The fd info is updated as the sinsp parser does: a socket has no address
+  // until it is bound.
+  sinsp_fdinfo fdinfo;
+  fdinfo.m_type = SCAP_FD_IPV4_SOCK;
+
+  SyscallEvent socket_evt(inspector.get(), tinfo, PPME_SOCKET_SOCKET_X, 3, &fdinfo, 1000000);
+  EXPECT_EQ(handler.HandleSignal(socket_evt.get()), SignalHandler::IGNORED);
+
+  // Without the bind event, there is nothing to report at listen.
+  SyscallEvent unbound_listen_evt(inspector.get(), tinfo, PPME_SOCKET_LISTEN_X, 0, &fdinfo, 1000000);
+  EXPECT_EQ(handler.HandleSignal(unbound_listen_evt.get()), SignalHandler::IGNORED);
+  EXPECT_THAT(conn_tracker->FetchEndpointState(false, false), IsEmpty());
+
+  fdinfo.m_type = SCAP_FD_IPV4_SERVSOCK;
+  fdinfo.m_sockinfo.m_ipv4serverinfo.m_ip = htonl(0x0a000001);
+  fdinfo.m_sockinfo.m_ipv4serverinfo.m_port = 8080;
+  fdinfo.m_sockinfo.m_ipv4serverinfo.m_l4proto = SCAP_L4_TCP;
+
+  SyscallEvent bind_evt(inspector.get(), tinfo, PPME_SOCKET_BIND_X, 0, &fdinfo, 1000000);
+  EXPECT_EQ(handler.HandleSignal(bind_evt.get()), SignalHandler::IGNORED);
+
+  ContainerEndpoint endpoint("abc", Endpoint(Address(10, 0, 0, 1), 8080), L4Proto::TCP, nullptr);
+
+  SyscallEvent listen_evt(inspector.get(), tinfo, PPME_SOCKET_LISTEN_X, 0, &fdinfo, 1000000);
+  EXPECT_EQ(handler.HandleSignal(listen_evt.get()), SignalHandler::PROCESSED);
+  EXPECT_THAT(conn_tracker->FetchEndpointState(false, false),
+              UnorderedElementsAre(std::make_pair(endpoint, ConnStatus(1000, true))));
+
+  SyscallEvent close_evt(inspector.get(), tinfo, PPME_SYSCALL_CLOSE_X, 0, &fdinfo, 2000000);
+  EXPECT_EQ(handler.HandleSignal(close_evt.get()), SignalHandler::PROCESSED);
+  EXPECT_THAT(conn_tracker->FetchEndpointState(false, false),
+              UnorderedElementsAre(std::make_pair(endpoint, ConnStatus(2000, false))));
+}
+
+TEST(NetworkSignalHandlerTest, TestListenIgnoredWhenNotTracked) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  auto conn_tracker = std::make_shared<ConnectionTracker>();
+  SysdigStats stats;
+  NetworkSignalHandler handler(inspector.get(), conn_tracker, &stats);
+
+  auto* tinfo = AddProcess(inspector.get());
+
+  sinsp_fdinfo fdinfo;
+  fdinfo.m_type = SCAP_FD_IPV4_SERVSOCK;
+  fdinfo.m_sockinfo.m_ipv4serverinfo.m_ip = htonl(0x0a000001);
+  fdinfo.m_sockinfo.m_ipv4serverinfo.m_port = 8080;
+  fdinfo.m_sockinfo.m_ipv4serverinfo.m_l4proto = SCAP_L4_TCP;
+
+  SyscallEvent listen_evt(inspector.get(), tinfo, PPME_SOCKET_LISTEN_X, 0, &fdinfo, 1000000);
+  EXPECT_EQ(handler.HandleSignal(listen_evt.get()), SignalHandler::IGNORED);
+  EXPECT_THAT(conn_tracker->FetchEndpointState(false, false), IsEmpty());
+}
+
+TEST(NetworkSignalHandlerTest, TestContainerExit) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  auto conn_tracker = std::make_shared<ConnectionTracker>();
+  SysdigStats stats;
+  NetworkSignalHandler handler(inspector.get(), conn_tracker, &stats);
+
+  Connection conn("abc", Endpoint(Address(10, 0, 0, 1), 40000), Endpoint(Address(10, 0, 0, 2), 80), L4Proto::TCP, false);
+  conn_tracker->AddConnection(conn, 1000);
+
+  // Processes other than the init process of the container do not close it.
+  auto* tinfo = AddProcess(inspector.get());
+  tinfo->m_vpid = 2;
+  SyscallEvent other_exit(inspector.get(), tinfo, PPME_PROCEXIT_1_E, 0, nullptr, 2000000);
+  EXPECT_EQ(handler.HandleSignal(other_exit.get()), SignalHandler::IGNORED);
+  EXPECT_THAT(conn_tracker->FetchConnState(false, false), UnorderedElementsAre(std::make_pair(conn, ConnStatus(1000, true))));
+
+  tinfo->m_vpid = 1;
+  SyscallEvent init_exit(inspector.get(), tinfo, PPME_PROCEXIT_1_E, 0, nullptr, 3000000);
+  EXPECT_EQ(handler.HandleSignal(init_exit.get()), SignalHandler::PROCESSED);
+  EXPECT_THAT(conn_tracker->FetchConnState(false, false), UnorderedElementsAre(std::make_pair(conn, ConnStatus(3000, false))));
+}
+
+}  // namespace
+
+TEST(NetworkSignalHandlerTest, TestContainerRemoved) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  auto conn_tracker = std::make_shared<ConnectionTracker>();
+  SysdigStats stats;
+  NetworkSignalHandler handler(inspector.get(), conn_tracker, &stats);
+
+  Connection conn1("abc", Endpoint(Address(10, 0, 0, 1), 40000), Endpoint(Address(10, 0, 0, 2), 80), L4Proto::TCP, false);
+  Connection conn2("def", Endpoint(Address(10, 0, 0, 3), 40000), Endpoint(Address(10, 0, 0, 2), 80), L4Proto::TCP, false);
+  conn_tracker->AddConnection(conn1, 1000);
+  conn_tracker->AddConnection(conn2, 1000);
+
+  handler.HandleContainerRemoved("abc");
+
+  auto state = conn_tracker->FetchConnState(false, false);
+  ASSERT_EQ(state.size(), 2u);
+  EXPECT_FALSE(state[conn1].IsActive());
+  EXPECT_GT(state[conn1].LastActiveTime(), 1000);
+  EXPECT_TRUE(state[conn2].IsActive());
+}
+
+}  // namespace collector
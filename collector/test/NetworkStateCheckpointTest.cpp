@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <fstream>
+
+#include "ConnTracker.h"
+#include "NetworkStateCheckpoint.h"
+#include "Process.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+class FakeProcess : public IProcess {
+ public:
+  FakeProcess(uint64_t pid, std::string comm, std::string exe_path, std::string args)
+      : pid_(pid), comm_(comm), exe_path_(exe_path), args_(args) {}
+
+  uint64_t pid() const override { return pid_; }
+  std::string container_id() const override { return "xyz"; }
+  std::string comm() const override { return comm_; }
+  std::string exe() const override { return exe_path_; }
+  std::string exe_path() const override { return exe_path_; }
+  std::string args() const override { return args_; }
+
+ private:
+  uint64_t pid_;
+  std::string comm_;
+  std::string exe_path_;
+  std::string args_;
+};
+
+class NetworkStateCheckpointTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = testing::TempDir() + "network_state_checkpoint";
+    std::remove(path_.c_str());
+
+    Endpoint a(Address(192, 168, 0, 1), 80);
+    Endpoint b(Address(192, 168, 1, 10), 9999);
+    Endpoint c(IPNet(Address(10, 0, 0, 0), 8), 0);
+    Endpoint d(Address(htonll(0x20010db800000000ULL), htonll(1ULL)), 443);
+
+    conn_state_.emplace(Connection("xyz", a, b, L4Proto::TCP, false), ConnStatus(1000, true));
+    conn_state_.emplace(Connection("xyz", b, c, L4Proto::UDP, true), ConnStatus(2000, false));
+    conn_state_.emplace(Connection("abc", d, a, L4Proto::TCP, true), ConnStatus(3000, true));
+
+    auto process = std::make_shared<FakeProcess>(1234, "nginx", "/usr/sbin/nginx", "-g daemon off;");
+    endpoint_state_.emplace(ContainerEndpoint("xyz", a, L4Proto::TCP, process), ConnStatus(1000, true));
+    endpoint_state_.emplace(ContainerEndpoint("abc", d, L4Proto::TCP, nullptr), ConnStatus(2000, false));
+  }
+
+  void TearDown() override {
+    std::remove(path_.c_str());
+  }
+
+  std::string path_;
+  ConnMap conn_state_;
+  AdvertisedEndpointMap endpoint_state_;
+};
+
+TEST_F(NetworkStateCheckpointTest, TestRoundTrip) {
+  NetworkStateCheckpoint checkpoint(path_, "boot-1");
+  ASSERT_TRUE(checkpoint.Write(conn_state_, endpoint_state_, 5000));
+
+  ConnMap conn_state;
+  AdvertisedEndpointMap endpoint_state;
+  int64_t timestamp = 0;
+  ASSERT_TRUE(checkpoint.Read(6000, 10000, &conn_state, &endpoint_state, &timestamp));
+
+  EXPECT_EQ(timestamp, 5000);
+  EXPECT_EQ(conn_state, conn_state_);
+
+  // Restored originators are new process objects, hence endpoints only compare equal as advertised endpoints.
+  ASSERT_EQ(endpoint_state.size(), endpoint_state_.size());
+  for (const auto& entry : endpoint_state_) {
+    auto it = endpoint_state.find(entry.first);
+    ASSERT_NE(it, endpoint_state.end());
+    EXPECT_EQ(it->second, entry.second);
+    if (entry.first.originator()) {
+      EXPECT_EQ(it->first.originator()->pid(), 1234);
+      EXPECT_EQ(it->first.originator()->container_id(), "xyz");
+    }
+  }
+}
+
+TEST_F(NetworkStateCheckpointTest, TestMissingFile) {
+  NetworkStateCheckpoint checkpoint(path_, "boot-1");
+
+  ConnMap conn_state;
+  AdvertisedEndpointMap endpoint_state;
+  int64_t timestamp = 0;
+  EXPECT_FALSE(checkpoint.Read(6000, 10000, &conn_state, &endpoint_state, &timestamp));
+}
+
+TEST_F(NetworkStateCheckpointTest, TestOtherBoot) {
+  ASSERT_TRUE(NetworkStateCheckpoint(path_, "boot-1").Write(conn_state_, endpoint_state_, 5000));
+
+  ConnMap conn_state;
+  AdvertisedEndpointMap endpoint_state;
+  int64_t timestamp = 0;
+  EXPECT_FALSE(NetworkStateCheckpoint(path_, "boot-2").Read(6000, 10000, &conn_state, &endpoint_state, &timestamp));
+  EXPECT_FALSE(NetworkStateCheckpoint(path_, "").Read(6000, 10000, &conn_state, &endpoint_state, &timestamp));
+  EXPECT_TRUE(conn_state.empty());
+}
+
+TEST_F(NetworkStateCheckpointTest, TestTooOld) {
+  NetworkStateCheckpoint checkpoint(path_, "boot-1");
+  ASSERT_TRUE(checkpoint.Write(conn_state_, endpoint_state_, 5000));
+
+  ConnMap conn_state;
+  AdvertisedEndpointMap endpoint_state;
+  int64_t timestamp = 0;
+  EXPECT_FALSE(checkpoint.Read(20000, 10000, &conn_state, &endpoint_state, &timestamp));
+  EXPECT_TRUE(conn_state.empty());
+}
+
+TEST_F(NetworkStateCheckpointTest, TestTruncated) {
+  NetworkStateCheckpoint checkpoint(path_, "boot-1");
+  ASSERT_TRUE(checkpoint.Write(conn_state_, endpoint_state_, 5000));
+
+  std::string content;
+  {
+    std::ifstream file(path_, std::ios::binary);
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  }
+  {
+    std::ofstream file(path_, std::ios::binary | std::ios::trunc);
+    file.write(content.data(), content.size() - 3);
+  }
+
+  ConnMap conn_state;
+  AdvertisedEndpointMap endpoint_state;
+  int64_t timestamp = 0;
+  EXPECT_FALSE(checkpoint.Read(6000, 10000, &conn_state, &endpoint_state, &timestamp));
+  EXPECT_TRUE(conn_state.empty());
+  EXPECT_TRUE(endpoint_state.empty());
+}
+
+}  // namespace
+
+}  // namespace collector
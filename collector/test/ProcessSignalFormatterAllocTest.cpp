@@ -0,0 +1,167 @@
+// clang-format off
+#include <Utility.h>
+#include "libsinsp/sinsp.h"
+// clang-format on
+
+#include "AllocationCounter.h"
+#include "CollectorStats.h"
+#include "ExecveEvent.h"
+#include "ProcessSignalFormatter.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using test::CountAllocations;
+
+TEST(ProcessSignalFormatterAllocTest, NoAllocationInSteadyState) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+
+  ProcessSignalFormatter processSignalFormatter(inspector.get());
+
+  auto* tinfo = new sinsp_threadinfo(inspector.get());
+  tinfo->m_pid = 3;
+  tinfo->m_tid = 3;
+  tinfo->m_ptid = -1;
+  tinfo->m_vpid = 1;
+  tinfo->m_user.uid = 42;
+  tinfo->m_container_id = "a1b2c3d4e5f6";
+  tinfo->m_exepath = "/usr/local/bin/a-rather-long-parent-path";
+  auto* tinfo2 = new sinsp_threadinfo(inspector.get());
+  tinfo2->m_pid = 1;
+  tinfo2->m_tid = 1;
+  tinfo2->m_ptid = 3;
+  tinfo2->m_vpid = 2;
+  tinfo2->m_user.uid = 7;
+  tinfo2->m_group.gid = 8;
+  tinfo2->m_container_id = "a1b2c3d4e5f6";
+  tinfo2->m_comm = "qwerty";
+  tinfo2->m_exepath = "/usr/local/bin/qwerty-with-a-long-name";
+  tinfo2->m_args = {"--some-long-argument", "with-a-long-value", "-x"};
+  inspector->add_thread(tinfo);
+  inspector->add_thread(tinfo2);
+
+  // The first message allocates the strings and the lineage.
+  const auto* msg = processSignalFormatter.ToProtoMessage(tinfo2);
+  ASSERT_NE(msg, nullptr);
+
+  size_t allocations = CountAllocations([&] {
+    for (int i = 0; i < 100; i++) {
+      msg = processSignalFormatter.ToProtoMessage(tinfo2);
+    }
+  });
+  EXPECT_EQ(allocations, 0);
+
+  ASSERT_NE(msg, nullptr);
+  const auto& signal = msg->signal().process_signal();
+  EXPECT_EQ(signal.name(), "qwerty");
+  EXPECT_EQ(signal.exec_file_path(), "/usr/local/bin/qwerty-with-a-long-name");
+  EXPECT_EQ(signal.args(), "--some-long-argument with-a-long-value -x");
+  EXPECT_EQ(signal.container_id(), "a1b2c3d4e5f6");
+  ASSERT_EQ(signal.lineage_info_size(), 1);
+  EXPECT_EQ(signal.lineage_info(0).parent_exec_file_path(), "/usr/local/bin/a-rather-long-parent-path");
+
+  CollectorStats::Reset();
+}
+
+TEST(ProcessSignalFormatterAllocTest, NoAllocationInSteadyStateForEvents) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+
+  ProcessSignalFormatter processSignalFormatter(inspector.get());
+
+  auto* tinfo = new sinsp_threadinfo(inspector.get());
+  tinfo->m_pid = 3;
+  tinfo->m_tid = 3;
+  tinfo->m_ptid = -1;
+  tinfo->m_vpid = 1;
+  tinfo->m_container_id = "a1b2c3d4e5f6";
+  tinfo->m_exepath = "/usr/local/bin/a-rather-long-parent-path";
+  auto* tinfo2 = new sinsp_threadinfo(inspector.get());
+  tinfo2->m_pid = 1;
+  tinfo2->m_tid = 1;
+  tinfo2->m_ptid = 3;
+  tinfo2->m_vpid = 2;
+  tinfo2->m_container_id = "a1b2c3d4e5f6";
+  tinfo2->m_comm = "qwerty";
+  tinfo2->m_exepath = "/usr/local/bin/qwerty-with-a-long-name";
+  tinfo2->m_args = {"--some-long-argument", "with-a-long-value", "-x"};
+  inspector->add_thread(tinfo);
+  inspector->add_thread(tinfo2);
+
+  test::ExecveEvent event(inspector.get(), tinfo2);
+
+  // The first message allocates the strings, the lineage and the storage of
+  // the field extractors.
+  const auto* msg = processSignalFormatter.ToProtoMessage(event.get());
+  ASSERT_NE(msg, nullptr);
+
+  size_t allocations = CountAllocations([&] {
+    for (int i = 0; i < 100; i++) {
+      msg = processSignalFormatter.ToProtoMessage(event.get());
+    }
+  });
+  EXPECT_EQ(allocations, 0);
+
+  ASSERT_NE(msg, nullptr);
+  const auto& signal = msg->signal().process_signal();
+  EXPECT_EQ(signal.name(), "qwerty");
+  EXPECT_EQ(signal.exec_file_path(), "/usr/local/bin/qwerty-with-a-long-name");
+  EXPECT_EQ(signal.args(), "--some-long-argument with-a-long-value -x");
+  EXPECT_EQ(signal.container_id(), "a1b2c3d4e5f6");
+  ASSERT_EQ(signal.lineage_info_size(), 1);
+  EXPECT_EQ(signal.lineage_info(0).parent_exec_file_path(), "/usr/local/bin/a-rather-long-parent-path");
+
+  CollectorStats::Reset();
+}
+
+TEST(ProcessSignalFormatterAllocTest, ProcessKeyAllocatesOnce) {
+  std::string key;
+  size_t allocations = CountAllocations([&] {
+    key = compute_process_key("a1b2c3d4e5f6", "qwerty", "--some-long-argument with-a-long-value -x",
+                              "/usr/local/bin/qwerty-with-a-long-name");
+  });
+  // The key is reserved at its final size.
+  EXPECT_EQ(allocations, 1);
+  EXPECT_EQ(key, "a1b2c3d4e5f6 qwerty --some-long-argument with-a-long-value -x /usr/local/bin/qwerty-with-a-long-name");
+}
+
+TEST(ProcessSignalFormatterAllocTest, SnapshotAllocationBudget) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  ProcessSignalFormatter processSignalFormatter(inspector.get());
+
+  ProcessSignalFormatter::ProcessSnapshot snapshot;
+  snapshot.name = "qwerty";
+  snapshot.exec_file_path = "/usr/local/bin/qwerty-with-a-long-name";
+  snapshot.args = "--some-long-argument with-a-long-value -x";
+  snapshot.pid = 1;
+  snapshot.container_id = "a1b2c3d4e5f6";
+  snapshot.lineage.emplace_back();
+  snapshot.lineage.back().set_parent_exec_file_path("/usr/local/bin/a-rather-long-parent-path");
+
+  // The first message grows the arena pool if needed.
+  ASSERT_NE(processSignalFormatter.ToProtoMessage(snapshot), nullptr);
+
+  // Messages are allocated in the arena, but the contents of their strings
+  // are not when longer than the inline buffer: the generated id (twice, once
+  // as a temporary), the exec file path, the arguments and the parent exec
+  // file path.
+  constexpr size_t kAllocationBudget = 5;
+  const sensor::SignalStreamMessage* msg = nullptr;
+  size_t allocations = CountAllocations([&] {
+    for (int i = 0; i < 100; i++) {
+      msg = processSignalFormatter.ToProtoMessage(snapshot);
+    }
+  });
+  EXPECT_LE(allocations, 100 * kAllocationBudget);
+
+  ASSERT_NE(msg, nullptr);
+  EXPECT_EQ(msg->signal().process_signal().exec_file_path(), snapshot.exec_file_path);
+
+  CollectorStats::Reset();
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -4,6 +4,7 @@
 // clang-format on
 
 #include "CollectorStats.h"
+#include "ExecveEvent.h"
 #include "ProcessSignalFormatter.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
@@ -613,6 +614,111 @@ TEST(ProcessSignalFormatterTest, Rox3377ProcessLineageWithNoVPidTest) {
   CollectorStats::Reset();
 }
 
+TEST(ProcessSignalFormatterTest, ProcessSnapshotTest) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+
+  ProcessSignalFormatter processSignalFormatter(inspector.get());
+
+  auto* tinfo = new sinsp_threadinfo(inspector.get());
+  tinfo->m_pid = 3;
+  tinfo->m_tid = 3;
+  tinfo->m_ptid = -1;
+  tinfo->m_vpid = 1;
+  tinfo->m_user.uid = 42;
+  tinfo->m_container_id = "id";
+  tinfo->m_exepath = "asdf";
+  auto* tinfo2 = new sinsp_threadinfo(inspector.get());
+  tinfo2->m_pid = 1;
+  tinfo2->m_tid = 1;
+  tinfo2->m_ptid = 3;
+  tinfo2->m_vpid = 2;
+  tinfo2->m_user.uid = 7;
+  tinfo2->m_group.gid = 8;
+  tinfo2->m_container_id = "id";
+  tinfo2->m_comm = "qwerty";
+  tinfo2->m_exepath = "/bin/qwerty";
+  tinfo2->m_args = {"-a", "b"};
+  inspector->add_thread(tinfo);
+  inspector->add_thread(tinfo2);
+
+  ProcessSignalFormatter::ProcessSnapshot snapshot;
+  EXPECT_TRUE(processSignalFormatter.GetProcessSnapshot(tinfo2, &snapshot));
+
+  // The snapshot no longer depends on the thread table.
+  inspector.reset();
+
+  const auto* msg = processSignalFormatter.ToProtoMessage(snapshot);
+  ASSERT_NE(msg, nullptr);
+
+  const auto& signal = msg->signal().process_signal();
+  EXPECT_EQ(signal.name(), "qwerty");
+  EXPECT_EQ(signal.exec_file_path(), "/bin/qwerty");
+  EXPECT_EQ(signal.args(), "-a b");
+  EXPECT_EQ(signal.pid(), 1);
+  EXPECT_EQ(signal.uid(), 7);
+  EXPECT_EQ(signal.gid(), 8);
+  EXPECT_EQ(signal.container_id(), "id");
+  EXPECT_TRUE(signal.scraped());
+
+  ASSERT_EQ(signal.lineage_info_size(), 1);
+  EXPECT_EQ(signal.lineage_info(0).parent_uid(), 42);
+  EXPECT_EQ(signal.lineage_info(0).parent_exec_file_path(), "asdf");
+
+  CollectorStats::Reset();
+}
+
+TEST(ProcessSignalFormatterTest, ProcessKeyTest) {
+  ProcessSignal signal;
+  signal.set_container_id("id");
+  signal.set_name("name");
+  signal.set_exec_file_path("/bin/name");
+  signal.set_args("a b c");
+
+  EXPECT_EQ(compute_process_key(signal), "id name a b c /bin/name");
+  EXPECT_EQ(compute_process_key(signal), compute_process_key("id", "name", "a b c", "/bin/name"));
+
+  // Only a prefix of the arguments is taken into account.
+  std::string args(2 * kProcessKeyMaxArgsLength, 'x');
+  signal.set_args(args);
+  EXPECT_EQ(compute_process_key(signal), compute_process_key("id", "name", args.substr(0, kProcessKeyMaxArgsLength), "/bin/name"));
+}
+
+TEST(ProcessSignalFormatterTest, ProcessKeyFromEventTest) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  ProcessSignalFormatter processSignalFormatter(inspector.get());
+
+  auto* tinfo = new sinsp_threadinfo(inspector.get());
+  tinfo->m_pid = 1;
+  tinfo->m_tid = 1;
+  tinfo->m_ptid = -1;
+  tinfo->m_vpid = 1;
+  tinfo->m_container_id = "id";
+  tinfo->m_comm = "name";
+  tinfo->m_exepath = "/bin/name";
+  tinfo->m_args = {"a", "b", "c"};
+  inspector->add_thread(tinfo);
+
+  test::ExecveEvent event(inspector.get(), tinfo);
+  std::string key;
+  ASSERT_TRUE(processSignalFormatter.GetProcessKey(event.get(), &key));
+  EXPECT_EQ(key, "id name a b c /bin/name");
+
+  // The key is the one of the signal the event is formatted into.
+  const auto* msg = processSignalFormatter.ToProtoMessageUnchecked(event.get());
+  ASSERT_NE(msg, nullptr);
+  EXPECT_EQ(key, compute_process_key(msg->signal().process_signal()));
+  EXPECT_EQ(msg, processSignalFormatter.ToProtoMessage(event.get()));
+  EXPECT_EQ(key, compute_process_key(msg->signal().process_signal()));
+
+  // Events which would not be formatted have no key.
+  tinfo->m_comm = "<NA>";
+  tinfo->m_exepath = "<NA>";
+  EXPECT_FALSE(processSignalFormatter.GetProcessKey(event.get(), &key));
+  EXPECT_EQ(processSignalFormatter.ToProtoMessage(event.get()), nullptr);
+
+  CollectorStats::Reset();
+}
+
 }  // namespace
 
 }  // namespace collector
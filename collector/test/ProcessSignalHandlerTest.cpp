@@ -0,0 +1,194 @@
+// clang-format off
+#include <Utility.h>
+#include "libsinsp/sinsp.h"
+// clang-format on
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+
+#include "CollectorStats.h"
+#include "ExecveEvent.h"
+#include "ProcessSignalHandler.h"
+#include "SignalServiceClient.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using ::testing::_;
+using ::testing::Invoke;
+
+class MockSignalServiceClient : public ISignalServiceClient {
+ public:
+  MOCK_METHOD0(Start, void());
+  MOCK_METHOD0(Stop, void());
+  MOCK_METHOD1(PushSignals, SignalHandler::Result(const SignalStreamMessage& msg));
+};
+
+// Adds processes with distinct paths, so that none of them is rate limited.
+std::vector<sinsp_threadinfo*> AddProcesses(sinsp* inspector, int count) {
+  std::vector<sinsp_threadinfo*> processes;
+  for (int i = 0; i < count; i++) {
+    auto* tinfo = new sinsp_threadinfo(inspector);
+    tinfo->m_pid = 100 + i;
+    tinfo->m_tid = 100 + i;
+    tinfo->m_ptid = -1;
+    tinfo->m_vpid = 100 + i;
+    tinfo->m_comm = "process";
+    tinfo->m_exepath = "/bin/process" + std::to_string(i);
+    inspector->add_thread(tinfo);
+    processes.push_back(tinfo);
+  }
+  return processes;
+}
+
+template <typename Predicate>
+bool WaitFor(Predicate predicate) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(ProcessSignalHandlerTest, TestStopWithoutStart) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  MockSignalServiceClient client;
+  SysdigStats stats;
+  ProcessSignalHandler handler(inspector.get(), &client, &stats);
+
+  EXPECT_CALL(client, Stop()).Times(2);
+  EXPECT_TRUE(handler.Stop());
+  EXPECT_TRUE(handler.Stop());
+}
+
+TEST(ProcessSignalHandlerTest, TestExistingProcessesSentInBatches) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  MockSignalServiceClient client;
+  SysdigStats stats;
+  ProcessSignalHandler handler(inspector.get(), &client, &stats);
+
+  // More than two batches.
+  const uint64_t kProcesses = 600;
+  for (auto* tinfo : AddProcesses(inspector.get(), kProcesses)) {
+    EXPECT_EQ(handler.HandleExistingProcess(tinfo), SignalHandler::PROCESSED);
+  }
+
+  std::atomic<uint64_t> pushed(0);
+  EXPECT_CALL(client, Start());
+  EXPECT_CALL(client, Stop());
+  EXPECT_CALL(client, PushSignals(_)).WillRepeatedly(Invoke([&](const auto&) {
+    pushed++;
+    return SignalHandler::PROCESSED;
+  }));
+
+  handler.Start();
+  EXPECT_TRUE(WaitFor([&] { return pushed.load() == kProcesses; }));
+  handler.Stop();
+
+  EXPECT_EQ(pushed.load(), kProcesses);
+  EXPECT_EQ(stats.nProcessSent, kProcesses);
+  EXPECT_EQ(stats.nProcessRateLimitCount, 0u);
+}
+
+TEST(ProcessSignalHandlerTest, TestExistingProcessesRefresh) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  MockSignalServiceClient client;
+  SysdigStats stats;
+  ProcessSignalHandler handler(inspector.get(), &client, &stats);
+
+  for (auto* tinfo : AddProcesses(inspector.get(), 10)) {
+    EXPECT_EQ(handler.HandleExistingProcess(tinfo), SignalHandler::PROCESSED);
+  }
+
+  // The stream is re-established by the first write, the pending processes
+  // are then dropped and the refresh is forwarded to the event loop.
+  std::atomic<int> pushed(0);
+  EXPECT_CALL(client, Start());
+  EXPECT_CALL(client, Stop());
+  EXPECT_CALL(client, PushSignals(_)).WillRepeatedly(Invoke([&](const auto&) {
+    pushed++;
+    return SignalHandler::NEEDS_REFRESH;
+  }));
+
+  handler.Start();
+  EXPECT_TRUE(WaitFor([&] { return handler.needs_refresh_.load(); }));
+  handler.Stop();
+
+  // The refresh request is checked before looking at the event.
+  EXPECT_EQ(handler.HandleSignal(nullptr), SignalHandler::NEEDS_REFRESH);
+  EXPECT_FALSE(handler.needs_refresh_.load());
+  EXPECT_EQ(pushed.load(), 1);
+  EXPECT_EQ(stats.nProcessSent, 0u);
+}
+
+TEST(ProcessSignalHandlerTest, TestExistingProcessesBackpressure) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  MockSignalServiceClient client;
+  SysdigStats stats;
+  ProcessSignalHandler handler(inspector.get(), &client, &stats);
+  CollectorStats::Reset();
+
+  // The stream is stuck until released.
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  EXPECT_CALL(client, Start());
+  EXPECT_CALL(client, Stop());
+  EXPECT_CALL(client, PushSignals(_)).WillRepeatedly(Invoke([&](const auto&) {
+    released.wait();
+    return SignalHandler::PROCESSED;
+  }));
+  handler.Start();
+
+  // One batch at most is taken by the stuck thread, the next snapshot then
+  // has to wait.
+  const size_t kProcesses = ProcessSignalHandler::kMaxPendingExistingProcesses + ProcessSignalHandler::kExistingProcessBatchSize + 1;
+  auto* tinfo = AddProcesses(inspector.get(), 1)[0];
+  std::atomic<size_t> handled(0);
+  std::thread producer([&] {
+    for (size_t i = 0; i < kProcesses; i++) {
+      EXPECT_EQ(handler.HandleExistingProcess(tinfo), SignalHandler::PROCESSED);
+      handled++;
+    }
+  });
+
+  EXPECT_TRUE(WaitFor([&] { return CollectorStats::GetOrCreate().GetCounter(CollectorStats::process_existing_waits) == 1; }));
+  EXPECT_LT(handled.load(), kProcesses);
+
+  // No snapshot is dropped: all of them are either sent or rate limited.
+  release.set_value();
+  producer.join();
+  EXPECT_TRUE(WaitFor([&] { return stats.nProcessSent + stats.nProcessRateLimitCount == kProcesses; }));
+
+  handler.Stop();
+  CollectorStats::Reset();
+}
+
+TEST(ProcessSignalHandlerTest, TestInvalidEventNotRateLimited) {
+  std::unique_ptr<sinsp> inspector(new sinsp());
+  MockSignalServiceClient client;
+  SysdigStats stats;
+  ProcessSignalHandler handler(inspector.get(), &client, &stats);
+
+  auto* tinfo = AddProcesses(inspector.get(), 1)[0];
+  tinfo->m_comm = "<NA>";
+  tinfo->m_exepath = "<NA>";
+
+  test::ExecveEvent event(inspector.get(), tinfo);
+  EXPECT_CALL(client, PushSignals(_)).Times(0);
+  EXPECT_EQ(handler.HandleSignal(event.get()), SignalHandler::IGNORED);
+  EXPECT_EQ(stats.nProcessResolutionFailuresByEvt, 1u);
+  EXPECT_EQ(stats.nProcessRateLimitCount, 0u);
+
+  EXPECT_CALL(client, Stop());
+  handler.Stop();
+}
+
+}  // namespace collector
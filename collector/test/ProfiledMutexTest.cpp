@@ -0,0 +1,116 @@
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "CollectorStats.h"
+#include "ProfiledMutex.h"
+#include "Utility.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+class ProfiledMutexTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    CollectorStats::Reset();
+    ProfiledMutex::EnableProfiling(true);
+  }
+
+  void TearDown() override {
+    ProfiledMutex::EnableProfiling(false);
+    CollectorStats::Reset();
+  }
+
+  static int64_t SumBuckets(int64_t (CollectorStats::*get_bucket)(size_t, int) const, int lock) {
+    int64_t sum = 0;
+    for (int b = 0; b < CollectorStats::kLockHistogramBuckets; b++) {
+      sum += (CollectorStats::GetOrCreate().*get_bucket)(lock, b);
+    }
+    return sum;
+  }
+};
+
+TEST(LockHistogramTest, TestBuckets) {
+  EXPECT_EQ(CollectorStats::LockHistogramBucket(0), 0);
+  EXPECT_EQ(CollectorStats::LockHistogramBucket(1), 1);
+  EXPECT_EQ(CollectorStats::LockHistogramBucket(2), 2);
+  EXPECT_EQ(CollectorStats::LockHistogramBucket(3), 2);
+  EXPECT_EQ(CollectorStats::LockHistogramBucket(1023), 10);
+  EXPECT_EQ(CollectorStats::LockHistogramBucket(1024), 11);
+  EXPECT_EQ(CollectorStats::LockHistogramBucket(int64_t{1} << 40), CollectorStats::kLockHistogramBuckets - 1);
+}
+
+TEST_F(ProfiledMutexTest, TestDisabled) {
+  ProfiledMutex::EnableProfiling(false);
+  ProfiledMutex mutex(CollectorStats::lock_conn_tracker);
+
+  {
+    std::lock_guard<ProfiledMutex> lock(mutex);
+  }
+
+  EXPECT_EQ(CollectorStats::GetOrCreate().GetLockAcquisitions(CollectorStats::lock_conn_tracker), 0);
+}
+
+TEST_F(ProfiledMutexTest, TestUncontended) {
+  ProfiledMutex mutex(CollectorStats::lock_conn_tracker);
+
+  for (int i = 0; i < 10; i++) {
+    WITH_LOCK(mutex) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  ASSERT_TRUE(mutex.try_lock());
+  mutex.unlock();
+
+  auto& stats = CollectorStats::GetOrCreate();
+  int lock = CollectorStats::lock_conn_tracker;
+  EXPECT_EQ(stats.GetLockAcquisitions(lock), 11);
+  EXPECT_EQ(stats.GetLockContentions(lock), 0);
+  EXPECT_EQ(stats.GetLockWaitMicros(lock), 0);
+  EXPECT_GE(stats.GetLockHoldMicros(lock), 1000);
+  EXPECT_EQ(SumBuckets(&CollectorStats::GetLockHoldBucket, lock), 11);
+  EXPECT_EQ(SumBuckets(&CollectorStats::GetLockWaitBucket, lock), 0);
+}
+
+TEST_F(ProfiledMutexTest, TestContended) {
+  ProfiledMutex mutex(CollectorStats::lock_sysdig_process_requests);
+
+  mutex.lock();
+  std::thread waiter([&mutex]() {
+    std::lock_guard<ProfiledMutex> lock(mutex);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  mutex.unlock();
+  waiter.join();
+
+  auto& stats = CollectorStats::GetOrCreate();
+  int lock = CollectorStats::lock_sysdig_process_requests;
+  EXPECT_EQ(stats.GetLockAcquisitions(lock), 2);
+  EXPECT_EQ(stats.GetLockContentions(lock), 1);
+  EXPECT_GE(stats.GetLockWaitMicros(lock), 10000);
+  EXPECT_EQ(SumBuckets(&CollectorStats::GetLockWaitBucket, lock), 1);
+  EXPECT_EQ(SumBuckets(&CollectorStats::GetLockHoldBucket, lock), 2);
+
+  // Other locks are unaffected.
+  EXPECT_EQ(stats.GetLockAcquisitions(CollectorStats::lock_conn_tracker), 0);
+}
+
+TEST_F(ProfiledMutexTest, TestToggledWhileHeld) {
+  ProfiledMutex mutex(CollectorStats::lock_conn_tracker);
+
+  ProfiledMutex::EnableProfiling(false);
+  mutex.lock();
+  ProfiledMutex::EnableProfiling(true);
+  mutex.unlock();
+
+  // No hold time is recorded for an acquisition that was not.
+  EXPECT_EQ(CollectorStats::GetOrCreate().GetLockHoldMicros(CollectorStats::lock_conn_tracker), 0);
+  EXPECT_EQ(SumBuckets(&CollectorStats::GetLockHoldBucket, CollectorStats::lock_conn_tracker), 0);
+}
+
+}  // namespace
+
+}  // namespace collector
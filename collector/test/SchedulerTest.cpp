@@ -0,0 +1,129 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "CollectorStats.h"
+#include "Scheduler.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+// Waits for up to 5 seconds for the condition to become true.
+template <typename Fn>
+bool WaitFor(Fn fn) {
+  for (int i = 0; i < 500 && !fn(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return fn();
+}
+
+TEST(SchedulerTest, TestOnce) {
+  // Without workers, tasks run on the dispatcher thread.
+  Scheduler scheduler;
+  EXPECT_EQ(scheduler.NumWorkers(), 0u);
+  ASSERT_TRUE(scheduler.Start());
+
+  std::atomic<int> runs(0);
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<std::chrono::steady_clock::duration> delay{};
+  auto id = scheduler.ScheduleOnce("once", std::chrono::milliseconds(50), [&] {
+    delay = std::chrono::steady_clock::now() - start;
+    runs++;
+  });
+
+  ASSERT_TRUE(WaitFor([&] { return runs == 1; }));
+  EXPECT_GE(delay.load(), std::chrono::milliseconds(50));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(runs, 1);
+
+  // The task is gone once it ran.
+  EXPECT_FALSE(scheduler.Cancel(id));
+
+  scheduler.Stop();
+}
+
+TEST(SchedulerTest, TestPeriodic) {
+  Scheduler scheduler;
+  ASSERT_TRUE(scheduler.Start());
+
+  std::atomic<int> runs(0);
+  auto id = scheduler.SchedulePeriodic("periodic", std::chrono::milliseconds(20), [&] { runs++; });
+  ASSERT_TRUE(WaitFor([&] { return runs >= 5; }));
+
+  EXPECT_TRUE(scheduler.Cancel(id));
+  EXPECT_FALSE(scheduler.Cancel(id));
+  int cancelled_runs = runs;
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(runs, cancelled_runs);
+
+  EXPECT_GE(CollectorStats::GetOrCreate().GetTimerCount(CollectorStats::scheduler_task_lateness), 5);
+
+  scheduler.Stop();
+  CollectorStats::Reset();
+}
+
+TEST(SchedulerTest, TestNoOverlap) {
+  Scheduler scheduler(4);
+  ASSERT_TRUE(scheduler.Start());
+
+  std::atomic<int> running(0);
+  std::atomic<int> max_running(0);
+  std::atomic<int> runs(0);
+  auto id = scheduler.SchedulePeriodic("slow", std::chrono::milliseconds(10), [&] {
+    int now_running = ++running;
+    max_running = std::max<int>(max_running, now_running);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    running--;
+    runs++;
+  });
+
+  ASSERT_TRUE(WaitFor([&] { return runs >= 3; }));
+  scheduler.Cancel(id);
+  EXPECT_EQ(running, 0);
+  EXPECT_EQ(max_running, 1);
+
+  scheduler.Stop();
+  CollectorStats::Reset();
+}
+
+TEST(SchedulerTest, TestScheduledBeforeStart) {
+  Scheduler scheduler;
+
+  std::atomic<int> runs(0);
+  scheduler.ScheduleOnce("early", std::chrono::milliseconds(0), [&] { runs++; });
+  ASSERT_TRUE(scheduler.Start());
+
+  EXPECT_TRUE(WaitFor([&] { return runs == 1; }));
+  scheduler.Stop();
+  CollectorStats::Reset();
+}
+
+TEST(SchedulerTest, TestDeferral) {
+  Scheduler scheduler;
+  std::atomic<bool> defer(true);
+  scheduler.SetDeferral([&defer] { return defer.load(); });
+  ASSERT_TRUE(scheduler.Start());
+
+  std::atomic<int> deferrable_runs(0);
+  std::atomic<int> urgent_runs(0);
+  scheduler.SchedulePeriodic("deferrable", std::chrono::milliseconds(20), [&] { deferrable_runs++; }, true);
+  scheduler.SchedulePeriodic("urgent", std::chrono::milliseconds(20), [&] { urgent_runs++; });
+
+  ASSERT_TRUE(WaitFor([&] { return urgent_runs >= 5; }));
+  EXPECT_EQ(deferrable_runs, 0);
+  EXPECT_GE(CollectorStats::GetOrCreate().GetCounter(CollectorStats::scheduler_deferred_runs), 1);
+
+  defer = false;
+  EXPECT_TRUE(WaitFor([&] { return deferrable_runs >= 1; }));
+
+  scheduler.Stop();
+  CollectorStats::Reset();
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -0,0 +1,50 @@
+#ifndef COLLECTOR_TEST_SYSCALLEVENT_H
+#define COLLECTOR_TEST_SYSCALLEVENT_H
+
+// Builds a syscall event without going through a driver, in the state the
+// sinsp parser leaves it in for the signal handlers: with its thread info and,
+// for syscalls on a file descriptor, its fd info. Only the first parameter
+// (the return value of exit events) is encoded.
+
+#include <gtest/gtest.h>
+
+#include "libsinsp/sinsp.h"
+
+namespace collector {
+namespace test {
+
+class SyscallEvent {
+ public:
+  SyscallEvent(sinsp* inspector, sinsp_threadinfo* tinfo, ppm_event_code type, int64_t param,
+               sinsp_fdinfo* fdinfo = nullptr, uint64_t ts = 1000) {
+    char error[SCAP_LASTERR_SIZE];
+    size_t size = 0;
+    if (scap_event_encode_params({buffer_, sizeof(buffer_)}, &size, error, type, 1, param) != SCAP_SUCCESS) {
+      ADD_FAILURE() << "Could not encode event " << type << ": " << error;
+    }
+
+    auto* header = reinterpret_cast<scap_evt*>(buffer_);
+    header->ts = ts;
+    header->tid = tinfo->m_tid;
+
+    evt_.set_inspector(inspector);
+    evt_.set_scap_evt(header);
+    evt_.init();
+    evt_.set_tinfo(tinfo);
+    evt_.set_fd_info(fdinfo);
+  }
+
+  SyscallEvent(const SyscallEvent&) = delete;
+  SyscallEvent& operator=(const SyscallEvent&) = delete;
+
+  sinsp_evt* get() { return &evt_; }
+
+ private:
+  alignas(scap_evt) char buffer_[128] = {};
+  sinsp_evt evt_;
+};
+
+}  // namespace test
+}  // namespace collector
+
+#endif  // COLLECTOR_TEST_SYSCALLEVENT_H
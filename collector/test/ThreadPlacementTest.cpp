@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "ThreadPlacement.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+std::vector<int> ToVector(const cpu_set_t& cpus) {
+  std::vector<int> result;
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &cpus)) {
+      result.push_back(cpu);
+    }
+  }
+  return result;
+}
+
+TEST(ThreadPlacementTest, TestParseCPUList) {
+  cpu_set_t cpus;
+
+  ASSERT_TRUE(ThreadPlacement::ParseCPUList("3", &cpus));
+  EXPECT_THAT(ToVector(cpus), testing::ElementsAre(3));
+
+  ASSERT_TRUE(ThreadPlacement::ParseCPUList("0-2,5,7-8", &cpus));
+  EXPECT_THAT(ToVector(cpus), testing::ElementsAre(0, 1, 2, 5, 7, 8));
+
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("", &cpus));
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("a", &cpus));
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("3-1", &cpus));
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("1-", &cpus));
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("1,,2", &cpus));
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("100000", &cpus));
+}
+
+TEST(ThreadPlacementTest, TestParseNUMANodes) {
+  std::string node_dir = testing::TempDir() + "thread_placement_nodes";
+  mkdir(node_dir.c_str(), 0755);
+  mkdir((node_dir + "/node1").c_str(), 0755);
+  std::ofstream(node_dir + "/node1/cpulist") << "4-5,12\n";
+
+  cpu_set_t cpus;
+  ASSERT_TRUE(ThreadPlacement::ParseCPUList("node1,0", &cpus, node_dir));
+  EXPECT_THAT(ToVector(cpus), testing::ElementsAre(0, 4, 5, 12));
+
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("node2", &cpus, node_dir));
+  EXPECT_FALSE(ThreadPlacement::ParseCPUList("node", &cpus, node_dir));
+}
+
+TEST(ThreadPlacementTest, TestApply) {
+  cpu_set_t allowed;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+  int cpu = ToVector(allowed).front();
+
+  ThreadPlacementConfig config;
+  config.network_cpus = std::to_string(cpu);
+  ThreadPlacement::Configure(config);
+
+  std::thread thread([cpu] {
+    ThreadPlacement::Apply("placement-test-name", ThreadRole::NETWORK);
+
+    char name[16] = {};
+    prctl(PR_GET_NAME, name, 0, 0, 0);
+    EXPECT_STREQ(name, "placement-test-");
+
+    cpu_set_t cpus;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpus), &cpus), 0);
+    EXPECT_THAT(ToVector(cpus), testing::ElementsAre(cpu));
+  });
+  thread.join();
+
+  // Roles without a CPU list are not pinned.
+  std::thread background([&allowed] {
+    ThreadPlacement::Apply("background", ThreadRole::BACKGROUND);
+
+    cpu_set_t cpus;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpus), &cpus), 0);
+    EXPECT_TRUE(CPU_EQUAL(&cpus, &allowed));
+  });
+  background.join();
+
+  ThreadPlacement::Configure(ThreadPlacementConfig());
+}
+
+TEST(ThreadPlacementTest, TestUnpinnedRolesRestoreProcessAffinity) {
+  cpu_set_t allowed;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+  int cpu = ToVector(allowed).front();
+
+  ThreadPlacementConfig config;
+  config.event_loop_cpus = std::to_string(cpu);
+  ThreadPlacement::Configure(config);
+
+  // Threads started from the pinned event loop inherit its affinity, which
+  // is reset for the roles which are not pinned.
+  std::thread event_loop([&allowed, cpu] {
+    ThreadPlacement::Apply("event-loop", ThreadRole::EVENT_LOOP);
+
+    cpu_set_t cpus;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpus), &cpus), 0);
+    EXPECT_THAT(ToVector(cpus), testing::ElementsAre(cpu));
+
+    for (auto role : {ThreadRole::NETWORK, ThreadRole::BACKGROUND}) {
+      std::thread thread([&allowed, role] {
+        ThreadPlacement::Apply(nullptr, role);
+
+        cpu_set_t cpus;
+        ASSERT_EQ(sched_getaffinity(0, sizeof(cpus), &cpus), 0);
+        EXPECT_TRUE(CPU_EQUAL(&cpus, &allowed));
+      });
+      thread.join();
+    }
+  });
+  event_loop.join();
+
+  ThreadPlacement::Configure(ThreadPlacementConfig());
+}
+
+TEST(ThreadPlacementTest, TestReadThreadCPUUsage) {
+  std::thread thread([] {
+    ThreadPlacement::Apply("usage-test", ThreadRole::BACKGROUND);
+
+    std::vector<ThreadCPUUsage> usage;
+    ASSERT_TRUE(ReadThreadCPUUsage(&usage));
+
+    auto it = std::find_if(usage.begin(), usage.end(), [](const ThreadCPUUsage& u) { return u.name == "usage-test"; });
+    ASSERT_NE(it, usage.end());
+    EXPECT_EQ(it->tid, syscall(SYS_gettid));
+    EXPECT_GE(it->user_seconds, 0);
+    EXPECT_GE(it->system_seconds, 0);
+  });
+  thread.join();
+
+  std::vector<ThreadCPUUsage> usage;
+  EXPECT_FALSE(ReadThreadCPUUsage(&usage, "/nonexistent"));
+}
+
+}  // namespace
+
+}  // namespace collector
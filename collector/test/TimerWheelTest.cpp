@@ -0,0 +1,96 @@
+#include <map>
+#include <random>
+
+#include "TimerWheel.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace collector {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+
+TEST(TimerWheelTest, TestExpiry) {
+  TimerWheel wheel(1000);
+  EXPECT_EQ(wheel.NextExpiry(), -1);
+
+  wheel.Add(1, 1010);
+  wheel.Add(2, 1010);
+  wheel.Add(3, 1500);
+  wheel.Add(4, 900);
+  EXPECT_EQ(wheel.size(), 4);
+  EXPECT_EQ(wheel.NextExpiry(), 1000);
+
+  std::vector<uint64_t> expired;
+  wheel.Advance(1000, &expired);
+  EXPECT_THAT(expired, ElementsAre(4));
+  EXPECT_EQ(wheel.NextExpiry(), 1010);
+
+  expired.clear();
+  wheel.Advance(1009, &expired);
+  EXPECT_THAT(expired, IsEmpty());
+
+  wheel.Advance(1010, &expired);
+  EXPECT_THAT(expired, UnorderedElementsAre(1, 2));
+
+  expired.clear();
+  wheel.Advance(1499, &expired);
+  EXPECT_THAT(expired, IsEmpty());
+  EXPECT_LE(wheel.NextExpiry(), 1500);
+
+  wheel.Advance(2000, &expired);
+  EXPECT_THAT(expired, ElementsAre(3));
+  EXPECT_EQ(wheel.size(), 0);
+  EXPECT_EQ(wheel.NextExpiry(), -1);
+  EXPECT_EQ(wheel.current(), 2000);
+}
+
+TEST(TimerWheelTest, TestBeyondRange) {
+  TimerWheel wheel(0);
+  int64_t deadline = int64_t(1) << 30;
+  wheel.Add(1, deadline);
+
+  std::vector<uint64_t> expired;
+  wheel.Advance(deadline - 1, &expired);
+  EXPECT_THAT(expired, IsEmpty());
+
+  wheel.Advance(deadline, &expired);
+  EXPECT_THAT(expired, ElementsAre(1));
+}
+
+TEST(TimerWheelTest, TestRandomDeadlines) {
+  std::mt19937_64 rng(42);
+  TimerWheel wheel(12345);
+
+  std::map<uint64_t, int64_t> deadlines;
+  for (uint64_t id = 0; id < 10000; id++) {
+    int64_t deadline = 12345 + static_cast<int64_t>(rng() % (1 << 20));
+    deadlines[id] = deadline;
+    wheel.Add(id, deadline);
+  }
+
+  // Advancing in irregular steps, every timer expires exactly when its
+  // deadline is reached, and the wheel never has to be looked at after it.
+  int64_t now = 12345;
+  std::vector<uint64_t> expired;
+  while (wheel.size() > 0) {
+    int64_t next = wheel.NextExpiry();
+    ASSERT_GT(next, now - 1);
+    now = std::min(next, now + static_cast<int64_t>(rng() % 5000));
+
+    expired.clear();
+    wheel.Advance(now, &expired);
+    for (uint64_t id : expired) {
+      EXPECT_EQ(deadlines[id], now) << id;
+      deadlines.erase(id);
+    }
+  }
+  EXPECT_TRUE(deadlines.empty());
+}
+
+}  // namespace
+
+}  // namespace collector
@@ -115,4 +115,21 @@ TEST(ExtractContainerIDFromCgroupTest, TestExtractContainerIDFromCgroup) {
     EXPECT_EQ(short_container_id, c.expected_output);
   }
 }
+
+TEST(ExtractContainerIDFromCgroupTest, TestContainerIDDigits) {
+  std::string container_id = "951e643e3c241b225b6284ef2b79a37c13fc64cbf65b5d46bda95fcb98fe63a4";
+  EXPECT_EQ(ExtractContainerIDFromCgroup("/docker/" + container_id), container_id.substr(0, 12));
+
+  std::string upper_case = "951E643E3C241B225B6284EF2B79A37C13FC64CBF65B5D46BDA95FCB98FE63A4";
+  EXPECT_EQ(ExtractContainerIDFromCgroup("/docker/" + upper_case), upper_case.substr(0, 12));
+
+  // Any character which is not an hexadecimal digit, at any position, is rejected.
+  for (size_t i = 0; i < container_id.size(); i++) {
+    for (char c : {'g', 'G', '/', ':', '@', '`', '\x10', '\x80', '\xff'}) {
+      std::string invalid = container_id;
+      invalid[i] = c;
+      EXPECT_FALSE(ExtractContainerIDFromCgroup("/docker/" + invalid)) << "position " << i << " char " << int(c);
+    }
+  }
+}
 }  // namespace collector